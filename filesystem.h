@@ -48,10 +48,17 @@
     fs_get_cwd()
     fs_get_info(const char* path, fs_info* info)
     fs_insert_basepath(const char* path)
+    fs_map(const char* name, size_t* size)
     fs_mkdir(const char* path)
     fs_read(const char* name, size_t* size)
     fs_remove_basepath(const char* path)
+    fs_shm_create(const char* name, size_t size)
+    fs_shm_delete(const char* name)
+    fs_shm_open(const char* name, size_t* size)
+    fs_shm_unmap(void* p, size_t size)
+    fs_unmap(void* p, size_t size)
     fs_write(const char* name, const fs_data* data)
+    fs_writev(const char* name, const fs_data* data, size_t count)
 
 
     STEP BY STEP:
@@ -75,11 +82,24 @@
 
             fs_append(const char* name, fs_data* data)
             fs_write(const char* name, fs_data* data)
+            fs_writev(const char* name, const fs_data* data, size_t count)
 
     --- to read data from a file, call:
 
             fs_read(const char* name, size_t* size);
 
+    --- to map a file into memory, call:
+
+            fs_map(const char* name, size_t* size)
+            fs_unmap(void* p, size_t size)
+
+    --- to share memory between processes, call:
+
+            fs_shm_create(const char* name, size_t size)
+            fs_shm_open(const char* name, size_t* size)
+            fs_shm_unmap(void* p, size_t size)
+            fs_shm_delete(const char* name)
+
     --- to get information about a file or directory, call:
 
             fs_get_info(const char* path, fs_info* info)
@@ -105,7 +125,9 @@
         to the data read.
 
         Ownership of the pointer is that of the user, and the pointer must
-        freed after use to avoid memory leaks.
+        freed after use to avoid memory leaks. The data is followed by a
+        zero byte, which `size` doesn't count, so text can be read as a
+        string.
 
 
         size_t size;
@@ -114,6 +136,46 @@
         fs_free(data);
 
 
+    MAPPING A FILE:
+    ===============
+
+    --- When mapping a file, the file is resolved through the search path
+        and mapped copy-on-write: the pages are read lazily by the OS and
+        writes to the returned memory are private, they are never written
+        back to the file. The mapping is always followed by at least one
+        zero byte, so text files can be treated as null terminated strings.
+
+        The mapping must be released with `fs_unmap` using the same size.
+
+
+        size_t size;
+        char* data = (char*) fs_map("example.txt", &size);
+
+        fs_unmap(data, size);
+
+
+    SHARED MEMORY:
+    ==============
+
+    --- Shared memory objects are named, not resolved through the search
+        path. `fs_shm_create` creates, or replaces, an object and maps it
+        writable; `fs_shm_open` maps an existing object read-only in any
+        other process. Mappings are released with `fs_shm_unmap`.
+
+        On POSIX systems the object lives until `fs_shm_delete` removes its
+        name, processes that have it mapped keep their mapping. On Windows
+        it lives as long as any process has it mapped, `fs_shm_delete` does
+        nothing, and the size returned by `fs_shm_open` is rounded up to a
+        whole page.
+
+
+        char* data = (char*) fs_shm_create("example", 4096);
+        strcpy(data, "shared");
+
+        size_t size;
+        const char* view = (const char*) fs_shm_open("example", &size);
+
+
     WRITTING TO A FILE:
     ===================
 
@@ -129,6 +191,16 @@
           return -1;
         }
 
+    --- `fs_writev` writes several buffers one after another, so pieces of
+        a file never have to be copied together first. POSIX systems write
+        them with vectored writes; Windows only gathers page aligned,
+        unbuffered writes, so there they are written in turn to the open
+        file.
+
+
+        const fs_data pieces[] = { { "the quick ", 10 }, { "brown fox", 9 } };
+        fs_writev("example.txt", pieces, 2);
+
 
     LICENSE:
     ========
@@ -219,8 +291,22 @@ FS_API_DECL bool fs_remove_basepath(const char* path);
 FS_API_DECL bool fs_exists(const char* path);
 /* reads the contents of a file */
 FS_API_DECL void* fs_read(const char* name, size_t* size);
+/* maps the contents of a file copy-on-write; release with `fs_unmap` */
+FS_API_DECL void* fs_map(const char* name, size_t* size);
+/* releases a mapping returned by `fs_map` */
+FS_API_DECL void fs_unmap(void* p, size_t size);
+/* creates, or replaces, a named shared memory object and maps it writable */
+FS_API_DECL void* fs_shm_create(const char* name, size_t size);
+/* maps an existing shared memory object read-only; release with `fs_shm_unmap` */
+FS_API_DECL const void* fs_shm_open(const char* name, size_t* size);
+/* releases a mapping returned by `fs_shm_create` or `fs_shm_open` */
+FS_API_DECL void fs_shm_unmap(const void* p, size_t size);
+/* removes the name of a shared memory object */
+FS_API_DECL bool fs_shm_delete(const char* name);
 /* writes data to a file */
 FS_API_DECL bool fs_write(const char* name, const fs_data* data);
+/* writes `count` buffers to a file one after another, replacing it */
+FS_API_DECL bool fs_writev(const char* name, const fs_data* data, size_t count);
 /* writes data to the end of a file */
 FS_API_DECL bool fs_append(const char* name, const fs_data* data);
 /* gets information about the specified file or directory */
@@ -232,7 +318,7 @@ FS_API_DECL bool fs_mkdir(const char* path);
 /* deletes a file or directory */
 FS_API_DECL bool fs_delete(const char* name);
 /* frees allocated memory */
-FS_API_DECL inline void fs_free(void* p);
+FS_API_DECL void fs_free(void* p);
 
 #ifdef __cplusplus
 }
@@ -267,7 +353,10 @@ inline bool fs_append(const char* name, fs_data &data) { return fs_append(name,
   #define _getcwd getcwd
 #else
   #include <sys/param.h>
+  #include <sys/mman.h>
+  #include <fcntl.h>
   #include <unistd.h>
+  #include <sys/uio.h>
 #endif
 
 #ifndef _FS_PRIVATE
@@ -402,15 +491,260 @@ _FS_PRIVATE void* _fs_native_read(FILE* fp, size_t* size) {
   fseek(fp, 0, SEEK_END);
   *size = ftell(fp);
   fseek(fp, 0, SEEK_SET);
-  void* buf = FS_MALLOC(*size);
+  /* one more byte for the terminating zero, as with fs_map */
+  char* buf = (char*) FS_MALLOC(*size + 1);
   if (!buf) {
+    fclose(fp);
     return NULL;
   }
   fread(buf, 1, *size, fp);
+  buf[*size] = 0;
   fclose(fp);
   return buf;
 }
 
+#if defined (_WIN32)
+_FS_PRIVATE size_t _fs_page_size(void) {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwPageSize;
+}
+
+_FS_PRIVATE void* _fs_native_map(const char* filename, size_t* size) {
+  HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return NULL;
+  }
+  LARGE_INTEGER len;
+  if (!GetFileSizeEx(file, &len)) {
+    CloseHandle(file);
+    return NULL;
+  }
+  if ((unsigned long long) len.QuadPart >= (size_t) -1) {
+    CloseHandle(file);
+    return NULL;
+  }
+  *size = (size_t) len.QuadPart;
+  /* a view can't extend past the end of the file, when there is no slack
+     in the last page for the zero byte fall back to reading into memory. */
+  if (*size % _fs_page_size() == 0) {
+    char* buf = (char*) FS_MALLOC(*size + 1);
+    /* ReadFile takes a 32-bit size, read in pieces of 1 GB */
+    for (size_t pos = 0; buf && pos < *size;) {
+      const size_t left = *size - pos;
+      DWORD read = 0;
+      if (!ReadFile(file, buf + pos, (left > 0x40000000u) ? 0x40000000u : (DWORD) left, &read, NULL) || read == 0) {
+        FS_FREE(buf);
+        buf = NULL;
+      }
+      pos += read;
+    }
+    if (buf) {
+      buf[*size] = 0;
+    }
+    CloseHandle(file);
+    return buf;
+  }
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+  CloseHandle(file);
+  if (mapping == NULL) {
+    return NULL;
+  }
+  void* p = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+  CloseHandle(mapping);
+  return p;
+}
+
+_FS_PRIVATE void _fs_native_unmap(void* p, size_t size) {
+  if (size % _fs_page_size() == 0) {
+    FS_FREE(p);
+  } else {
+    UnmapViewOfFile(p);
+  }
+}
+
+/* the view keeps the mapping, and its name, alive once the handle is closed */
+_FS_PRIVATE void* _fs_native_shm_create(const char* name, size_t size) {
+  HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD) ((unsigned long long) size >> 32), (DWORD) size, name);
+  if (mapping == NULL) {
+    return NULL;
+  }
+  void* p = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+  CloseHandle(mapping);
+  return p;
+}
+
+_FS_PRIVATE const void* _fs_native_shm_open(const char* name, size_t* size) {
+  HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+  if (mapping == NULL) {
+    return NULL;
+  }
+  void* p = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  MEMORY_BASIC_INFORMATION info;
+  if (p == NULL || VirtualQuery(p, &info, sizeof(info)) == 0) {
+    if (p != NULL) {
+      UnmapViewOfFile(p);
+    }
+    return NULL;
+  }
+  *size = info.RegionSize;
+  return p;
+}
+
+_FS_PRIVATE void _fs_native_shm_unmap(const void* p, size_t size) {
+  (void) size;
+  UnmapViewOfFile(p);
+}
+
+_FS_PRIVATE bool _fs_native_shm_delete(const char* name) {
+  (void) name;
+  return true;
+}
+
+/* WriteFileGather needs unbuffered, page aligned buffers, so the pieces are written in turn */
+_FS_PRIVATE bool _fs_native_writev(const char* filename, const fs_data* data, size_t count) {
+  FILE* fp = fopen(filename, "wb");
+  if (fp == NULL) {
+    return false;
+  }
+  bool ok = true;
+  for (size_t i = 0; ok && i < count; i++) {
+    ok = fwrite(data[i].data, 1, data[i].size, fp) == data[i].size;
+  }
+  return (fclose(fp) == 0) && ok;
+}
+#else
+_FS_PRIVATE void* _fs_native_map(const char* filename, size_t* size) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return NULL;
+  }
+  if (st.st_size < 0 || (unsigned long long) st.st_size >= (size_t) -1) {
+    close(fd);
+    return NULL;
+  }
+  *size = (size_t) st.st_size;
+  /* reserve one byte past the end so the mapping is always followed by a
+     zero page, then map the file over the start of the reservation. */
+  char* p = (char*) mmap(NULL, *size + 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    close(fd);
+    return NULL;
+  }
+  if (*size > 0 && mmap(p, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+    munmap(p, *size + 1);
+    close(fd);
+    return NULL;
+  }
+  close(fd);
+  return p;
+}
+
+_FS_PRIVATE void _fs_native_unmap(void* p, size_t size) {
+  munmap(p, size + 1);
+}
+
+/* shared memory objects are named like "/name" */
+_FS_PRIVATE bool _fs_shm_name(char* buf, const char* name) {
+  const int len = snprintf(buf, FS_MAX_PATH, "/%s", name);
+  return len > 1 && len < FS_MAX_PATH;
+}
+
+_FS_PRIVATE void* _fs_native_shm_create(const char* name, size_t size) {
+  char buf[FS_MAX_PATH];
+  if (!_fs_shm_name(buf, name) || size == 0) {
+    return NULL;
+  }
+  int fd = shm_open(buf, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0) {
+    return NULL;
+  }
+  if (ftruncate(fd, (off_t) size) != 0) {
+    close(fd);
+    shm_unlink(buf);
+    return NULL;
+  }
+  void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    shm_unlink(buf);
+    return NULL;
+  }
+  return p;
+}
+
+_FS_PRIVATE const void* _fs_native_shm_open(const char* name, size_t* size) {
+  char buf[FS_MAX_PATH];
+  if (!_fs_shm_name(buf, name)) {
+    return NULL;
+  }
+  int fd = shm_open(buf, O_RDONLY, 0);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0 || (unsigned long long) st.st_size >= (size_t) -1) {
+    close(fd);
+    return NULL;
+  }
+  *size = (size_t) st.st_size;
+  void* p = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  return (p != MAP_FAILED) ? p : NULL;
+}
+
+_FS_PRIVATE void _fs_native_shm_unmap(const void* p, size_t size) {
+  munmap((void*) p, size);
+}
+
+_FS_PRIVATE bool _fs_native_shm_delete(const char* name) {
+  char buf[FS_MAX_PATH];
+  return _fs_shm_name(buf, name) && shm_unlink(buf) == 0;
+}
+
+/* writes the buffers in batches of iovecs, resuming after partial writes */
+_FS_PRIVATE bool _fs_native_writev(const char* filename, const fs_data* data, size_t count) {
+  enum { BATCH = 64 };
+  int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = true;
+  size_t i = 0, offset = 0;
+  while (ok && i < count) {
+    struct iovec iov[BATCH];
+    int n = 0;
+    for (size_t j = i; j < count && n < BATCH; j++, n++) {
+      const size_t skip = (j == i) ? offset : 0;
+      iov[n].iov_base = (char*) data[j].data + skip;
+      iov[n].iov_len = data[j].size - skip;
+    }
+    const ssize_t written = writev(fd, iov, n);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written < 0 || (written == 0 && iov[0].iov_len > 0)) {
+      ok = false;
+      break;
+    }
+    size_t left = (size_t) written;
+    while (i < count && left >= data[i].size - offset) {
+      left -= data[i].size - offset;
+      offset = 0;
+      i++;
+    }
+    offset += left;
+  }
+  return (close(fd) == 0) && ok;
+}
+#endif
+
 _FS_PRIVATE int _fs_native_write(FILE* fp, const fs_data* data) {
   if (fp == NULL) {
     return false;
@@ -501,6 +835,44 @@ void* fs_read(const char* name, size_t* size) {
   return NULL;
 }
 
+void* fs_map(const char* name, size_t* size) {
+  FS_ASSERT(name && size);
+  char buf[FS_MAX_PATH];
+  _fs_path* dir = &_fs.base_path[_fs.count - 1];
+  for (; dir >= _fs.base_path; dir--) {
+    if (!_fs_concat_path(buf, dir, name) || !_fs_get_file_info(buf, NULL)) {
+      continue;
+    }
+    return _fs_native_map(buf, size);
+  }
+  return NULL;
+}
+
+void fs_unmap(void* p, size_t size) {
+  FS_ASSERT(p);
+  _fs_native_unmap(p, size);
+}
+
+void* fs_shm_create(const char* name, size_t size) {
+  FS_ASSERT(name);
+  return _fs_native_shm_create(name, size);
+}
+
+const void* fs_shm_open(const char* name, size_t* size) {
+  FS_ASSERT(name && size);
+  return _fs_native_shm_open(name, size);
+}
+
+void fs_shm_unmap(const void* p, size_t size) {
+  FS_ASSERT(p);
+  _fs_native_shm_unmap(p, size);
+}
+
+bool fs_shm_delete(const char* name) {
+  FS_ASSERT(name);
+  return _fs_native_shm_delete(name);
+}
+
 bool fs_write(const char* name, const fs_data* data) {
   FS_ASSERT(name && data);
   if (_fs_strempty(&_fs.write_dir)) {
@@ -514,6 +886,18 @@ bool fs_write(const char* name, const fs_data* data) {
   return _fs_native_write(fp, data);
 }
 
+bool fs_writev(const char* name, const fs_data* data, size_t count) {
+  FS_ASSERT(name && (data || count == 0));
+  if (_fs_strempty(&_fs.write_dir)) {
+    return false;
+  }
+  char buf[FS_MAX_PATH];
+  if (!_fs_concat_path(buf, &_fs.write_dir, name)) {
+    return false;
+  }
+  return _fs_native_writev(buf, data, count);
+}
+
 bool fs_append(const char* name, const fs_data* data) {
   FS_ASSERT(name && data);
   if (_fs_strempty(&_fs.write_dir)) {
@@ -570,7 +954,7 @@ bool fs_delete(const char* name) {
   return _fs_native_delete(buf);
 }
 
-inline void fs_free(void* p) {
+void fs_free(void* p) {
   FS_FREE(p);
 }
 
@@ -19,6 +19,14 @@
     INI_ASSERT(c)     - your own assert function (default: assert(c))
     INI_MALLOC(s)     - your own malloc function (default: malloc(s))
     INI_FREE(p)       - your own free function (default: free(p))
+    INI_STATS         - define to record parse and lookup statistics for
+                        each document, see `ini_get_stats` (default: off)
+    INI_64BIT_OFFSETS - define to index documents larger than 2 GB, at the
+                        cost of a larger index (default: 32-bit offsets)
+
+    ...and to load files through the search path of filesystem.h, include
+    filesystem.h before this file; `ini_load_file` maps the file and parses
+    it in place without copying it.
 
 
     FEATURE OVERVIEW:
@@ -33,9 +41,9 @@
     Feature             | Support |
     --------------------+---------+
     Read                | YES     |
-    Write               | TODO    |
+    Write               | PARTIAL |
     Sections            | YES     |
-    Section Nesting     | NO      |
+    Section Nesting     | YES     |
     Properties          | YES     |
      - delimiter (=)    | YES     |
      - delimiter (:)    | NO      |
@@ -45,11 +53,310 @@
     Integer Values      | YES     |
     Float Values        | YES     |
     Boolean Values      | YES     |
-    Quoted Values       | TODO    |
+    Quoted Values       | YES     |
     Multi-line          | NO      |
     Comments (;)        | YES     |
     Comments (#)        | YES     |
-    Escape Characters   | TODO    |
+    Escape Characters   | YES     |
+    Interpolation       | YES     |
+    Line Endings (CRLF) | YES     |
+    UTF-8 (BOM)         | YES     |
+
+    Writing edits an existing source through `ini_editor_t`; a document
+    built or changed with `ini_set_value` can't be written out yet.
+
+
+    LAZY LOADING:
+    =============
+
+    --- `ini_load_desc` loads a document from memory, or from a file when
+        `name` is set, with options. With `lazy` set, loading only scans
+        for section headers and a section's properties are tokenized the
+        first time it is looked up. Sections that are never read are never
+        tokenized, and for mapped files never even paged in.
+
+        Lazy documents may be read from multiple threads, the first lookup
+        into a section tokenizes it while others wait for it to finish.
+        Functions that visit every value, like `ini_interpolate`, tokenize
+        the whole document.
+
+
+        ini_t* ini = ini_load_desc(&(ini_desc) {
+          .name = "huge.ini",
+          .lazy = true,
+        });
+
+
+    ENCODING:
+    =========
+
+    --- Lines may end with "\n" or "\r\n", and a UTF-8 byte order mark at
+        the start of a document is skipped; neither needs the document to
+        be rewritten first. With `utf8` set, `ini_load_desc` checks that
+        the document is valid UTF-8 as it tokenizes it, a line at a time
+        while the line is in cache, and fails to load it if it isn't.
+        Runs of ASCII are checked eight bytes at a time.
+
+
+    DUPLICATES:
+    ===========
+
+    --- By default every property and section is kept as written: a key
+        repeated in a section is found at its first occurrence, and a
+        repeated section is only found by `ini_find_section` at its first
+        header. `duplicate_keys` and `duplicate_sections` of `ini_desc`
+        resolve them while the document is parsed instead, so the index
+        only holds the entries that won and lookups never pass over the
+        others.
+
+        INI_DUPLICATE_FIRST keeps the first and INI_DUPLICATE_LAST the last
+        of them. INI_DUPLICATE_LIST joins the values of a repeated key with
+        ", ", to be read by `ini_value_as_list`, and merges the properties
+        of a repeated section into its first header, where they are
+        resolved as repeated keys. With INI_DUPLICATE_ERROR the document
+        fails to load. A document with a policy is never lazy.
+
+
+        ini_t* ini = ini_load_desc(&(ini_desc) {
+          .name = "app.ini",
+          .duplicate_keys = INI_DUPLICATE_LAST,
+          .duplicate_sections = INI_DUPLICATE_LIST,
+        });
+
+
+    SCHEMAS:
+    ========
+
+    --- A schema is a table of rules given to `ini_load_desc`, checked while
+        the document is tokenized: every value that has a rule is checked
+        as it is parsed, by a single lookup of its section and key, and
+        required keys that are missing once parsing is done are reported.
+        Every violation is passed to `violation` with its line, counting
+        from 1, and `ini_num_violations` returns how many there were. The
+        table is plain data, so it can be `static const` in C or
+        `constexpr` in C++. A document with a schema is never lazy.
+
+        With a policy for duplicates, values are checked after parsing,
+        once the policy is resolved, so only the values that were kept are
+        checked, each at the last line that set it.
+
+        The types are INI_TYPE_STRING, any value; INI_TYPE_INT, a decimal
+        integer within `min` and `max` unless both are 0; INI_TYPE_FLOAT,
+        a decimal number within the same range; INI_TYPE_BOOL, true or
+        false; and INI_TYPE_ENUM, one of `choices` separated by '|'.
+
+
+        static const ini_rule_t rules[] = {
+          { "database", "port", INI_TYPE_INT, true, 1, 65535 },
+          { "database", "mode", INI_TYPE_ENUM, false, 0, 0, "fast|safe" },
+        };
+        ini_t* ini = ini_load_desc(&(ini_desc) {
+          .name = "app.ini",
+          .rules = rules,
+          .num_rules = 2,
+          .violation = report,
+        });
+
+
+    RELOADING:
+    ==========
+
+    --- `ini_load_into` parses a document into an existing `ini_t`, reusing
+        its buffers and index tables. They only grow, so once a document has
+        been loaded into it, reloading a document of the same shape makes no
+        allocations. Pass NULL to create a new `ini_t`.
+
+        `ini_reset` empties a document while keeping its memory. Pointers
+        returned by `ini_value` are invalidated by both.
+
+
+        ini_t* ini = NULL;
+        for (;;) {
+          ini = ini_load_into(ini, data, len);
+          ...
+        }
+        ini_destroy(ini);
+
+
+    CLONING:
+    ========
+
+    --- `ini_clone` copies a document in constant time, whatever its size:
+        the clone shares the index and text of the original, and copies a
+        section into its own memory the first time `ini_set_value` writes
+        to it. The first write to a clone also copies the table of
+        sections, which is small next to their properties. A lazily loaded
+        document is tokenized by its first clone.
+
+        The original is read-only while it has clones, and is freed when
+        it and all its clones have been destroyed, in any order; clones can
+        themselves be cloned. Interpolate before cloning, a clone can't be
+        interpolated or reset. A clone of the document returned by
+        `ini_shared_get` is only valid until the next call.
+
+
+        ini_t* defaults = ini_load_file("app.ini");
+        ini_t* session = ini_clone(defaults);
+        ini_set_value(session, INI_GLOBAL_SECTION, "user", name);
+        ...
+        ini_destroy(session);
+
+
+    LARGE DOCUMENTS:
+    ================
+
+    --- Documents are indexed with 32-bit offsets, which keeps the index
+        small but limits documents to 2 GB; larger documents fail to load.
+        Define INI_64BIT_OFFSETS to load larger documents, ideally with
+        `ini_load_file` so they are mapped rather than copied. Section ids
+        remain an `int` either way, counts are returned as a `size_t` by
+        `ini_num_sections` and `ini_num_properties`.
+
+    --- Besides its copy of the text, a document costs 28 bytes per
+        property with 32-bit offsets, 44 with 64-bit offsets, plus about 2
+        bytes per property for the key filter and under 100 bytes per
+        section. Tables grow by doubling, so up to half of them can be
+        unused, and loading briefly holds the old and new tables while
+        they grow. With sections of dozens of properties, and tens of
+        thousands of properties or more, the index costs:
+
+                                      32-bit      64-bit
+          tables full, loaded        < 36 B      < 52 B   per property
+          tables full, peak          < 48 B      < 72 B   per property
+          tables just grown, loaded  < 64 B      < 100 B  per property
+
+        The first two rows are checked by the tests. Loading takes time
+        linear in the size of the document; the `ini_scaling` benchmark
+        measures documents from 1 KB to 1 GB.
+
+
+    SHARED DOCUMENTS:
+    =================
+
+    --- `ini_image_write` writes a document as a single relocatable image:
+        its index, key order and strings, with every reference an offset
+        into the image. Call it with a NULL `dst` to get the size first.
+        `ini_image_open` returns a read-only document over an image where
+        it is, without copying it, so an image in shared memory is read by
+        every process that maps it. Lookups never write to the image and
+        need no locks. Images are only read by the same build of ini.h,
+        and one whose tables don't fit in its size, like a truncated or
+        stale segment, is rejected; the strings it holds are trusted.
+
+    --- With filesystem.h included, a publisher process shares documents
+        with its workers through named shared memory. `ini_shared_publish`
+        writes every new document to a new image and then bumps a
+        generation counter; `ini_shared_get` in a worker returns the
+        latest document, switching to a new image when the generation has
+        changed, which costs a single atomic load otherwise. The document
+        it returns stays valid until the next call.
+
+
+        // publisher
+        ini_shared_t* shared = ini_shared_create("app-config");
+        ini_shared_publish(shared, ini_load_file("app.ini"));
+
+        // workers
+        ini_shared_t* shared = ini_shared_open("app-config");
+        for (;;) {
+          const ini_t* ini = ini_shared_get(shared);
+          ...
+        }
+
+
+    NESTED SECTIONS:
+    ================
+
+    --- Sections nest by their dotted names, a section is the child of the
+        nearest section its name extends: `[server.http.tls]` is a child of
+        `[server.http]`, or of `[server]` when there is none, or of the
+        global section. The tree is built once a document is loaded.
+
+        `ini_find_section_path` walks the tree one component at a time, and
+        `ini_section_child` and `ini_section_next` enumerate the children of
+        a section in the order they appear in the document.
+
+
+        [server]
+        name = web01
+        [server.http]
+        port = 80
+        [server.http.tls]
+        port = 443
+
+        int tls = ini_find_section_path(ini, "server.http.tls");
+        int http = ini_section_parent(ini, tls);
+        for (int s = ini_section_child(ini, http); s != INI_NOT_FOUND; s = ini_section_next(ini, s)) {
+          ...
+        }
+
+
+    KEY QUERIES:
+    ============
+
+    --- `ini_keys_with_prefix` walks the properties of a section whose keys
+        start with a prefix, and `ini_keys_matching` those whose keys match
+        a glob pattern, where `*` matches any run of characters and `?` any
+        single character. Properties are visited in key order.
+
+        The first query of a section sorts its keys, later queries find the
+        first match with a binary search, patterns by their characters
+        before the first wildcard. Adding a key to a section sorts it again
+        on the next query.
+
+
+        [upstream]
+        pool3.host = 10.0.0.3
+        pool3.port = 8080
+        pool4.host = 10.0.0.4
+
+        ini_span_t key, value;
+        ini_keys_t keys = ini_keys_with_prefix(ini, section, "pool3.");
+        while (ini_keys_next(&keys, &key, &value)) {
+          printf("%.*s = %.*s\n", (int) key.len, key.ptr, (int) value.len, value.ptr);
+        }
+
+
+    BATCHED LOOKUPS:
+    ================
+
+    --- `ini_values_batch` looks up many keys of a section at once, with a
+        single pass over the section rather than one per key. Values are
+        written to `out` in the order of `keys`, NULL for missing keys.
+
+
+        static const char* const keys[] = { "host", "port", "user" };
+        const char* values[3];
+        ini_values_batch(ini, section, keys, 3, values);
+
+
+    MISSING KEYS:
+    =============
+
+    --- Every document keeps a small Bloom filter of its section and key
+        pairs, built as it is parsed. Looking up a key that a section
+        doesn't have usually returns after testing two bits, without
+        comparing any keys, which keeps probing for optional keys cheap.
+        The filter costs 2 bytes per property and is rebuilt as values are
+        added with `ini_set_value`.
+
+
+    QUOTED VALUES:
+    ==============
+
+    --- Values may be wrapped in quotes to keep leading or trailing spaces,
+        and comment characters, as part of the value. Anything after the
+        closing quote is ignored.
+
+        Double quoted values support the escape sequences \\, \", \n, \t
+        and \r, any other escaped character stands for itself. Single quoted
+        values are literal. Escapes are decoded in place, a value without
+        them is never copied.
+
+
+        path = "C:\\Program Files"     ; C:\Program Files
+        motd = 'say "hi"; then go'  ; say "hi"; then go
+        pad = "  centered  "        ; keeps both spaces on either side
 
 
     FUNCTIONS:
@@ -58,13 +365,260 @@
     ini_create()
     ini_destroy(ini_t* ini)
     ini_load(const char* data)
+    ini_load_file(const char* name)
+    ini_load_desc(const ini_desc* desc)
+    ini_load_into(ini_t* ini, const char* data, size_t len)
+    ini_reset(ini_t* ini)
+    ini_clone(const ini_t* ini)
+    ini_num_violations(const ini_t* ini)
+    ini_num_sections(const ini_t* ini)
+    ini_num_properties(const ini_t* ini, int section)
     ini_find_section(const ini_t* ini, const char* name)
+    ini_find_section_path(const ini_t* ini, const char* path)
+    ini_section_parent(const ini_t* ini, int section)
+    ini_section_child(const ini_t* ini, int section)
+    ini_section_next(const ini_t* ini, int section)
     ini_section_exists(const ini_t* ini, const char* key)
     ini_property_exists(const ini_t* ini, int section, const char* key)
     ini_value(const ini_t* ini, int section, const char* key)
+    ini_value_span(const ini_t* ini, int section, const char* key)
+    ini_values_batch(const ini_t* ini, int section, const char* const* keys, size_t n, const char** out)
     ini_value_as_int(const ini_t* ini, int section, const char* key)
     ini_value_as_float(const ini_t* ini, int section, const char* key)
     ini_value_as_bool(const ini_t* ini, int section, const char* key)
+    ini_value_as_list(const ini_t* ini, int section, const char* key)
+    ini_list_next(ini_list_t* list, ini_span_t* item)
+    ini_keys_with_prefix(const ini_t* ini, int section, const char* prefix)
+    ini_keys_matching(const ini_t* ini, int section, const char* pattern)
+    ini_keys_next(ini_keys_t* keys, ini_span_t* key, ini_span_t* value)
+    ini_value_as_int_array(const ini_t* ini, int section, const char* key, int64_t* out, size_t cap)
+    ini_set_value(ini_t* ini, int section, const char* key, const char* value)
+    ini_interpolate(ini_t* ini)
+    ini_num_cyclic(const ini_t* ini)
+    ini_apply_env(ini_t* ini, const char* prefix)
+    ini_fingerprint(const ini_t* ini)
+    ini_hash_equal(ini_hash_t a, ini_hash_t b)
+    ini_diff(const ini_t* a, const ini_t* b, ini_diff_func func, void* user)
+    ini_get_stats(const ini_t* ini, ini_stats_t* stats)
+    ini_image_write(const ini_t* ini, void* dst, size_t cap)
+    ini_image_open(const void* image, size_t size)
+    ini_shared_create(const char* name)
+    ini_shared_open(const char* name)
+    ini_shared_publish(ini_shared_t* shared, const ini_t* ini)
+    ini_shared_get(ini_shared_t* shared)
+    ini_shared_generation(const ini_shared_t* shared)
+    ini_shared_close(ini_shared_t* shared)
+    ini_editor_create(const char* data, size_t size)
+    ini_editor_destroy(ini_editor_t* editor)
+    ini_editor_document(const ini_editor_t* editor)
+    ini_editor_set_value(ini_editor_t* editor, int section, const char* key, const char* value)
+    ini_editor_add_section(ini_editor_t* editor, const char* name)
+    ini_editor_spans(const ini_editor_t* editor, ini_span_t* out, size_t cap)
+    ini_editor_write(const ini_editor_t* editor, const char* name)
+    ini_version_create(const ini_t* ini)
+    ini_version_destroy(ini_version_t* version)
+    ini_version_set(const ini_version_t* version, const char* section, const char* key, const char* value)
+    ini_version_value(const ini_version_t* version, const char* section, const char* key)
+    ini_version_num_properties(const ini_version_t* version)
+    ini_version_diff(const ini_version_t* a, const ini_version_t* b, ini_diff_func func, void* user)
+
+
+    LIST VALUES:
+    ============
+
+    --- Comma separated values can be walked without copying them, each
+        item is a span into the value with surrounding whitespace removed.
+
+
+        ini_span_t host;
+        ini_list_t hosts = ini_value_as_list(ini, section, "upstream");
+        while (ini_list_next(&hosts, &host)) {
+          connect(host.ptr, host.len);
+        }
+
+    --- Lists of integers can be converted in one call, which returns the
+        number of items in the list and writes at most `cap` of them, so
+        it can be called with a zero capacity to size the array. Items
+        that are not integers, or don't fit in an int64_t, are stored as
+        zero.
+
+
+        int64_t ids[64];
+        size_t count = ini_value_as_int_array(ini, section, "ids", ids, 64);
+
+
+    INTERPOLATION:
+    ==============
+
+    --- Values may reference other values as ${section:key}, properties of
+        the global section as ${:key}, and environment variables as ${NAME}.
+        Interpolation is opt-in, call `ini_interpolate` once after loading.
+
+        Every referencing value is resolved once, after the values it
+        depends on, and stored in the document; reading it afterwards costs
+        the same as reading any other value. References to missing values
+        or unset variables expand to nothing. Values that take part in, or
+        depend on, a reference cycle are left as written and
+        `ini_interpolate` returns false; `ini_num_cyclic` counts them.
+
+
+        [paths]
+        root = ${HOME}/app
+        logs = ${paths:root}/logs
+
+        ini_t* ini = ini_load(data);
+        ini_interpolate(ini);
+        ini_value(ini, ini_find_section(ini, "paths"), "logs"); // /home/user/app/logs
+
+    --- `ini_set_value` changes, or adds, a value. Once a document has been
+        interpolated, only the values that depend on the changed value are
+        resolved again, found by the references recorded when it was
+        interpolated. A change that makes, or breaks, a cycle is seen in
+        `ini_num_cyclic`. Environment variables are read by
+        `ini_interpolate`, call it again to pick up changes.
+
+        Pointers returned by `ini_value` stay valid when a value changes,
+        replaced values are kept until the document is destroyed.
+
+
+    ENVIRONMENT:
+    ============
+
+    --- Environment variables named PREFIX__SECTION__KEY override values of
+        the document, and PREFIX__KEY those of the global section. Set
+        `env_prefix` in `ini_desc` to apply them when the document is
+        loaded, or call `ini_apply_env`. Either scans the environment once
+        and writes the overrides into the document, so reading an
+        overridden value costs the same as reading any other value.
+
+        Letters of the section and key match regardless of case, and an
+        underscore also matches a dot or a dash. Only properties that exist
+        are overridden; other variables are ignored. The environment is not
+        watched, call `ini_apply_env` again to pick up changes: values
+        whose variables were unset get back the value they had before.
+        Overrides are written like `ini_set_value` writes them, and the
+        interpolated values depending on them are resolved once, after all
+        of them are written.
+
+        Like any replaced value, the text an override replaces is kept
+        until the document is destroyed or reset, so pointers to it stay
+        valid. Memory grows with the values that change between calls:
+        calls that change nothing, and values that resolve to the text they
+        already had, allocate nothing.
+
+
+        [database]
+        port = 143
+
+        // APP__DATABASE__PORT=5432
+        const ini_desc desc = { .data = data, .env_prefix = "APP" };
+        ini_t* ini = ini_load_desc(&desc);
+        ini_value(ini, ini_find_section(ini, "database"), "port"); // 5432
+
+
+    EDITING:
+    ========
+
+    --- An editor changes a document without rewriting it: comments, blank
+        lines, spacing and the order of everything are kept. Loading it
+        records where every value is in the source, which must outlive the
+        editor, and every edit becomes a patch that replaces a value or
+        inserts a line. Creating an editor copies the source once, to
+        tokenize it like `ini_load_into`; after that an edit costs as much
+        as its patch, however large the document, and the source is only
+        read again when the result is written.
+
+        A changed value replaces the old one in place, quoted if it needs
+        to be; a new key is added after the last property of its section,
+        and a new section at the end of the document, with lines ending
+        like the first line of the source.
+
+        `ini_editor_spans` returns the result as spans of the source and
+        the patches, in order, and `ini_editor_write` writes them to a file
+        with `fs_writev`. `ini_editor_document` is the edited document.
+
+
+        ini_editor_t* editor = ini_editor_create(text, len);
+        int db = ini_find_section(ini_editor_document(editor), "database");
+        ini_editor_set_value(editor, db, "port", "5432");
+        ini_editor_write(editor, "app.ini");
+        ini_editor_destroy(editor);
+
+
+    FINGERPRINTS AND DIFFS:
+    =======================
+
+    --- `ini_fingerprint` returns a 128-bit hash of every section, key and
+        value of a document. It doesn't depend on the order of sections or
+        properties, so documents with the same values have the same
+        fingerprint however they are written. Sections without properties
+        don't contribute. The hash is not cryptographic.
+
+        Each section keeps a hash of its properties that is updated as they
+        are parsed and changed, so taking the fingerprint only combines the
+        section hashes.
+
+    --- `ini_diff` calls `func` for every value that differs between two
+        documents, with NULL for the value of the document it is missing
+        from, and returns the number of differences. Sections with equal
+        hashes are skipped without comparing their values. The global
+        section is named "", and a repeated section is compared as the
+        first section of its name.
+
+
+        void changed(const char* section, const char* key, const char* a, const char* b, void* user) {
+          printf("[%s] %s: %s -> %s\n", section, key, a ? a : "(none)", b ? b : "(none)");
+        }
+
+        if (!ini_hash_equal(ini_fingerprint(old), ini_fingerprint(new))) {
+          ini_diff(old, new, changed, NULL);
+        }
+
+
+    VERSIONS:
+    =========
+
+    --- `ini_version_create` captures the properties of a document as an
+        immutable version, a hash trie keyed by section name and key.
+        `ini_version_set` returns a new version with one value set, or
+        removed with a NULL value, that shares everything but the path to
+        that value with the version it was made from: each edit costs
+        under a kilobyte, however large the document. Lookups walk at
+        most seven levels of 32 entries.
+
+        Versions are destroyed independently and in any order, and can be
+        read and destroyed from multiple threads. `ini_version_diff`
+        compares two versions like `ini_diff`, skipping everything they
+        share, so comparing a version with the one it was made from costs
+        as much as the edits between them; differences are reported in
+        no particular order. The global section is named "", or NULL.
+
+
+        ini_version_t* history[100];
+        history[0] = ini_version_create(ini);
+        for (int i = 1; i < 100; i++) {
+          history[i] = ini_version_set(history[i - 1], "database", "port", ports[i]);
+        }
+        const char* port = ini_version_value(history[42], "database", "port");
+
+
+    STATISTICS:
+    ===========
+
+    --- When compiled with INI_STATS defined, every document records how
+        much was parsed and how it is being looked up. Lookups count every
+        call to `ini_find_section`, `ini_property_exists` and `ini_value`,
+        and probes count the entries compared before a lookup returned.
+
+        The counters are not synchronized; concurrent readers of the same
+        document may lose increments. Without INI_STATS nothing is
+        recorded and `ini_get_stats` returns false.
+
+
+        ini_stats_t stats;
+        if (ini_get_stats(ini, &stats)) {
+          printf("%zu lookups, %zu misses\n", stats.lookups, stats.misses);
+        }
 
 
     LICENSE:
@@ -95,6 +649,8 @@
 #define INI_INCLUDED (1)
 
 #include <stdbool.h>
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* int64_t */
 
 #if !defined(INI_API_DECL)
   #define INI_API_DECL extern
@@ -111,6 +667,100 @@ enum {
 };
 
 typedef struct ini_t ini_t;
+typedef struct ini_shared_t ini_shared_t;
+typedef struct ini_editor_t ini_editor_t;
+typedef struct ini_version_t ini_version_t;
+
+typedef enum ini_type_t {
+  INI_TYPE_STRING,
+  INI_TYPE_INT,
+  INI_TYPE_FLOAT,
+  INI_TYPE_BOOL,
+  INI_TYPE_ENUM,
+} ini_type_t;
+
+/* what loading does with a key repeated within a section, or with a repeated section */
+typedef enum ini_duplicate_t {
+  INI_DUPLICATE_KEEP,       /* keep every one, lookups find the first */
+  INI_DUPLICATE_FIRST,      /* keep the first, ignore the others */
+  INI_DUPLICATE_LAST,       /* keep the last, it replaces the others */
+  INI_DUPLICATE_LIST,       /* keys: join the values with ", "; sections: merge them into the first */
+  INI_DUPLICATE_ERROR,      /* fail to load the document */
+} ini_duplicate_t;
+
+typedef enum ini_violation_t {
+  INI_VIOLATION_TYPE,       /* the value isn't of the rule's type */
+  INI_VIOLATION_RANGE,      /* the value is outside of `min` and `max` */
+  INI_VIOLATION_CHOICE,     /* the value isn't one of `choices` */
+  INI_VIOLATION_MISSING,    /* a required key isn't in the document */
+} ini_violation_t;
+
+typedef struct ini_rule_t {
+  const char* section;      /* name of the section; NULL for the global section */
+  const char* key;
+  ini_type_t type;
+  bool required;
+  int64_t min;              /* range of numbers, unchecked if both are 0 */
+  int64_t max;
+  const char* choices;      /* values of an enum separated by '|' */
+} ini_rule_t;
+
+/* called for every value that breaks a rule; `line` and `value` are 0 and NULL for missing keys */
+typedef void (*ini_violation_func)(const ini_rule_t* rule, ini_violation_t violation, size_t line, const char* value, void* user);
+
+typedef struct ini_desc {
+  const char* data;   /* text to parse */
+  size_t size;        /* size of data; 0 if null terminated */
+  const char* name;   /* file to map instead of data, requires filesystem.h */
+  bool lazy;          /* tokenize sections on first lookup */
+  bool utf8;          /* fail to load text that isn't valid UTF-8 */
+  ini_duplicate_t duplicate_keys;       /* keys repeated within a section */
+  ini_duplicate_t duplicate_sections;   /* sections repeated in the document */
+  const ini_rule_t* rules;        /* schema checked while parsing */
+  size_t num_rules;
+  ini_violation_func violation;   /* called for every violation of the schema */
+  void* user;
+  const char* env_prefix;   /* apply PREFIX__SECTION__KEY environment variables */
+} ini_desc;
+
+typedef struct ini_span_t {
+  const char* ptr;
+  size_t len;
+} ini_span_t;
+
+typedef struct ini_list_t {
+  const char* pos;
+  const char* end;
+} ini_list_t;
+
+typedef struct ini_keys_t {
+  const ini_t* ini;
+  int section;
+  size_t pos;
+  size_t end;
+  const char* pattern;
+} ini_keys_t;
+
+typedef struct ini_hash_t {
+  uint64_t lo;
+  uint64_t hi;
+} ini_hash_t;
+
+/* called by `ini_diff` for every value that differs; `a` or `b` is NULL if the key is missing */
+typedef void (*ini_diff_func)(const char* section, const char* key, const char* a, const char* b, void* user);
+
+typedef struct ini_stats_t {
+  size_t bytes;                 /* bytes parsed */
+  size_t lines;                 /* lines parsed */
+  size_t sections;              /* sections parsed */
+  size_t properties;            /* properties parsed */
+  unsigned long long parse_ns;  /* time spent parsing */
+  size_t lookups;               /* section and property lookups */
+  size_t hits;                  /* lookups that found an entry */
+  size_t misses;                /* lookups that found nothing */
+  size_t probes;                /* entries compared over all lookups */
+  size_t max_probes;            /* most entries compared by a single lookup */
+} ini_stats_t;
 
 /* create ini structure */
 INI_API_DECL ini_t* ini_create();
@@ -118,32 +768,174 @@ INI_API_DECL ini_t* ini_create();
 INI_API_DECL void ini_destroy(ini_t* ini);
 /* parses null terminated string containing an ini-file */
 INI_API_DECL ini_t* ini_load(const char* data);
+#if defined(FS_INCLUDED)
+/* maps and parses a file found in the filesystem.h search path; returns NULL if not found */
+INI_API_DECL ini_t* ini_load_file(const char* name);
+#endif
+/* parses a document described by `desc`; returns NULL if the file isn't found, is too large, isn't valid UTF-8 when `utf8` is set, or repeats a key or section when that is an error */
+INI_API_DECL ini_t* ini_load_desc(const ini_desc* desc);
+/* parses `len` characters of data into `ini`, reusing its memory; creates a new ini structure if `ini` is NULL */
+INI_API_DECL ini_t* ini_load_into(ini_t* ini, const char* data, size_t len);
+/* removes all sections and properties, keeping the memory for the next load */
+INI_API_DECL void ini_reset(ini_t* ini);
+/* clones a document in constant time, sharing its index until either is modified; destroy it with ini_destroy */
+INI_API_DECL ini_t* ini_clone(const ini_t* ini);
+/* get the number of violations of the schema the document was loaded with */
+INI_API_DECL size_t ini_num_violations(const ini_t* ini);
+/* get the number of sections, not counting the global section */
+INI_API_DECL size_t ini_num_sections(const ini_t* ini);
+/* get the number of properties in a given section */
+INI_API_DECL size_t ini_num_properties(const ini_t* ini, int section);
 /* get index of a section; returns -1 if not found */
 INI_API_DECL int ini_find_section(const ini_t* ini, const char* name);
+/* get index of a section by the dotted path of its parents; returns -1 if not found */
+INI_API_DECL int ini_find_section_path(const ini_t* ini, const char* path);
+/* get index of the parent of a section; returns -1 for the global section */
+INI_API_DECL int ini_section_parent(const ini_t* ini, int section);
+/* get index of the first child of a section; returns -1 if it has none */
+INI_API_DECL int ini_section_child(const ini_t* ini, int section);
+/* get index of the next child of the same parent; returns -1 after the last */
+INI_API_DECL int ini_section_next(const ini_t* ini, int section);
 /* tests if a section exists */
 INI_API_DECL bool ini_section_exists(const ini_t* ini, const char* key);
 /* tests if a property exists in a given section */
 INI_API_DECL bool ini_property_exists(const ini_t* ini, int section, const char* key);
 /* get value of propery in a given section; returns NULL if key doesn't exist */
 INI_API_DECL const char* ini_value(const ini_t* ini, int section, const char* key);
+/* get value of propery in a given section and its length; the span is empty with a NULL pointer if key doesn't exist */
+INI_API_DECL ini_span_t ini_value_span(const ini_t* ini, int section, const char* key);
+/* get the values of `n` keys in a given section in one pass; returns the number of keys found */
+INI_API_DECL size_t ini_values_batch(const ini_t* ini, int section, const char* const* keys, size_t n, const char** out);
 /* get value of propery in a given section, as an int */
 INI_API_DECL int ini_value_as_int(const ini_t* ini, int section, const char* key);
 /* get value of propery in a given section, as a float */
 INI_API_DECL float ini_value_as_float(const ini_t* ini, int section, const char* key);
 /* get value of propery in a given section, as a boolean */
 INI_API_DECL bool ini_value_as_bool(const ini_t* ini, int section, const char* key);
+/* get value of propery in a given section, as a comma separated list */
+INI_API_DECL ini_list_t ini_value_as_list(const ini_t* ini, int section, const char* key);
+/* get the next item of a list; returns false at the end of the list */
+INI_API_DECL bool ini_list_next(ini_list_t* list, ini_span_t* item);
+/* get the properties of a section whose keys start with `prefix`, in key order */
+INI_API_DECL ini_keys_t ini_keys_with_prefix(const ini_t* ini, int section, const char* prefix);
+/* get the properties of a section whose keys match a glob `pattern` of `*` and `?`, in key order */
+INI_API_DECL ini_keys_t ini_keys_matching(const ini_t* ini, int section, const char* pattern);
+/* get the next property of a key query; returns false when there are no more */
+INI_API_DECL bool ini_keys_next(ini_keys_t* keys, ini_span_t* key, ini_span_t* value);
+/* get value of propery in a given section, as a list of integers; returns the number of items */
+INI_API_DECL size_t ini_value_as_int_array(const ini_t* ini, int section, const char* key, int64_t* out, size_t cap);
+/* sets the value of a property in a given section, adding it if it doesn't exist */
+INI_API_DECL bool ini_set_value(ini_t* ini, int section, const char* key, const char* value);
+/* resolves ${section:key} and ${ENV} references; returns false if a reference cycle was found */
+INI_API_DECL bool ini_interpolate(ini_t* ini);
+/* get the number of values left as written by reference cycles */
+INI_API_DECL size_t ini_num_cyclic(const ini_t* ini);
+/* overrides values with PREFIX__SECTION__KEY environment variables; returns the number of values overridden */
+INI_API_DECL size_t ini_apply_env(ini_t* ini, const char* prefix);
+/* get an order-independent hash of every section, key and value */
+INI_API_DECL ini_hash_t ini_fingerprint(const ini_t* ini);
+/* tests if two hashes are equal */
+INI_API_DECL bool ini_hash_equal(ini_hash_t a, ini_hash_t b);
+/* reports every value that differs between two documents; returns the number of differences */
+INI_API_DECL int ini_diff(const ini_t* a, const ini_t* b, ini_diff_func func, void* user);
+/* get parse and lookup statistics; returns false if not compiled with INI_STATS */
+INI_API_DECL bool ini_get_stats(const ini_t* ini, ini_stats_t* stats);
+/* writes a relocatable image of a document if it fits in `cap` bytes; returns its size, or 0 if too large */
+INI_API_DECL size_t ini_image_write(const ini_t* ini, void* dst, size_t cap);
+/* opens a read-only document over an image in place; returns NULL if it isn't a valid image */
+INI_API_DECL ini_t* ini_image_open(const void* image, size_t size);
+#if defined(FS_INCLUDED)
+/* creates the named shared memory of a publisher; returns NULL on failure */
+INI_API_DECL ini_shared_t* ini_shared_create(const char* name);
+/* opens the named shared memory of a publisher; returns NULL if there is none */
+INI_API_DECL ini_shared_t* ini_shared_open(const char* name);
+/* publishes a document as the next generation; returns false on failure */
+INI_API_DECL bool ini_shared_publish(ini_shared_t* shared, const ini_t* ini);
+/* get the latest published document; returns NULL if none was published yet */
+INI_API_DECL const ini_t* ini_shared_get(ini_shared_t* shared);
+/* get the generation of the document last published, or returned by `ini_shared_get` */
+INI_API_DECL uint64_t ini_shared_generation(const ini_shared_t* shared);
+/* unmaps the shared memory, a publisher also removes it */
+INI_API_DECL void ini_shared_close(ini_shared_t* shared);
+#endif
+/* parses a copy of a document to edit, `data` must outlive the editor; `size` is 0 if null terminated. returns NULL if it can't be edited */
+INI_API_DECL ini_editor_t* ini_editor_create(const char* data, size_t size);
+/* destroys an editor and its document */
+INI_API_DECL void ini_editor_destroy(ini_editor_t* editor);
+/* get the edited document */
+INI_API_DECL const ini_t* ini_editor_document(const ini_editor_t* editor);
+/* sets the value of a property, adding it if it doesn't exist; returns false if the key can't be written */
+INI_API_DECL bool ini_editor_set_value(ini_editor_t* editor, int section, const char* key, const char* value);
+/* adds a section at the end of the document; returns the existing section of that name, or -1 if it can't be written */
+INI_API_DECL int ini_editor_add_section(ini_editor_t* editor, const char* name);
+/* get the edited document as spans of text, written to `out` if they fit in `cap`; returns their number */
+INI_API_DECL size_t ini_editor_spans(const ini_editor_t* editor, ini_span_t* out, size_t cap);
+#if defined(FS_INCLUDED)
+/* writes the edited document to a file with a single vectored write; returns false on failure */
+INI_API_DECL bool ini_editor_write(const ini_editor_t* editor, const char* name);
+#endif
+/* captures the properties of a document as an immutable version; an empty version if `ini` is NULL */
+INI_API_DECL ini_version_t* ini_version_create(const ini_t* ini);
+/* destroys a version, the versions made from it are unaffected */
+INI_API_DECL void ini_version_destroy(ini_version_t* version);
+/* makes a new version with a value set, or removed if `value` is NULL; `section` is NULL for the global section */
+INI_API_DECL ini_version_t* ini_version_set(const ini_version_t* version, const char* section, const char* key, const char* value);
+/* get value of a property of a version; returns NULL if key doesn't exist */
+INI_API_DECL const char* ini_version_value(const ini_version_t* version, const char* section, const char* key);
+/* get the number of properties of a version, in every section */
+INI_API_DECL size_t ini_version_num_properties(const ini_version_t* version);
+/* reports every value that differs between two versions; returns the number of differences */
+INI_API_DECL int ini_version_diff(const ini_version_t* a, const ini_version_t* b, ini_diff_func func, void* user);
 
 #ifdef __cplusplus
 }
 
 /* reference-based equivalents for c++ */
+inline ini_t* ini_load_desc(const ini_desc& desc) { return ini_load_desc(&desc); }
+inline size_t ini_num_violations(const ini_t& ini) { return ini_num_violations(&ini); }
+inline void ini_reset(ini_t& ini) { ini_reset(&ini); }
+inline ini_t* ini_clone(const ini_t& ini) { return ini_clone(&ini); }
+inline size_t ini_num_sections(const ini_t& ini) { return ini_num_sections(&ini); }
+inline size_t ini_num_properties(const ini_t& ini, int section) { return ini_num_properties(&ini, section); }
 inline int ini_find_section(const ini_t& ini, const char* name) { return ini_find_section(&ini, name); }
+inline int ini_find_section_path(const ini_t& ini, const char* path) { return ini_find_section_path(&ini, path); }
+inline int ini_section_parent(const ini_t& ini, int section) { return ini_section_parent(&ini, section); }
+inline int ini_section_child(const ini_t& ini, int section) { return ini_section_child(&ini, section); }
+inline int ini_section_next(const ini_t& ini, int section) { return ini_section_next(&ini, section); }
 inline bool ini_section_exists(const ini_t& ini, const char* key) { return ini_section_exists(&ini, key); }
 inline bool ini_property_exists(const ini_t& ini, int section, const char* key) { return ini_property_exists(&ini, section, key); }
 inline const char* ini_value(const ini_t& ini, int section, const char* key) { return ini_value(&ini, section, key); }
+inline ini_span_t ini_value_span(const ini_t& ini, int section, const char* key) { return ini_value_span(&ini, section, key); }
+inline size_t ini_values_batch(const ini_t& ini, int section, const char* const* keys, size_t n, const char** out) { return ini_values_batch(&ini, section, keys, n, out); }
 inline int ini_value_as_int(const ini_t& ini, int section, const char* key) { return ini_value_as_int(&ini, section, key); }
 inline float ini_value_as_float(const ini_t& ini, int section, const char* key) { return ini_value_as_float(&ini, section, key); }
 inline bool ini_value_as_bool(const ini_t& ini, int section, const char* key) { return ini_value_as_bool(&ini, section, key); }
+inline ini_list_t ini_value_as_list(const ini_t& ini, int section, const char* key) { return ini_value_as_list(&ini, section, key); }
+inline bool ini_list_next(ini_list_t& list, ini_span_t& item) { return ini_list_next(&list, &item); }
+inline ini_keys_t ini_keys_with_prefix(const ini_t& ini, int section, const char* prefix) { return ini_keys_with_prefix(&ini, section, prefix); }
+inline ini_keys_t ini_keys_matching(const ini_t& ini, int section, const char* pattern) { return ini_keys_matching(&ini, section, pattern); }
+inline bool ini_keys_next(ini_keys_t& keys, ini_span_t& key, ini_span_t& value) { return ini_keys_next(&keys, &key, &value); }
+inline size_t ini_value_as_int_array(const ini_t& ini, int section, const char* key, int64_t* out, size_t cap) { return ini_value_as_int_array(&ini, section, key, out, cap); }
+inline bool ini_set_value(ini_t& ini, int section, const char* key, const char* value) { return ini_set_value(&ini, section, key, value); }
+inline bool ini_interpolate(ini_t& ini) { return ini_interpolate(&ini); }
+inline size_t ini_num_cyclic(const ini_t& ini) { return ini_num_cyclic(&ini); }
+inline size_t ini_apply_env(ini_t& ini, const char* prefix) { return ini_apply_env(&ini, prefix); }
+inline ini_hash_t ini_fingerprint(const ini_t& ini) { return ini_fingerprint(&ini); }
+inline int ini_diff(const ini_t& a, const ini_t& b, ini_diff_func func, void* user) { return ini_diff(&a, &b, func, user); }
+inline bool ini_get_stats(const ini_t& ini, ini_stats_t& stats) { return ini_get_stats(&ini, &stats); }
+inline size_t ini_image_write(const ini_t& ini, void* dst, size_t cap) { return ini_image_write(&ini, dst, cap); }
+#if defined(FS_INCLUDED)
+inline bool ini_shared_publish(ini_shared_t& shared, const ini_t& ini) { return ini_shared_publish(&shared, &ini); }
+inline bool ini_editor_write(const ini_editor_t& editor, const char* name) { return ini_editor_write(&editor, name); }
+#endif
+inline bool ini_editor_set_value(ini_editor_t& editor, int section, const char* key, const char* value) { return ini_editor_set_value(&editor, section, key, value); }
+inline int ini_editor_add_section(ini_editor_t& editor, const char* name) { return ini_editor_add_section(&editor, name); }
+inline size_t ini_editor_spans(const ini_editor_t& editor, ini_span_t* out, size_t cap) { return ini_editor_spans(&editor, out, cap); }
+inline ini_version_t* ini_version_create(const ini_t& ini) { return ini_version_create(&ini); }
+inline ini_version_t* ini_version_set(const ini_version_t& version, const char* section, const char* key, const char* value) { return ini_version_set(&version, section, key, value); }
+inline const char* ini_version_value(const ini_version_t& version, const char* section, const char* key) { return ini_version_value(&version, section, key); }
+inline size_t ini_version_num_properties(const ini_version_t& version) { return ini_version_num_properties(&version); }
+inline int ini_version_diff(const ini_version_t& a, const ini_version_t& b, ini_diff_func func, void* user) { return ini_version_diff(&a, &b, func, user); }
 
 #endif
 #endif /* INI_INCLUDED */
@@ -151,6 +943,7 @@ inline bool ini_value_as_bool(const ini_t& ini, int section, const char* key) {
 #ifdef INI_IMPLEMENTATION
 #define INI_IMPL_INCLUDED (1)
 
+#include <stdlib.h> /* atoi, atof, getenv */
 #include <string.h>
 
 #if !defined(INI_ASSERT)
@@ -172,62 +965,413 @@ inline bool ini_value_as_bool(const ini_t& ini, int section, const char* key) {
 #endif
 
 #define INI_INITIAL_CAPACITY (256)
-#define _INI_BUF_SIZE_DEF (16*1024)
+#define _INI_CHUNK_SIZE (4*1024)
+#define _INI_MAX_ENV_NAME (256)
+#define _INI_MAX_SHARED_NAME (224)
+#define _INI_IMAGE_MAGIC "INIIMG01"
+#define _INI_SHARED_MAGIC "INISHM01"
+
+#if defined(_MSC_VER)
+  #include <intrin.h>
+  #define _ini_atomic_load(p) _InterlockedOr((volatile long*) (p), 0)
+  #define _ini_atomic_store(p, v) _InterlockedExchange((volatile long*) (p), (v))
+  #define _ini_atomic_cas(p, expected, desired) (_InterlockedCompareExchange((volatile long*) (p), (desired), (expected)) == (expected))
+  #define _ini_atomic_or64(p, v) _InterlockedOr64((volatile long long*) (p), (long long) (v))
+  #define _ini_atomic_peek64(p) (*(volatile const uint64_t*) (p))
+  /* the generation is read from a read-only mapping, so it can't be an
+     interlocked operation; a volatile read only acquires on x86 and x64 */
+  #if defined(_M_ARM64) || defined(_M_ARM64EC)
+    #define _ini_atomic_load64(p) ((uint64_t) __ldar64((volatile unsigned __int64*) (p)))
+  #else
+    #define _ini_atomic_load64(p) (*(volatile const uint64_t*) (p))
+  #endif
+  #define _ini_atomic_store64(p, v) _InterlockedExchange64((volatile long long*) (p), (long long) (v))
+  #define _ini_atomic_add(p, v) (_InterlockedExchangeAdd((volatile long*) (p), (v)) + (v))
+  #define _ini_yield()
+#else
+  #include <sched.h>
+  #define _ini_atomic_load(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+  #define _ini_atomic_store(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+  #define _ini_atomic_cas(p, expected, desired) __extension__ ({ int _e = (expected); __atomic_compare_exchange_n((p), &_e, (desired), false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE); })
+  #define _ini_atomic_or64(p, v) __atomic_fetch_or((p), (v), __ATOMIC_RELAXED)
+  #define _ini_atomic_peek64(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+  #define _ini_atomic_load64(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+  #define _ini_atomic_store64(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+  #define _ini_atomic_add(p, v) __atomic_add_fetch((p), (v), __ATOMIC_ACQ_REL)
+  #define _ini_yield() sched_yield()
+#endif
+
+#if !defined(_INI_LITTLE_ENDIAN)
+  #if (defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)) || defined(_M_IX86) || defined(_M_X64) || defined(_M_ARM64)
+    #define _INI_LITTLE_ENDIAN (1)
+  #else
+    #define _INI_LITTLE_ENDIAN (0)
+  #endif
+#endif
+
+/* the environment scanned by `ini_apply_env` */
+#if defined(_WIN32)
+  #define _ini_environ _environ
+#elif defined(__APPLE__)
+  #include <crt_externs.h>
+  #define _ini_environ (*_NSGetEnviron())
+#else
+  #if defined(__cplusplus)
+  extern "C" char** environ;
+  #else
+  extern char** environ;
+  #endif
+  #define _ini_environ environ
+#endif
+
+#if defined(INI_STATS)
+  #include <time.h>
+  #define _INI_STAT(x) x
+#else
+  #define _INI_STAT(x)
+#endif
 
 /* private implementation functions */
 
+/* offsets into the buffer, and the sizes of the index tables; documents
+   and tables are limited to the largest positive offset. */
+#if defined(INI_64BIT_OFFSETS)
+typedef int64_t _ini_off_t;
+#define _INI_MAX_OFFSET (INT64_MAX)
+#else
+typedef int32_t _ini_off_t;
+#define _INI_MAX_OFFSET (INT32_MAX)
+#endif
+
+/* section states */
+enum {
+  _INI_SECTION_PENDING,
+  _INI_SECTION_PARSING,
+  _INI_SECTION_READY,
+};
+
+/* the properties of a section occupy `count` of the `cap` slots starting
+   at `first`, sections of lazy documents also know their byte range.
+   `hash` is the sum of the hashes of its properties. Sections form a tree
+   through `parent`, `child` and `next`, where 0 stands for none as the
+   global section is never a child. `tail` is the offset of the line that
+   follows its last property, or its header. `sorted` points
+   into `order` at the positions of its properties sorted by key, once a
+   key query needs them. */
 typedef struct {
-  int name;
+  ini_hash_t hash;
+  _ini_off_t name;
+  _ini_off_t first;
+  _ini_off_t count;
+  _ini_off_t cap;
+  _ini_off_t begin;
+  _ini_off_t end;
+  _ini_off_t tail;
+  int parent;
+  int child;
+  int next;
+  int state;
+  int order_state;
+  _ini_off_t order_cap;
+  _ini_off_t* order;
+  const _ini_off_t* sorted;
 } _ini_section_t;
 
+/* properties are stored as parallel arrays indexed by slot; lookups scan
+   `hash` and only read the other arrays, or the strings, on a match. */
+typedef struct {
+  uint64_t* prefix;       /* first eight bytes of the key, zero padded */
+  _ini_off_t* key;
+  _ini_off_t* key_len;
+  _ini_off_t* value;
+  _ini_off_t* value_len;
+  uint32_t* hash;         /* hash of the key */
+} _ini_properties_t;
+
+/* strings created after parsing live in a list of chunks that is only
+   released with the document, so pointers into it stay valid. */
+typedef struct _ini_chunk_t {
+  struct _ini_chunk_t* next;
+  size_t used;
+  size_t cap;
+} _ini_chunk_t;
+
+/* template states */
+enum {
+  _INI_UNRESOLVED,
+  _INI_RESOLVING,
+  _INI_RESOLVED,
+  _INI_CYCLIC,
+};
+
+/* a value with references, resolved from its `raw` text. its references
+   are `edges[first .. first + count)`; a value set without any keeps its
+   template, resolved, so templates never move once they are added. */
+typedef struct {
+  int section;
+  _ini_off_t property;
+  _ini_off_t raw;
+  int state;
+  _ini_off_t first;
+  _ini_off_t count;
+} _ini_template_t;
+
+/* a reference of template `tmpl`, the `len` bytes at `name` into its raw
+   text. edges are chained through `next`, index + 1, by the hash of the
+   section and key they reference, to find the templates that depend on a
+   value. the value referenced is at `pos` in `section`, INI_NOT_FOUND if
+   missing, and `dep` is its template if it has one. the edges of a
+   template that changed are dropped by clearing `tmpl`. */
+typedef struct {
+  int tmpl;
+  int dep;
+  _ini_off_t next;
+  uint32_t hash;
+  _ini_off_t name;
+  _ini_off_t len;
+  int section;
+  _ini_off_t pos;
+} _ini_edge_t;
+
+/* a template being resolved, and the next of its edges to follow */
+typedef struct {
+  int tmpl;
+  _ini_off_t edge;
+  bool acyclic;
+} _ini_frame_t;
+
+/* a value overridden by an environment variable, with the text it had */
+typedef struct {
+  int section;
+  _ini_off_t key;
+  _ini_off_t value;
+  bool seen;
+} _ini_override_t;
+
+/* a property parsed with a policy for duplicates, checked once it is
+   resolved: its position in its section and the line that set it */
+typedef struct {
+  int section;
+  _ini_off_t pos;
+  size_t line;
+} _ini_deferred_t;
+
+/* a schema being checked while parsing. `table` holds the rules by the
+   hash of their section and key, as an index + 1, 0 when empty, next to
+   that hash to compare before the names. `line`
+   is the line being parsed, which the tokenizer only tracks for it.
+   `deferred` holds the properties to check after parsing when a policy
+   for duplicates can still replace or drop them. */
+typedef struct {
+  const ini_rule_t* rules;
+  size_t num_rules;
+  ini_violation_func func;
+  void* user;
+  uint32_t (*table)[2];
+  size_t mask;
+  bool* seen;
+  int section;
+  uint32_t section_hash;
+  size_t line;
+  _ini_deferred_t* deferred;
+  size_t num_deferred;
+  size_t cap_deferred;
+} _ini_schema_t;
+
+/* a key parsed into a section that resolves duplicates, by its position + 1 */
 typedef struct {
+  uint32_t hash;
   int section;
-  int key;
-  int value;
-} _ini_property_t;
+  _ini_off_t pos;
+} _ini_key_entry_t;
+
+/* the duplicate policies being applied while parsing. `keys` holds every
+   key parsed so far by the hash of its section and name, `names` every
+   section by the hash of its name. entries of a section emptied by a
+   repeated header are left in `keys`, they are checked against the
+   section before they are used. */
+typedef struct {
+  ini_duplicate_t on_key;
+  ini_duplicate_t on_section;
+  _ini_key_entry_t* keys;
+  size_t keys_mask;
+  size_t num_keys;
+  int* names;
+  size_t names_mask;
+  size_t num_names;
+} _ini_duplicates_t;
 
+/* strings are referenced by their offset into `buf`, or by the complement
+   of their index into `strings` for strings in the arena. the global
+   section is the first of the sections. `bloom` is a filter of section
+   and key pairs sized for `bloom_keys` properties, none when zero.
+   `names` holds the sections by name, it is current while `num_names` is
+   the number of sections. the first `num_orders` sections hold sort
+   buffers, which are kept for the sections loaded after a reset. `template_map` holds the templates by section
+   and position, as an index + 1, `edge_heads` the chains of their edges.
+
+   a clone shares the index of its `base`: the slots below `shared_slots`
+   are the base's, its own slots follow them, and while `borrowed` its
+   sections, strings, templates, overrides and filter are the base's too. `refs`
+   counts the clones of a document, which is freed by the last of them.
+   `lazy` is set until all sections of a lazy document are tokenized. */
 struct ini_t {
   _ini_section_t* sections;
-  _ini_property_t* properties;
-  int num_sections;
-  int num_properties;
+  _ini_properties_t properties;
+  _ini_off_t num_sections;
+  _ini_off_t num_orders;
+  _ini_off_t num_slots;
+  _ini_off_t cap_sections;
+  _ini_off_t cap_slots;
   char* buf;
+  size_t size;
+  size_t cap_buf;
+  bool mapped;
+  char** strings;
+  _ini_off_t num_strings;
+  _ini_off_t cap_strings;
+  _ini_chunk_t* arena;
+  _ini_chunk_t* spare;
+  uint64_t* bloom;
+  size_t bloom_mask;
+  size_t cap_bloom;
+  _ini_off_t bloom_keys;
+  _ini_off_t bloom_count;
+  int* names;
+  size_t cap_names;
+  _ini_off_t num_names;
+  _ini_off_t* source;
+  _ini_template_t* templates;
+  _ini_off_t num_templates;
+  _ini_off_t cap_templates;
+  int* template_map;
+  size_t cap_template_map;
+  _ini_edge_t* edges;
+  _ini_off_t num_edges;
+  _ini_off_t cap_edges;
+  _ini_off_t dead_edges;
+  _ini_off_t* edge_heads;
+  size_t cap_edge_heads;
+  _ini_off_t num_cyclic;
+  _ini_override_t* overrides;
+  _ini_off_t num_overrides;
+  _ini_off_t cap_overrides;
+  bool interpolated;
+  const void* image;
+  const _ini_off_t* sorted;
+  _ini_schema_t* schema;
+  _ini_duplicates_t* duplicates;
+  size_t violations;
+  bool utf8;
+  bool invalid;
+  int lazy;
+  ini_t* base;
+  _ini_off_t shared_slots;
+  bool borrowed;
+  int refs;
+#if defined(INI_STATS)
+  ini_stats_t stats;
+#endif
 };
 
-/* parser state */
-enum {
-  _INI_EXPECT_NONE = (0 << 0),
-  _INI_EXPECT_KEY =  (1 << 0),
-  _INI_EXPECT_SEP =  (1 << 1),
-  _INI_EXPECT_VAL =  (1 << 2),
-  _INI_PARSING_KEY = (1 << 3),
-  _INI_PARSING_VAL = (1 << 4),
-};
+/* an image starts with this header, followed by the arrays of the index
+   at the offsets it records; strings are stored null terminated, and
+   every reference to a string is an offset into them. */
+typedef struct {
+  char magic[8];
+  uint64_t size;
+  uint32_t offset_size;
+  uint32_t section_size;
+  uint64_t num_sections;
+  uint64_t num_slots;
+  uint64_t bloom_words;
+  uint64_t bloom_keys;
+  uint64_t cap_names;
+  uint64_t strings_size;
+  uint64_t sections;
+  uint64_t prefix;
+  uint64_t key;
+  uint64_t key_len;
+  uint64_t value;
+  uint64_t value_len;
+  uint64_t hash;
+  uint64_t bloom;
+  uint64_t names;
+  uint64_t sorted;
+  uint64_t strings;
+} _ini_image_t;
 
-_INI_PRIVATE inline bool _ini_any_expected(int state) {
-  const int flags = (_INI_EXPECT_KEY | _INI_EXPECT_VAL | _INI_EXPECT_SEP);
-  return (state & (flags)) != _INI_EXPECT_NONE;
-}
+/* a patch replaces `[begin, end)` of the source with `text`. `source` of
+   a property, and `tail` of a section, hold the id of the patch that
+   wrote them as a negative `~id` once they have one; properties added to
+   a section that already has a line are a `line` inserted at its tail,
+   sections added by the editor a single patch of all their lines. */
+typedef struct {
+  _ini_off_t begin;
+  _ini_off_t end;
+  char* text;
+  size_t len;
+  bool line;
+} _ini_patch_t;
 
-_INI_PRIVATE inline bool _ini_key_expected(int state) {
-  return (state & _INI_EXPECT_KEY) != _INI_EXPECT_NONE;
-}
+struct ini_editor_t {
+  ini_t* ini;
+  const char* source;
+  size_t size;
+  _ini_patch_t* patches;
+  _ini_off_t num_patches;
+  _ini_off_t cap_patches;
+  _ini_off_t* order;        /* patches by `begin`, in the order they were made when equal */
+  _ini_off_t cap_order;
+  const char* newline;      /* "\r\n" if the first line of the source ends with it, "\n" otherwise */
+};
 
-_INI_PRIVATE inline bool _ini_val_expected(int state) {
-  return (state & _INI_EXPECT_VAL) != _INI_EXPECT_NONE;
-}
+/* a property of a version, followed by its section, key and value, each
+   null terminated */
+typedef struct {
+  int refs;
+  uint32_t hash;
+  _ini_off_t section_len;
+  _ini_off_t key_len;
+  _ini_off_t value_len;
+} _ini_leaf_t;
 
-_INI_PRIVATE inline bool _ini_parsing_key(int state) {
-  return (state & _INI_PARSING_KEY) != _INI_EXPECT_NONE;
-}
+/* a node of the hash trie of a version, indexed by five bits of the hash
+   of a section and key per level. it is followed by the leaves, then the
+   children, of the slots set in `leaves` and `nodes`; a node below the
+   last bit of the hash holds `collisions` leaves instead. nodes and leaves
+   are shared between versions and never change once made. */
+typedef struct {
+  int refs;
+  uint32_t leaves;
+  uint32_t nodes;
+  uint32_t collisions;
+} _ini_hamt_t;
 
-_INI_PRIVATE inline bool _ini_parsing_val(int state) {
-  return (state & _INI_PARSING_VAL) != _INI_EXPECT_NONE;
-}
+struct ini_version_t {
+  _ini_hamt_t* root;
+  size_t count;
+};
 
-_INI_PRIVATE inline bool _ini_is_bracket(char c) {
-  return ((c == '[') || (c == ']'));
-}
+#if defined(FS_INCLUDED)
+/* the generation is the only thing a publisher writes after creating it */
+typedef struct {
+  char magic[8];
+  uint64_t generation;
+} _ini_shared_control_t;
+
+struct ini_shared_t {
+  char name[_INI_MAX_SHARED_NAME];
+  bool publisher;
+  _ini_shared_control_t* control;
+  uint64_t generation;
+  void* published;
+  size_t published_size;
+  const void* image;
+  size_t image_size;
+  ini_t* ini;
+};
+#endif
 
 _INI_PRIVATE inline bool _ini_is_whitespace(char c) {
   return ((c == ' ') || (c == '\t'));
@@ -241,166 +1385,3048 @@ _INI_PRIVATE inline bool _ini_is_comment(char c) {
   return ((c == ';') || (c == '#'));
 }
 
-_INI_PRIVATE inline bool _ini_is_newline(char c) {
-  return (c == '\n');
+_INI_PRIVATE inline bool _ini_is_quote(char c) {
+  return ((c == '"') || (c == '\''));
 }
 
-_INI_PRIVATE inline void _ini_start_section(ini_t* ini, int pos, int* state) {
-  *state = _INI_PARSING_KEY;
-  ini->sections[ini->num_sections].name = pos;
+_INI_PRIVATE inline char _ini_unescape(char c) {
+  switch (c) {
+  case 'n': return '\n';
+  case 't': return '\t';
+  case 'r': return '\r';
+  default: return c;
+  }
 }
 
-_INI_PRIVATE inline void _ini_start_key(ini_t* ini, int pos, int* state) {
-  *state = _INI_PARSING_KEY;
-  ini->properties[ini->num_properties].section = ini->num_sections;
-  ini->properties[ini->num_properties].key = pos;
+_INI_PRIVATE inline const char* _ini_str(const ini_t* ini, _ini_off_t ref) {
+  return (ref >= 0) ? &ini->buf[ref] : ini->strings[~ref];
 }
 
-_INI_PRIVATE inline void _ini_start_val(ini_t* ini, int pos, int* state) {
-  *state = _INI_PARSING_VAL;
-  ini->properties[ini->num_properties].value = pos;
+/* compares a null terminated string against `len` characters of `key` */
+_INI_PRIVATE inline bool _ini_str_equal(const char* str, const char* key, size_t len) {
+  return strncmp(str, key, len) == 0 && str[len] == '\0';
 }
 
-_INI_PRIVATE inline const char* _ini_str(const ini_t* ini, int index) {
-  return &ini->buf[index];
+#if defined(INI_STATS)
+_INI_PRIVATE unsigned long long _ini_now_ns(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (unsigned long long) ts.tv_sec * 1000000000ull + (unsigned long long) ts.tv_nsec;
 }
 
-_INI_PRIVATE ini_t* _ini_parse_data(const char* src) {
-  int parser_state = _INI_EXPECT_KEY;
-  bool in_bracket = false;
-  int buf_pos = 0;
-  ini_t* ini = ini_create();
-  
-  char c;
-  while ((c = *src++) != 0) {
-    /* handle comment: */
-    if (_ini_is_comment(c)) {
-      while (!_ini_is_newline(c)) {
-        c = *src++;
-      }
-      continue;
-    }
-    /* get expected: */
-    if (_ini_any_expected(parser_state)) {
-      if (_ini_is_whitespace(c)) {
-        continue;
-      }
-      if (_ini_key_expected(parser_state)) {
-        if (_ini_is_bracket(c)) {
-          in_bracket = true;
-          _ini_start_section(ini, buf_pos, &parser_state);
-          continue;
-        }
-        _ini_start_key(ini, buf_pos, &parser_state);
-      }
-      else if (_ini_val_expected(parser_state)) {
-        _ini_start_val(ini, buf_pos, &parser_state);
-      }
-      else {
-        if (_ini_is_delimeter(c)) {
-          parser_state = _INI_EXPECT_VAL;
-          continue;
-        }
-      }
-    }
-    /* begin parsing: */
-    if (_ini_parsing_key(parser_state)) {
-      if (in_bracket) {
-        if (_ini_is_bracket(c)) {
-          in_bracket = false;
-          ini->buf[buf_pos++] = '\0';
-          ini->num_sections++;
-          parser_state = _INI_EXPECT_KEY;
-          continue;
-        }
-      }
-      if (_ini_is_whitespace(c) || _ini_is_delimeter(c)) {
-        ini->buf[buf_pos++] = '\0';
-        parser_state = _ini_is_delimeter(c) ? _INI_EXPECT_VAL : _INI_EXPECT_SEP;
-        continue;
-      }
-    }
-    else if (_ini_parsing_val(parser_state)) {
-      if (_ini_is_newline(c)) {
-        ini->buf[buf_pos++] = '\0';
-        ini->num_properties++;
-        parser_state = _INI_EXPECT_KEY;
-        continue;
-      }
-    }
-    /* handle newline: */
-    if (_ini_is_newline(c)) {
-      continue;
-    }
-    ini->buf[buf_pos++] = c;
+/* lookups take a const document, the counters are the only state they touch */
+_INI_PRIVATE void _ini_stat_lookup(const ini_t* ini, bool hit, size_t probes) {
+  ini_stats_t* stats = &((ini_t*) ini)->stats;
+  stats->lookups++;
+  stats->hits += hit ? 1 : 0;
+  stats->misses += hit ? 0 : 1;
+  stats->probes += probes;
+  stats->max_probes = (probes > stats->max_probes) ? probes : stats->max_probes;
+}
+#endif
+
+_INI_PRIVATE inline char* _ini_skip_whitespace(char* p, const char* end) {
+  while (p < end && _ini_is_whitespace(*p)) {
+    p++;
   }
-  if (_ini_parsing_val(parser_state)) {
-    ini->buf[buf_pos++] = '\0';
-    ini->num_properties++;
+  return p;
+}
+
+_INI_PRIVATE inline char* _ini_trim_whitespace(const char* begin, char* p) {
+  while (p > begin && _ini_is_whitespace(p[-1])) {
+    p--;
   }
-  return ini;
+  return p;
 }
 
+/* hashing */
+
+#define _INI_HASH_K0 (0x9E3779B97F4A7C15ull)
+#define _INI_HASH_K1 (0xC2B2AE3D27D4EB4Full)
+
+_INI_PRIVATE inline uint64_t _ini_load64(const char* p, size_t len) {
+  uint64_t v = 0;
+#if _INI_LITTLE_ENDIAN
+  memcpy(&v, p, len);
+#else
+  for (size_t i = 0; i < len; i++) {
+    v |= (uint64_t) (unsigned char) p[i] << (i * 8);
+  }
+#endif
+  return v;
+}
+
+_INI_PRIVATE inline uint64_t _ini_mix64(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xFF51AFD7ED558CCDull;
+  x ^= x >> 33;
+  x *= 0xC4CEB9FE1A85EC53ull;
+  x ^= x >> 33;
+  return x;
+}
+
+/* hashes eight bytes at a time into two independent lanes */
+_INI_PRIVATE ini_hash_t _ini_hash(const char* p, size_t len, ini_hash_t seed) {
+  uint64_t a = seed.lo ^ (len * _INI_HASH_K0);
+  uint64_t b = seed.hi ^ (len * _INI_HASH_K1);
+  for (; len > 0; p += 8) {
+    const size_t n = (len < 8) ? len : 8;
+    const uint64_t w = _ini_load64(p, n);
+    a = (a ^ w) * _INI_HASH_K0;
+    a ^= a >> 32;
+    b = (b ^ w) * _INI_HASH_K1;
+    b ^= b >> 29;
+    len -= n;
+  }
+  ini_hash_t h = { _ini_mix64(a), _ini_mix64(b) };
+  return h;
+}
+
+/* a cheaper hash for keys, only used to reject mismatches */
+_INI_PRIVATE inline uint32_t _ini_key_hash(const char* p, size_t len) {
+  uint64_t h = len * _INI_HASH_K0;
+  for (; len > 0; p += 8) {
+    const size_t n = (len < 8) ? len : 8;
+    h = (h ^ _ini_load64(p, n)) * _INI_HASH_K1;
+    h ^= h >> 29;
+    len -= n;
+  }
+  return (uint32_t) (h >> 32);
+}
+
+_INI_PRIVATE inline uint64_t _ini_key_prefix(const char* p, size_t len) {
+  return _ini_load64(p, (len < 8) ? len : 8);
+}
+
+_INI_PRIVATE ini_hash_t _ini_hash_property(const char* key, size_t key_len, const char* value, size_t value_len) {
+  const ini_hash_t seed = { _INI_HASH_K0, _INI_HASH_K1 };
+  return _ini_hash(value, value_len, _ini_hash(key, key_len, seed));
+}
+
+_INI_PRIVATE inline void _ini_hash_add(ini_hash_t* h, ini_hash_t v) {
+  h->lo += v.lo;
+  h->hi += v.hi;
+}
+
+_INI_PRIVATE inline void _ini_hash_sub(ini_hash_t* h, ini_hash_t v) {
+  h->lo -= v.lo;
+  h->hi -= v.hi;
+}
+
+/* grows an array of `count` elements to hold at least `needed` */
+_INI_PRIVATE void* _ini_grow_to(void* ptr, _ini_off_t count, _ini_off_t needed, _ini_off_t* capacity, size_t size) {
+  if (needed <= *capacity) {
+    return ptr;
+  }
+  INI_ASSERT(needed < _INI_MAX_OFFSET);
+  _ini_off_t new_capacity = (*capacity > 0) ? *capacity : INI_INITIAL_CAPACITY;
+  while (new_capacity < needed) {
+    new_capacity = (new_capacity < _INI_MAX_OFFSET / 2) ? new_capacity * 2 : _INI_MAX_OFFSET;
+  }
+  void* new_ptr = INI_MALLOC(new_capacity * size);
+  INI_ASSERT(new_ptr);
+  if (ptr) {
+    memcpy(new_ptr, ptr, count * size);
+    INI_FREE(ptr);
+  }
+  *capacity = new_capacity;
+  return new_ptr;
+}
+
+_INI_PRIVATE void* _ini_grow(void* ptr, _ini_off_t count, _ini_off_t* capacity, size_t size) {
+  return _ini_grow_to(ptr, count, count + 1, capacity, size);
+}
+
+_INI_PRIVATE void _ini_add_section(ini_t* ini, _ini_off_t name) {
+  INI_ASSERT(ini->num_sections < INT32_MAX);
+  ini->sections = (_ini_section_t*) _ini_grow(ini->sections, ini->num_sections, &ini->cap_sections, sizeof(_ini_section_t));
+  _ini_section_t* section = &ini->sections[ini->num_sections++];
+  /* reuse the sort buffer a section held before a reset, marked pending */
+  _ini_off_t* order = NULL;
+  _ini_off_t order_cap = 0;
+  if (ini->num_sections <= ini->num_orders) {
+    order = section->order;
+    order_cap = section->order_cap;
+  }
+  memset(section, 0, sizeof(_ini_section_t));
+  section->order = order;
+  section->order_cap = order_cap;
+  ini->num_orders = (ini->num_sections > ini->num_orders) ? ini->num_sections : ini->num_orders;
+  section->name = name;
+  section->first = ini->num_slots;
+  section->state = _INI_SECTION_READY;
+}
+
+/* returns the first section named `name`, or 0, from the table of names */
+_INI_PRIVATE int _ini_find_name(const ini_t* ini, const char* name, size_t len) {
+  const size_t mask = ini->cap_names - 1;
+  for (size_t i = _ini_key_hash(name, len) & mask;; i = (i + 1) & mask) {
+    const int s = ini->names[i];
+    if (s == 0 || _ini_str_equal(_ini_str(ini, ini->sections[s].name), name, len)) {
+      return s;
+    }
+  }
+}
+
+/* links every section to the nearest section its dotted name extends; the
+   children of a section are linked in reverse to keep the document order.
+   Sections added after loading are linked by linking them all again. */
+_INI_PRIVATE void _ini_link_sections(ini_t* ini) {
+  size_t cap = 16;
+  while (cap < (size_t) ini->num_sections * 2) {
+    cap *= 2;
+  }
+  if (cap > ini->cap_names) {
+    INI_FREE(ini->names);
+    ini->names = (int*) INI_MALLOC(cap * sizeof(int));
+    INI_ASSERT(ini->names);
+    ini->cap_names = cap;
+  }
+  memset(ini->names, 0, ini->cap_names * sizeof(int));
+  const size_t mask = ini->cap_names - 1;
+  ini->sections[INI_GLOBAL_SECTION].child = 0;
+  for (int s = 1; s < ini->num_sections; s++) {
+    ini->sections[s].child = 0;
+    const char* name = _ini_str(ini, ini->sections[s].name);
+    const size_t len = strlen(name);
+    size_t i = _ini_key_hash(name, len) & mask;
+    while (ini->names[i] != 0 && !_ini_str_equal(_ini_str(ini, ini->sections[ini->names[i]].name), name, len)) {
+      i = (i + 1) & mask;
+    }
+    if (ini->names[i] == 0) {
+      ini->names[i] = s;
+    }
+  }
+  ini->num_names = ini->num_sections;
+  for (int s = ini->num_sections - 1; s > 0; s--) {
+    _ini_section_t* section = &ini->sections[s];
+    const char* name = _ini_str(ini, section->name);
+    size_t len = strlen(name);
+    int parent = INI_GLOBAL_SECTION;
+    while (parent == INI_GLOBAL_SECTION && len > 0) {
+      while (len > 0 && name[--len] != '.') {}
+      parent = (len > 0) ? _ini_find_name(ini, name, len) : INI_GLOBAL_SECTION;
+    }
+    section->parent = parent;
+    section->next = ini->sections[parent].child;
+    ini->sections[parent].child = s;
+  }
+}
+
+/* returns the length of the component of a child's name that `path`
+   starts with, up to a dot or its end, or 0 if it doesn't */
+_INI_PRIVATE size_t _ini_path_step(const char* name, const char* path) {
+  size_t len = 0;
+  while (name[len] != '\0' && name[len] == path[len]) {
+    len++;
+  }
+  return (name[len] == '\0' && (path[len] == '\0' || path[len] == '.')) ? len : 0;
+}
+
+/* the properties that hold slot `i`, which are a base's for the shared
+   slots of a clone; a section's slots are always held together. */
+_INI_PRIVATE inline const _ini_properties_t* _ini_props(const ini_t* ini, _ini_off_t i) {
+  while (i < ini->shared_slots) {
+    ini = ini->base;
+  }
+  return &ini->properties;
+}
+
+/* the filter is blocked: a section and key pair sets two bits of a
+   single word, so a lookup tests them with one load. */
+_INI_PRIVATE inline uint64_t _ini_bloom_bits(int section, uint32_t hash, size_t* word, size_t mask) {
+  const uint64_t x = _ini_mix64(((uint64_t) hash << 32) | (uint32_t) section);
+  *word = (size_t) (x >> 32) & mask;
+  return (1ull << (x & 63)) | (1ull << ((x >> 6) & 63));
+}
+
+_INI_PRIVATE inline void _ini_bloom_insert(ini_t* ini, int section, uint32_t hash) {
+  size_t word;
+  const uint64_t bits = _ini_bloom_bits(section, hash, &word, ini->bloom_mask);
+  /* lazy sections are tokenized, and inserted, concurrently */
+  _ini_atomic_or64(&ini->bloom[word], bits);
+}
+
+/* false if the section certainly has no such key */
+_INI_PRIVATE inline bool _ini_bloom_test(const ini_t* ini, int section, uint32_t hash) {
+  if (ini->bloom_keys == 0) {
+    return true;
+  }
+  size_t word;
+  const uint64_t bits = _ini_bloom_bits(section, hash, &word, ini->bloom_mask);
+  return (_ini_atomic_peek64(&ini->bloom[word]) & bits) == bits;
+}
+
+/* sizes the filter to 16 bits per property and adds the properties of
+   every tokenized section. */
+_INI_PRIVATE void _ini_bloom_build(ini_t* ini, _ini_off_t keys) {
+  size_t words = 1;
+  while (words * 4 < (size_t) keys) {
+    words *= 2;
+  }
+  if (words > ini->cap_bloom) {
+    INI_FREE(ini->bloom);
+    ini->bloom = (uint64_t*) INI_MALLOC(words * sizeof(uint64_t));
+    INI_ASSERT(ini->bloom);
+    ini->cap_bloom = words;
+  }
+  memset(ini->bloom, 0, words * sizeof(uint64_t));
+  ini->bloom_mask = words - 1;
+  ini->bloom_keys = (keys > 0) ? keys : 1;
+  ini->bloom_count = 0;
+  for (int s = 0; s < ini->num_sections; s++) {
+    const _ini_section_t* sec = &ini->sections[s];
+    if (sec->state != _INI_SECTION_READY) {
+      continue;
+    }
+    const _ini_properties_t* props = _ini_props(ini, sec->first);
+    for (_ini_off_t i = sec->first; i < sec->first + sec->count; i++) {
+      size_t word;
+      const uint64_t bits = _ini_bloom_bits(s, props->hash[i], &word, ini->bloom_mask);
+      ini->bloom[word] |= bits;
+    }
+    ini->bloom_count += sec->count;
+  }
+}
+
+/* grows the property arrays to hold at least `needed` slots, they share
+   a single allocation ordered by alignment. */
+_INI_PRIVATE void _ini_grow_properties(ini_t* ini, _ini_off_t needed) {
+  if (needed <= ini->cap_slots) {
+    return;
+  }
+  INI_ASSERT(needed < _INI_MAX_OFFSET);
+  _ini_off_t cap = (ini->cap_slots > 0) ? ini->cap_slots : INI_INITIAL_CAPACITY;
+  while (cap < needed) {
+    cap = (cap < _INI_MAX_OFFSET / 2) ? cap * 2 : _INI_MAX_OFFSET;
+  }
+  const size_t slot = sizeof(uint64_t) + sizeof(_ini_off_t) * 4 + sizeof(uint32_t);
+  char* block = (char*) INI_MALLOC((size_t) cap * slot);
+  INI_ASSERT(block);
+  _ini_properties_t* old = &ini->properties;
+  _ini_properties_t props;
+  props.prefix = (uint64_t*) block;
+  props.key = (_ini_off_t*) (props.prefix + cap);
+  props.key_len = props.key + cap;
+  props.value = props.key_len + cap;
+  props.value_len = props.value + cap;
+  props.hash = (uint32_t*) (props.value_len + cap);
+  if (old->prefix != NULL) {
+    /* the shared slots of a clone are left unused */
+    const size_t i = (size_t) ini->shared_slots, n = (size_t) (ini->num_slots - ini->shared_slots);
+    memcpy(props.prefix + i, old->prefix + i, n * sizeof(uint64_t));
+    memcpy(props.key + i, old->key + i, n * sizeof(_ini_off_t));
+    memcpy(props.key_len + i, old->key_len + i, n * sizeof(_ini_off_t));
+    memcpy(props.value + i, old->value + i, n * sizeof(_ini_off_t));
+    memcpy(props.value_len + i, old->value_len + i, n * sizeof(_ini_off_t));
+    memcpy(props.hash + i, old->hash + i, n * sizeof(uint32_t));
+    INI_FREE(old->prefix);
+  }
+  ini->properties = props;
+  ini->cap_slots = cap;
+  if (ini->source != NULL) {
+    _ini_off_t* source = (_ini_off_t*) INI_MALLOC((size_t) cap * 2 * sizeof(_ini_off_t));
+    INI_ASSERT(source);
+    memcpy(source, ini->source, (size_t) ini->num_slots * 2 * sizeof(_ini_off_t));
+    INI_FREE(ini->source);
+    ini->source = source;
+  }
+}
+
+/* moves a section to the end of the slots with room for `cap` properties;
+   this is also how a clone copies a section it shares before writing it. */
+_INI_PRIVATE void _ini_move_section(ini_t* ini, int section, _ini_off_t cap) {
+  _ini_section_t* sec = &ini->sections[section];
+  _ini_grow_properties(ini, ini->num_slots + cap);
+  const _ini_properties_t* from = _ini_props(ini, sec->first);
+  _ini_properties_t* props = &ini->properties;
+  const _ini_off_t dst = ini->num_slots, src = sec->first;
+  const size_t n = (size_t) sec->count;
+  memcpy(props->prefix + dst, from->prefix + src, n * sizeof(uint64_t));
+  memcpy(props->key + dst, from->key + src, n * sizeof(_ini_off_t));
+  memcpy(props->key_len + dst, from->key_len + src, n * sizeof(_ini_off_t));
+  memcpy(props->value + dst, from->value + src, n * sizeof(_ini_off_t));
+  memcpy(props->value_len + dst, from->value_len + src, n * sizeof(_ini_off_t));
+  memcpy(props->hash + dst, from->hash + src, n * sizeof(uint32_t));
+  if (ini->source != NULL) {
+    memcpy(ini->source + dst * 2, ini->source + src * 2, n * 2 * sizeof(_ini_off_t));
+  }
+  for (int t = 0; t < ini->num_templates; t++) {
+    const _ini_off_t property = ini->templates[t].property;
+    if (property >= sec->first && property < sec->first + sec->count) {
+      ini->templates[t].property += ini->num_slots - sec->first;
+    }
+  }
+  sec->first = ini->num_slots;
+  sec->cap = cap;
+  ini->num_slots += cap;
+}
+
+/* makes room for one more property in a section; a section at the end of
+   the slots grows in place, any other moves to the end with spare slots. */
+_INI_PRIVATE void _ini_reserve_property(ini_t* ini, int section) {
+  _ini_section_t* sec = &ini->sections[section];
+  if (sec->count < sec->cap) {
+    return;
+  }
+  if (sec->first + sec->cap == ini->num_slots) {
+    _ini_grow_properties(ini, ini->num_slots + 1);
+    sec->cap++;
+    ini->num_slots++;
+    return;
+  }
+  _ini_move_section(ini, section, (sec->count > 2) ? sec->count * 2 : 4);
+}
+
+/* copies a table a clone has borrowed from its base */
+_INI_PRIVATE void* _ini_copy(const void* ptr, size_t size) {
+  if (size == 0) {
+    return NULL;
+  }
+  void* copy = INI_MALLOC(size);
+  INI_ASSERT(copy);
+  memcpy(copy, ptr, size);
+  return copy;
+}
+
+/* moves a section a clone shares into its own slots before writing it */
+_INI_PRIVATE void _ini_own_section(ini_t* ini, int section) {
+  const _ini_section_t* sec = &ini->sections[section];
+  if (sec->first < ini->shared_slots) {
+    _ini_move_section(ini, section, sec->count + 1);
+  }
+}
+
+/* copies the sections, strings, templates, overrides and filter a clone borrowed on
+   its first write; the sorted positions of a section stay the base's until
+   the section changes, the source texts and section names stay shared. */
+_INI_PRIVATE void _ini_own(ini_t* ini) {
+  if (!ini->borrowed) {
+    return;
+  }
+  ini->sections = (_ini_section_t*) _ini_copy(ini->sections, (size_t) ini->num_sections * sizeof(_ini_section_t));
+  ini->cap_sections = ini->num_sections;
+  for (int s = 0; s < ini->num_sections; s++) {
+    _ini_section_t* sec = &ini->sections[s];
+    if (ini->sorted != NULL) {
+      sec->sorted = ini->sorted + sec->first;
+    } else if (_ini_atomic_load(&sec->order_state) != _INI_SECTION_READY) {
+      sec->order_state = _INI_SECTION_PENDING;
+      sec->sorted = NULL;
+    }
+    sec->order = NULL;
+    sec->order_cap = 0;
+  }
+  ini->num_orders = ini->num_sections;
+  ini->sorted = NULL;
+  ini->strings = (char**) _ini_copy(ini->strings, (size_t) ini->num_strings * sizeof(char*));
+  ini->cap_strings = ini->num_strings;
+  ini->templates = (_ini_template_t*) _ini_copy(ini->templates, (size_t) ini->num_templates * sizeof(_ini_template_t));
+  ini->cap_templates = ini->num_templates;
+  ini->template_map = (int*) _ini_copy(ini->template_map, ini->cap_template_map * sizeof(int));
+  ini->edges = (_ini_edge_t*) _ini_copy(ini->edges, (size_t) ini->num_edges * sizeof(_ini_edge_t));
+  ini->cap_edges = ini->num_edges;
+  ini->edge_heads = (_ini_off_t*) _ini_copy(ini->edge_heads, ini->cap_edge_heads * sizeof(_ini_off_t));
+  ini->overrides = (_ini_override_t*) _ini_copy(ini->overrides, (size_t) ini->num_overrides * sizeof(_ini_override_t));
+  ini->cap_overrides = ini->num_overrides;
+  if (ini->bloom != NULL) {
+    ini->bloom = (uint64_t*) _ini_copy(ini->bloom, (ini->bloom_mask + 1) * sizeof(uint64_t));
+    ini->cap_bloom = ini->bloom_mask + 1;
+  }
+  ini->borrowed = false;
+  /* resolving a template may write any of them */
+  for (int t = 0; t < ini->num_templates; t++) {
+    _ini_own_section(ini, ini->templates[t].section);
+  }
+}
+
+/* appends a property to a section, adding its hash to the section's */
+_INI_PRIVATE void _ini_add_property(ini_t* ini, int section, _ini_off_t key, size_t key_len, _ini_off_t value, size_t value_len) {
+  _ini_reserve_property(ini, section);
+  _ini_section_t* sec = &ini->sections[section];
+  _ini_properties_t* props = &ini->properties;
+  const _ini_off_t i = sec->first + sec->count++;
+  const char* str = _ini_str(ini, key);
+  props->prefix[i] = _ini_key_prefix(str, key_len);
+  props->key[i] = key;
+  props->key_len[i] = (_ini_off_t) key_len;
+  props->value[i] = value;
+  props->value_len[i] = (_ini_off_t) value_len;
+  props->hash[i] = _ini_key_hash(str, key_len);
+  sec->order_state = _INI_SECTION_PENDING;
+  _ini_hash_add(&sec->hash, _ini_hash_property(str, key_len, _ini_str(ini, value), value_len));
+  if (ini->bloom_keys > 0) {
+    _ini_bloom_insert(ini, section, props->hash[i]);
+  }
+}
+
+/* replaces the value of a property, keeping the hash of its section */
+_INI_PRIVATE void _ini_write_value(ini_t* ini, int section, _ini_off_t property, _ini_off_t value, size_t value_len) {
+  _ini_properties_t* props = &ini->properties;
+  const char* key = _ini_str(ini, props->key[property]);
+  const size_t key_len = (size_t) props->key_len[property];
+  _ini_hash_sub(&ini->sections[section].hash, _ini_hash_property(key, key_len, _ini_str(ini, props->value[property]), (size_t) props->value_len[property]));
+  _ini_hash_add(&ini->sections[section].hash, _ini_hash_property(key, key_len, _ini_str(ini, value), value_len));
+  props->value[property] = value;
+  props->value_len[property] = (_ini_off_t) value_len;
+}
+
+_INI_PRIVATE char* _ini_arena_alloc(ini_t* ini, size_t size) {
+  _ini_chunk_t* chunk = ini->arena;
+  if (chunk == NULL || chunk->used + size > chunk->cap) {
+    if (ini->spare != NULL && ini->spare->cap >= size) {
+      /* reuse a chunk kept by `ini_reset` */
+      chunk = ini->spare;
+      ini->spare = chunk->next;
+    } else {
+      const size_t cap = (size > _INI_CHUNK_SIZE) ? size : _INI_CHUNK_SIZE;
+      chunk = (_ini_chunk_t*) INI_MALLOC(sizeof(_ini_chunk_t) + cap);
+      INI_ASSERT(chunk);
+      chunk->cap = cap;
+    }
+    chunk->next = ini->arena;
+    chunk->used = 0;
+    ini->arena = chunk;
+  }
+  char* p = (char*) (chunk + 1) + chunk->used;
+  chunk->used += size;
+  return p;
+}
+
+/* gives back the last `size` bytes allocated from the arena */
+_INI_PRIVATE void _ini_arena_release(ini_t* ini, size_t size) {
+  INI_ASSERT(ini->arena && ini->arena->used >= size);
+  ini->arena->used -= size;
+}
+
+/* registers a string allocated in the arena; returns its reference */
+_INI_PRIVATE _ini_off_t _ini_add_string(ini_t* ini, char* str) {
+  ini->strings = (char**) _ini_grow(ini->strings, ini->num_strings, &ini->cap_strings, sizeof(char*));
+  ini->strings[ini->num_strings] = str;
+  return ~ini->num_strings++;
+}
+
+/* copies `len` characters of a string into the arena; returns its reference */
+_INI_PRIVATE _ini_off_t _ini_intern(ini_t* ini, const char* str, size_t len) {
+  char* p = _ini_arena_alloc(ini, len + 1);
+  memcpy(p, str, len);
+  p[len] = '\0';
+  return _ini_add_string(ini, p);
+}
+
+_INI_PRIVATE inline bool _ini_is_digit(char c) {
+  return (c >= '0' && c <= '9');
+}
+
+/* true if all eight bytes of a little-endian word are ascii digits */
+_INI_PRIVATE inline bool _ini_is_eight_digits(uint64_t v) {
+  return (((v & 0xF0F0F0F0F0F0F0F0ull) | (((v + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull);
+}
+
+/* converts eight ascii digits of a little-endian word, without branches */
+_INI_PRIVATE inline uint64_t _ini_parse_eight_digits(uint64_t v) {
+  v = (v & 0x0F0F0F0F0F0F0F0Full) * 2561 >> 8;
+  v = (v & 0x00FF00FF00FF00FFull) * 6553601 >> 16;
+  return (uint32_t) ((v & 0x0000FFFF0000FFFFull) * 42949672960001 >> 32);
+}
+
+/* parses a span as a decimal integer; returns 0 if it isn't one, or if it
+   doesn't fit in an int64_t */
+_INI_PRIVATE int64_t _ini_parse_int(const char* p, const char* end) {
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = (*p++ == '-');
+  }
+  /* at most 19 digits, which fit in a uint64_t without wrapping */
+  if (p == end || end - p > 19) {
+    return 0;
+  }
+  uint64_t n = 0;
+#if _INI_LITTLE_ENDIAN
+  while (end - p >= 8) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    if (!_ini_is_eight_digits(v)) {
+      break;
+    }
+    n = n * 100000000u + _ini_parse_eight_digits(v);
+    p += 8;
+  }
+#endif
+  for (; p < end; p++) {
+    if (!_ini_is_digit(*p)) {
+      return 0;
+    }
+    n = n * 10 + (uint64_t) (*p - '0');
+  }
+  if (n > (uint64_t) INT64_MAX + (negative ? 1u : 0u)) {
+    return 0;
+  }
+  return negative ? (int64_t) (0 - n) : (int64_t) n;
+}
+
+_INI_PRIVATE uint32_t _ini_schema_hash(uint32_t section_hash, uint32_t key_hash) {
+  return (uint32_t) _ini_mix64(((uint64_t) section_hash << 32) | key_hash);
+}
+
+/* a decimal integer of at most 18 digits, which can't overflow */
+_INI_PRIVATE bool _ini_is_int(const char* p, size_t len) {
+  const size_t sign = (len > 0 && (*p == '-' || *p == '+')) ? 1 : 0;
+  if (len == sign || len - sign > 18) {
+    return false;
+  }
+  for (size_t i = sign; i < len; i++) {
+    if (!_ini_is_digit(p[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+_INI_PRIVATE bool _ini_is_choice(const char* choices, const char* value, size_t len) {
+  for (const char* p = choices; p != NULL;) {
+    const char* bar = strchr(p, '|');
+    const size_t n = (bar != NULL) ? (size_t) (bar - p) : strlen(p);
+    if (n == len && memcmp(p, value, len) == 0) {
+      return true;
+    }
+    p = (bar != NULL) ? bar + 1 : NULL;
+  }
+  return false;
+}
+
+/* checks a value against its rule; returns true if it breaks it */
+_INI_PRIVATE bool _ini_rule_check(const ini_rule_t* rule, const char* value, size_t len, ini_violation_t* violation) {
+  const bool ranged = (rule->min != 0 || rule->max != 0);
+  switch (rule->type) {
+    case INI_TYPE_INT: {
+      if (!_ini_is_int(value, len)) {
+        *violation = INI_VIOLATION_TYPE;
+        return true;
+      }
+      const int64_t n = _ini_parse_int(value, value + len);
+      *violation = INI_VIOLATION_RANGE;
+      return ranged && (n < rule->min || n > rule->max);
+    }
+    case INI_TYPE_FLOAT: {
+      char* end;
+      const double d = strtod(value, &end);
+      if (len == 0 || end != value + len || _ini_is_whitespace(*value)) {
+        *violation = INI_VIOLATION_TYPE;
+        return true;
+      }
+      *violation = INI_VIOLATION_RANGE;
+      return ranged && (d < (double) rule->min || d > (double) rule->max);
+    }
+    case INI_TYPE_BOOL:
+      *violation = INI_VIOLATION_TYPE;
+      return !(_ini_str_equal(value, "true", len) || _ini_str_equal(value, "false", len));
+    case INI_TYPE_ENUM:
+      *violation = INI_VIOLATION_CHOICE;
+      return !_ini_is_choice(rule->choices, value, len);
+    default:
+      return false;
+  }
+}
+
+/* checks a property that was just parsed against the rule of its key */
+_INI_PRIVATE void _ini_schema_check(ini_t* ini, int section, _ini_off_t i) {
+  _ini_schema_t* schema = ini->schema;
+  const char* name = (section == INI_GLOBAL_SECTION) ? "" : _ini_str(ini, ini->sections[section].name);
+  if (schema->section != section) {
+    schema->section = section;
+    schema->section_hash = _ini_key_hash(name, strlen(name));
+  }
+  const char* key = _ini_str(ini, ini->properties.key[i]);
+  const size_t key_len = (size_t) ini->properties.key_len[i];
+  const uint32_t hash = _ini_schema_hash(schema->section_hash, ini->properties.hash[i]);
+  for (size_t h = hash & schema->mask;; h = (h + 1) & schema->mask) {
+    const uint32_t r = schema->table[h][0];
+    if (r == 0) {
+      return;
+    }
+    const ini_rule_t* rule = &schema->rules[r - 1];
+    if (schema->table[h][1] == hash && _ini_str_equal(rule->key, key, key_len) && strcmp((rule->section != NULL) ? rule->section : "", name) == 0) {
+      schema->seen[r - 1] = true;
+      const char* value = _ini_str(ini, ini->properties.value[i]);
+      ini_violation_t violation;
+      if (_ini_rule_check(rule, value, (size_t) ini->properties.value_len[i], &violation)) {
+        ini->violations++;
+        if (schema->func != NULL) {
+          schema->func(rule, violation, schema->line, value, schema->user);
+        }
+      }
+      return;
+    }
+  }
+}
+
+/* records a property to check once the policy for duplicates is resolved */
+_INI_PRIVATE void _ini_schema_defer(ini_t* ini, int section, _ini_off_t i) {
+  _ini_schema_t* schema = ini->schema;
+  if (schema->num_deferred == schema->cap_deferred) {
+    schema->cap_deferred = (schema->cap_deferred > 0) ? schema->cap_deferred * 2 : 64;
+    _ini_deferred_t* deferred = (_ini_deferred_t*) INI_MALLOC(schema->cap_deferred * sizeof(_ini_deferred_t));
+    INI_ASSERT(deferred);
+    if (schema->num_deferred > 0) {
+      memcpy(deferred, schema->deferred, schema->num_deferred * sizeof(_ini_deferred_t));
+    }
+    INI_FREE(schema->deferred);
+    schema->deferred = deferred;
+  }
+  _ini_deferred_t* d = &schema->deferred[schema->num_deferred++];
+  d->section = section;
+  d->pos = i - ini->sections[section].first;
+  d->line = schema->line;
+}
+
+/* checks the deferred properties that were kept, each at the last line
+   that set it, in the order they were parsed */
+_INI_PRIVATE void _ini_schema_check_deferred(ini_t* ini) {
+  _ini_schema_t* schema = ini->schema;
+  size_t* last = (size_t*) INI_MALLOC((size_t) ini->num_slots * sizeof(size_t));
+  INI_ASSERT(last);
+  for (size_t k = 0; k < schema->num_deferred; k++) {
+    const _ini_deferred_t* d = &schema->deferred[k];
+    const _ini_section_t* sec = &ini->sections[d->section];
+    if (d->pos < sec->count) {
+      last[sec->first + d->pos] = d->line;
+    }
+  }
+  for (size_t k = 0; k < schema->num_deferred; k++) {
+    const _ini_deferred_t* d = &schema->deferred[k];
+    const _ini_section_t* sec = &ini->sections[d->section];
+    if (d->pos < sec->count && last[sec->first + d->pos] == d->line) {
+      schema->line = d->line;
+      _ini_schema_check(ini, d->section, sec->first + d->pos);
+    }
+  }
+  INI_FREE(last);
+}
+
+/* builds the table of rules to check a document against while parsing */
+_INI_PRIVATE void _ini_schema_begin(ini_t* ini, _ini_schema_t* schema, const ini_desc* desc) {
+  memset(schema, 0, sizeof(_ini_schema_t));
+  schema->rules = desc->rules;
+  schema->num_rules = desc->num_rules;
+  schema->func = desc->violation;
+  schema->user = desc->user;
+  schema->section = INI_NOT_FOUND;
+  size_t cap = 16;
+  while (cap < desc->num_rules * 2) {
+    cap *= 2;
+  }
+  const size_t size = cap * sizeof(schema->table[0]) + desc->num_rules * sizeof(bool);
+  schema->table = (uint32_t(*)[2]) INI_MALLOC(size);
+  INI_ASSERT(schema->table);
+  memset(schema->table, 0, size);
+  schema->seen = (bool*) (schema->table + cap);
+  schema->mask = cap - 1;
+  for (size_t r = 0; r < desc->num_rules; r++) {
+    const ini_rule_t* rule = &desc->rules[r];
+    INI_ASSERT(rule->key && (rule->type != INI_TYPE_ENUM || rule->choices));
+    const char* section = (rule->section != NULL) ? rule->section : "";
+    const uint32_t hash = _ini_schema_hash(_ini_key_hash(section, strlen(section)), _ini_key_hash(rule->key, strlen(rule->key)));
+    size_t h = hash & schema->mask;
+    while (schema->table[h][0] != 0) {
+      h = (h + 1) & schema->mask;
+    }
+    schema->table[h][0] = (uint32_t) r + 1;
+    schema->table[h][1] = hash;
+  }
+  ini->schema = schema;
+}
+
+/* reports the required keys that were never seen, unless the document failed to load */
+_INI_PRIVATE void _ini_schema_end(ini_t* ini) {
+  _ini_schema_t* schema = ini->schema;
+  if (schema->num_deferred > 0 && !ini->invalid) {
+    _ini_schema_check_deferred(ini);
+  }
+  for (size_t r = 0; r < schema->num_rules && !ini->invalid; r++) {
+    if (schema->rules[r].required && !schema->seen[r]) {
+      ini->violations++;
+      if (schema->func != NULL) {
+        schema->func(&schema->rules[r], INI_VIOLATION_MISSING, 0, NULL, schema->user);
+      }
+    }
+  }
+  INI_FREE(schema->table);
+  INI_FREE(schema->deferred);
+  ini->schema = NULL;
+}
+
+/* sets up the policies for repeated keys and sections while parsing */
+_INI_PRIVATE void _ini_duplicates_begin(ini_t* ini, _ini_duplicates_t* duplicates, const ini_desc* desc) {
+  memset(duplicates, 0, sizeof(_ini_duplicates_t));
+  duplicates->on_key = desc->duplicate_keys;
+  duplicates->on_section = desc->duplicate_sections;
+  ini->duplicates = duplicates;
+}
+
+_INI_PRIVATE void _ini_duplicates_end(ini_t* ini) {
+  INI_FREE(ini->duplicates->keys);
+  INI_FREE(ini->duplicates->names);
+  ini->duplicates = NULL;
+}
+
+_INI_PRIVATE inline uint32_t _ini_duplicate_hash(int section, uint32_t key_hash) {
+  return key_hash ^ ((uint32_t) section * 0x9E3779B9u);
+}
+
+/* doubles the table of keys, or creates it */
+_INI_PRIVATE void _ini_grow_keys(_ini_duplicates_t* duplicates) {
+  const size_t cap = (duplicates->keys != NULL) ? (duplicates->keys_mask + 1) * 2 : 256;
+  _ini_key_entry_t* keys = (_ini_key_entry_t*) INI_MALLOC(cap * sizeof(_ini_key_entry_t));
+  INI_ASSERT(keys);
+  memset(keys, 0, cap * sizeof(_ini_key_entry_t));
+  for (size_t i = 0; duplicates->keys != NULL && i <= duplicates->keys_mask; i++) {
+    const _ini_key_entry_t* entry = &duplicates->keys[i];
+    if (entry->pos != 0) {
+      size_t h = entry->hash & (cap - 1);
+      while (keys[h].pos != 0) {
+        h = (h + 1) & (cap - 1);
+      }
+      keys[h] = *entry;
+    }
+  }
+  INI_FREE(duplicates->keys);
+  duplicates->keys = keys;
+  duplicates->keys_mask = cap - 1;
+}
+
+/* returns the slot of a key already parsed into a section, or adds the key
+   at the next position of the section and returns INI_NOT_FOUND */
+_INI_PRIVATE _ini_off_t _ini_duplicate_key(ini_t* ini, int section, const char* key, size_t len) {
+  _ini_duplicates_t* duplicates = ini->duplicates;
+  if (duplicates->num_keys * 2 >= duplicates->keys_mask) {
+    _ini_grow_keys(duplicates);
+  }
+  const _ini_section_t* sec = &ini->sections[section];
+  const _ini_properties_t* props = &ini->properties;
+  const uint32_t hash = _ini_duplicate_hash(section, _ini_key_hash(key, len));
+  for (size_t h = hash & duplicates->keys_mask;; h = (h + 1) & duplicates->keys_mask) {
+    _ini_key_entry_t* entry = &duplicates->keys[h];
+    if (entry->pos == 0) {
+      entry->hash = hash;
+      entry->section = section;
+      entry->pos = sec->count + 1;
+      duplicates->num_keys++;
+      return INI_NOT_FOUND;
+    }
+    const _ini_off_t i = sec->first + entry->pos - 1;
+    if (entry->hash == hash && entry->section == section && entry->pos <= sec->count &&
+        (size_t) props->key_len[i] == len && memcmp(_ini_str(ini, props->key[i]), key, len) == 0) {
+      return i;
+    }
+  }
+}
+
+/* applies the policy for repeated keys to the value of slot `i`; returns
+   false if the value that was parsed is dropped. */
+_INI_PRIVATE bool _ini_resolve_key(ini_t* ini, int section, _ini_off_t i, char* value, size_t len) {
+  switch (ini->duplicates->on_key) {
+    case INI_DUPLICATE_LAST:
+      _ini_write_value(ini, section, i, (_ini_off_t) (value - ini->buf), len);
+      return true;
+    case INI_DUPLICATE_LIST: {
+      const char* first = _ini_str(ini, ini->properties.value[i]);
+      const size_t first_len = (size_t) ini->properties.value_len[i];
+      char* joined = _ini_arena_alloc(ini, first_len + len + 3);
+      memcpy(joined, first, first_len);
+      memcpy(joined + first_len, ", ", 2);
+      memcpy(joined + first_len + 2, value, len);
+      joined[first_len + len + 2] = '\0';
+      _ini_write_value(ini, section, i, _ini_add_string(ini, joined), first_len + len + 2);
+      return true;
+    }
+    case INI_DUPLICATE_ERROR:
+      ini->invalid = true;
+      return false;
+    default:
+      return false;
+  }
+}
+
+/* applies the policy for repeated sections to the section a header was
+   just parsed into; returns the section its properties are added to, or
+   INI_NOT_FOUND if they are dropped. */
+_INI_PRIVATE int _ini_resolve_section(ini_t* ini, int added) {
+  _ini_duplicates_t* duplicates = ini->duplicates;
+  if (duplicates->on_section == INI_DUPLICATE_KEEP) {
+    return added;
+  }
+  if (duplicates->num_names * 2 >= duplicates->names_mask) {
+    const size_t cap = (duplicates->names != NULL) ? (duplicates->names_mask + 1) * 2 : 64;
+    int* names = (int*) INI_MALLOC(cap * sizeof(int));
+    INI_ASSERT(names);
+    memset(names, 0, cap * sizeof(int));
+    for (size_t i = 0; duplicates->names != NULL && i <= duplicates->names_mask; i++) {
+      const int s = duplicates->names[i];
+      if (s != 0) {
+        const char* name = _ini_str(ini, ini->sections[s].name);
+        size_t h = _ini_key_hash(name, strlen(name)) & (cap - 1);
+        while (names[h] != 0) {
+          h = (h + 1) & (cap - 1);
+        }
+        names[h] = s;
+      }
+    }
+    INI_FREE(duplicates->names);
+    duplicates->names = names;
+    duplicates->names_mask = cap - 1;
+  }
+  const char* name = _ini_str(ini, ini->sections[added].name);
+  const size_t len = strlen(name);
+  size_t h = _ini_key_hash(name, len) & duplicates->names_mask;
+  while (duplicates->names[h] != 0 && !_ini_str_equal(_ini_str(ini, ini->sections[duplicates->names[h]].name), name, len)) {
+    h = (h + 1) & duplicates->names_mask;
+  }
+  const int s = duplicates->names[h];
+  if (s == 0) {
+    duplicates->names[h] = added;
+    duplicates->num_names++;
+    return added;
+  }
+  /* the repeated header is removed, its slots are still unused */
+  ini->num_sections--;
+  _ini_section_t* sec = &ini->sections[s];
+  switch (duplicates->on_section) {
+    case INI_DUPLICATE_LAST:
+      sec->count = 0;
+      sec->hash.lo = sec->hash.hi = 0;
+      sec->order_state = _INI_SECTION_PENDING;
+      return s;
+    case INI_DUPLICATE_LIST:
+      return s;
+    case INI_DUPLICATE_ERROR:
+      ini->invalid = true;
+      return INI_NOT_FOUND;
+    default:
+      return INI_NOT_FOUND;
+  }
+}
+
+/* parses the contents of a quoted value starting after the opening quote;
+   returns the end of the value. */
+_INI_PRIVATE char* _ini_parse_quoted(char* p, const char* eol, char quote, char** close) {
+  const bool escapes = (quote == '"');
+  char* q = p;
+  while (q < eol && *q != quote && !(escapes && *q == '\\')) {
+    q++;
+  }
+  if (q == eol || *q == quote) {
+    *close = q;
+    return q;
+  }
+  /* decode escapes in place, the value can only get shorter */
+  char* out = q;
+  while (q < eol && *q != quote) {
+    if (*q == '\\' && q + 1 < eol) {
+      *out++ = _ini_unescape(q[1]);
+      q += 2;
+    } else {
+      *out++ = *q++;
+    }
+  }
+  *close = q;
+  return out;
+}
+
+/* the offset of the line that follows `eol`, which is before the '\r' of
+   a line that ends with "\r\n"; must be called before `eol` is written. */
+_INI_PRIVATE inline _ini_off_t _ini_line_end(const ini_t* ini, const char* eol) {
+  const char* end = ini->buf + ini->size;
+  eol += (eol < end && *eol == '\r') ? 1 : 0;
+  return (_ini_off_t) (eol - ini->buf) + ((eol < end) ? 1 : 0);
+}
+
+/* the end of the line that starts at `p` and ends at `nl`, without the '\r' of "\r\n" */
+_INI_PRIVATE inline char* _ini_line_content(char* p, char* nl) {
+  return (nl > p && nl[-1] == '\r') ? nl - 1 : nl;
+}
+
+/* the size of a byte order mark at the start of the document */
+_INI_PRIVATE inline _ini_off_t _ini_bom_size(const ini_t* ini) {
+  return (ini->size >= 3 && memcmp(ini->buf, "\xEF\xBB\xBF", 3) == 0) ? 3 : 0;
+}
+
+/* checks that a line is valid UTF-8; ASCII, the common case, is skipped
+   eight bytes at a time, and a sequence is checked against the range of
+   its second byte, which is what rules out overlong encodings and
+   surrogates, by the table of its first byte. */
+_INI_PRIVATE bool _ini_utf8_valid(const char* str, size_t len) {
+  /* the range of the second byte for leads E0 to EF, and F0 to F4 */
+  static const unsigned char ranges[21][2] = {
+    { 0xA0, 0xBF }, { 0x80, 0xBF }, { 0x80, 0xBF }, { 0x80, 0xBF },
+    { 0x80, 0xBF }, { 0x80, 0xBF }, { 0x80, 0xBF }, { 0x80, 0xBF },
+    { 0x80, 0xBF }, { 0x80, 0xBF }, { 0x80, 0xBF }, { 0x80, 0xBF },
+    { 0x80, 0xBF }, { 0x80, 0x9F }, { 0x80, 0xBF }, { 0x80, 0xBF },
+    { 0x90, 0xBF }, { 0x80, 0xBF }, { 0x80, 0xBF }, { 0x80, 0xBF },
+    { 0x80, 0x8F },
+  };
+  const unsigned char* p = (const unsigned char*) str;
+  const unsigned char* end = p + len;
+  while (p < end) {
+    while (end - p >= 8) {
+      uint64_t v;
+      memcpy(&v, p, sizeof(v));
+      if ((v & 0x8080808080808080ull) != 0) {
+        break;
+      }
+      p += 8;
+    }
+    if (p == end) {
+      break;
+    }
+    const unsigned char c = *p;
+    if (c < 0x80) {
+      p++;
+      continue;
+    }
+    size_t n;
+    unsigned char lo = 0x80, hi = 0xBF;
+    if (c >= 0xC2 && c <= 0xDF) {
+      n = 1;
+    } else if (c >= 0xE0 && c <= 0xF4) {
+      n = (c < 0xF0) ? 2 : 3;
+      lo = ranges[c - 0xE0][0];
+      hi = ranges[c - 0xE0][1];
+    } else {
+      return false;
+    }
+    if ((size_t) (end - p) <= n || p[1] < lo || p[1] > hi) {
+      return false;
+    }
+    for (size_t i = 2; i <= n; i++) {
+      if ((p[i] & 0xC0) != 0x80) {
+        return false;
+      }
+    }
+    p += n + 1;
+  }
+  return true;
+}
+
+/* adds a section if the line is a section header */
+_INI_PRIVATE bool _ini_parse_header(ini_t* ini, char* p, char* eol) {
+  if (p == eol || *p != '[') {
+    return false;
+  }
+  char* name = _ini_skip_whitespace(p + 1, eol);
+  char* close = (char*) memchr(name, ']', eol - name);
+  if (close == NULL) {
+    return false;
+  }
+  const _ini_off_t tail = _ini_line_end(ini, eol);
+  *_ini_trim_whitespace(name, close) = '\0';
+  _ini_add_section(ini, (_ini_off_t) (name - ini->buf));
+  ini->sections[ini->num_sections - 1].tail = tail;
+  return true;
+}
+
+/* tokenizes a property in place, tokens are terminated by overwriting the
+   character that follows them, which is never part of another token. */
+_INI_PRIVATE void _ini_parse_property(ini_t* ini, int section, char* p, char* eol) {
+  if (p == eol || _ini_is_comment(*p) || section == INI_NOT_FOUND) {
+    return;
+  }
+  char* delim = p;
+  while (delim < eol && !_ini_is_delimeter(*delim)) {
+    delim++;
+  }
+  char* key_end = _ini_trim_whitespace(p, delim);
+  if (delim == eol || key_end == p) {
+    return;
+  }
+  const _ini_off_t tail = (ini->source != NULL) ? _ini_line_end(ini, eol) : 0;
+  char* value = _ini_skip_whitespace(delim + 1, eol);
+  char* const source_begin = value;
+  char* value_end = value;
+  char* source_end;
+  if (value < eol && _ini_is_quote(*value)) {
+    value++;
+    value_end = _ini_parse_quoted(value, eol, value[-1], &source_end);
+    source_end += (source_end < eol) ? 1 : 0;
+  } else {
+    while (value_end < eol && !_ini_is_comment(*value_end)) {
+      value_end++;
+    }
+    value_end = _ini_trim_whitespace(value, value_end);
+    source_end = value_end;
+  }
+  *key_end = '\0';
+  *value_end = '\0';
+  _ini_off_t i = INI_NOT_FOUND;
+  if (ini->duplicates != NULL && ini->duplicates->on_key != INI_DUPLICATE_KEEP) {
+    i = _ini_duplicate_key(ini, section, p, key_end - p);
+  }
+  if (i == INI_NOT_FOUND) {
+    _ini_add_property(ini, section, (_ini_off_t) (p - ini->buf), key_end - p, (_ini_off_t) (value - ini->buf), value_end - value);
+    i = ini->sections[section].first + ini->sections[section].count - 1;
+  } else if (!_ini_resolve_key(ini, section, i, value, value_end - value)) {
+    return;
+  }
+  if (ini->source != NULL) {
+    ini->source[i * 2] = (_ini_off_t) (source_begin - ini->buf);
+    ini->source[i * 2 + 1] = (_ini_off_t) (source_end - ini->buf);
+    ini->sections[section].tail = tail;
+  }
+  if (ini->schema != NULL && ini->duplicates != NULL) {
+    _ini_schema_defer(ini, section, i);
+  } else if (ini->schema != NULL) {
+    _ini_schema_check(ini, section, i);
+  }
+  _INI_STAT(ini->stats.properties++);
+}
+
+/* tokenizes `[begin, end)` of `ini->buf`, which must be followed by one
+   writable byte; properties are added to `section` until a header starts
+   the next one. lines are checked as UTF-8 before they are tokenized if
+   `utf8` is set, stopping at the first that isn't. returns the number of
+   lines. */
+_INI_PRIVATE size_t _ini_parse_range(ini_t* ini, int section, _ini_off_t begin, _ini_off_t end) {
+  _INI_STAT(const unsigned long long start = _ini_now_ns());
+  size_t lines = 0;
+  char* p = ini->buf + begin;
+  char* last = ini->buf + end;
+  while (p < last && !ini->invalid) {
+    char* nl = (char*) memchr(p, '\n', last - p);
+    if (nl == NULL) {
+      nl = last;
+    }
+    char* eol = _ini_line_content(p, nl);
+    if (ini->utf8 && !_ini_utf8_valid(p, (size_t) (eol - p))) {
+      ini->invalid = true;
+      break;
+    }
+    p = _ini_skip_whitespace(p, eol);
+    if (_ini_parse_header(ini, p, eol)) {
+      section = (ini->duplicates != NULL) ? _ini_resolve_section(ini, ini->num_sections - 1) : ini->num_sections - 1;
+    } else {
+      if (ini->schema != NULL) {
+        ini->schema->line = lines + 1;
+      }
+      _ini_parse_property(ini, section, p, eol);
+    }
+    lines++;
+    p = nl + 1;
+  }
+  _INI_STAT(ini->stats.parse_ns += _ini_now_ns() - start);
+  return lines;
+}
+
+_INI_PRIVATE void _ini_parse_data(ini_t* ini) {
+  const size_t lines = _ini_parse_range(ini, INI_GLOBAL_SECTION, _ini_bom_size(ini), (_ini_off_t) ini->size);
+  (void) lines;
+  _INI_STAT(ini->stats.lines = lines);
+  _INI_STAT(ini->stats.bytes = ini->size);
+  _INI_STAT(ini->stats.sections = ini->num_sections - 1);
+  _ini_link_sections(ini);
+  _ini_bloom_build(ini, ini->num_slots);
+}
+
+/* scans for section headers only, reserving a slot for every line that
+   could hold a property; the sections are tokenized on first lookup, so
+   the whole document is checked as UTF-8 here if `utf8` is set. */
+_INI_PRIVATE void _ini_scan_data(ini_t* ini) {
+  _INI_STAT(const unsigned long long start = _ini_now_ns());
+  ini->sections[INI_GLOBAL_SECTION].begin = _ini_bom_size(ini);
+  char* p = ini->buf + ini->sections[INI_GLOBAL_SECTION].begin;
+  char* end = ini->buf + ini->size;
+  size_t lines = 0;
+  while (p < end) {
+    char* nl = (char*) memchr(p, '\n', end - p);
+    if (nl == NULL) {
+      nl = end;
+    }
+    char* eol = _ini_line_content(p, nl);
+    if (ini->utf8 && !_ini_utf8_valid(p, (size_t) (eol - p))) {
+      ini->invalid = true;
+      break;
+    }
+    char* line = _ini_skip_whitespace(p, eol);
+    if (_ini_parse_header(ini, line, eol)) {
+      ini->sections[ini->num_sections - 2].end = (_ini_off_t) (p - ini->buf);
+      ini->sections[ini->num_sections - 1].begin = (_ini_off_t) (nl - ini->buf) + 1;
+    } else if (line < eol && !_ini_is_comment(*line)) {
+      ini->sections[ini->num_sections - 1].cap++;
+    }
+    lines++;
+    p = nl + 1;
+  }
+  ini->sections[ini->num_sections - 1].end = (_ini_off_t) ini->size;
+  _ini_off_t slots = 0;
+  for (int i = 0; i < ini->num_sections; i++) {
+    _ini_section_t* section = &ini->sections[i];
+    section->begin = (section->begin < section->end) ? section->begin : section->end;
+    section->first = slots;
+    section->state = _INI_SECTION_PENDING;
+    slots += section->cap;
+  }
+  _ini_grow_properties(ini, slots);
+  ini->num_slots = slots;
+  _ini_link_sections(ini);
+  _ini_bloom_build(ini, slots);
+  _INI_STAT(ini->stats.bytes = ini->size);
+  _INI_STAT(ini->stats.lines = lines);
+  _INI_STAT(ini->stats.sections = ini->num_sections - 1);
+  (void) lines;
+  _INI_STAT(ini->stats.parse_ns += _ini_now_ns() - start);
+}
+
+/* tokenizes a pending section of a lazy document; the first thread to get
+   here parses it into its reserved slots while the others wait. */
+_INI_PRIVATE void _ini_ensure_section(const ini_t* ini, int section) {
+  _ini_section_t* sec = &((ini_t*) ini)->sections[section];
+  if (_ini_atomic_load(&sec->state) == _INI_SECTION_READY) {
+    return;
+  }
+  if (_ini_atomic_cas(&sec->state, _INI_SECTION_PENDING, _INI_SECTION_PARSING)) {
+    _ini_parse_range((ini_t*) ini, section, sec->begin, sec->end);
+    _ini_atomic_store(&sec->state, _INI_SECTION_READY);
+    return;
+  }
+  while (_ini_atomic_load(&sec->state) != _INI_SECTION_READY) {
+    _ini_yield();
+  }
+}
+
+_INI_PRIVATE void _ini_ensure_all(const ini_t* ini) {
+  for (int i = 0; i < ini->num_sections; i++) {
+    _ini_ensure_section(ini, i);
+  }
+}
+
+/* returns the id of a section, or INI_NOT_FOUND; sections are found by
+   the table of names once it is built, and scanned for while parsing. */
+_INI_PRIVATE int _ini_find_section(const ini_t* ini, const char* name, size_t len) {
+  if (ini->num_names == ini->num_sections && ini->cap_names > 0) {
+    const size_t mask = ini->cap_names - 1;
+    size_t probes = 1;
+    for (size_t i = _ini_key_hash(name, len) & mask;; i = (i + 1) & mask, probes++) {
+      const int s = ini->names[i];
+      if (s == 0) {
+        _INI_STAT(_ini_stat_lookup(ini, false, probes));
+        return INI_NOT_FOUND;
+      }
+      if (_ini_str_equal(_ini_str(ini, ini->sections[s].name), name, len)) {
+        _INI_STAT(_ini_stat_lookup(ini, true, probes));
+        return s;
+      }
+    }
+  }
+  for (int i = 1; i < ini->num_sections; i++) {
+    if (_ini_str_equal(_ini_str(ini, ini->sections[i].name), name, len)) {
+      _INI_STAT(_ini_stat_lookup(ini, true, i));
+      return i;
+    }
+  }
+  _INI_STAT(_ini_stat_lookup(ini, false, ini->num_sections - 1));
+  return INI_NOT_FOUND;
+}
+
+/* returns the slot of a property, or INI_NOT_FOUND */
+_INI_PRIVATE _ini_off_t _ini_find_property(const ini_t* ini, int section, const char* key, size_t len) {
+  if (section < INI_GLOBAL_SECTION || section >= ini->num_sections) {
+    _INI_STAT(_ini_stat_lookup(ini, false, 0));
+    return INI_NOT_FOUND;
+  }
+  _ini_ensure_section(ini, section);
+  const _ini_section_t* sec = &ini->sections[section];
+  const _ini_properties_t* props = _ini_props(ini, sec->first);
+  const uint32_t hash = _ini_key_hash(key, len);
+  if (!_ini_bloom_test(ini, section, hash)) {
+    _INI_STAT(_ini_stat_lookup(ini, false, 0));
+    return INI_NOT_FOUND;
+  }
+  const uint64_t prefix = _ini_key_prefix(key, len);
+  for (_ini_off_t i = sec->first; i < sec->first + sec->count; i++) {
+    if (props->hash[i] == hash && props->key_len[i] == (_ini_off_t) len && props->prefix[i] == prefix &&
+        (len <= 8 || memcmp(_ini_str(ini, props->key[i]) + 8, key + 8, len - 8) == 0)) {
+      _INI_STAT(_ini_stat_lookup(ini, true, i - sec->first + 1));
+      return i;
+    }
+  }
+  _INI_STAT(_ini_stat_lookup(ini, false, sec->count));
+  return INI_NOT_FOUND;
+}
+
+/* finds the next ${name} reference in a string */
+_INI_PRIVATE const char* _ini_next_ref(const char* p, const char** name, const char** name_end) {
+  const char* ref = strstr(p, "${");
+  const char* close = (ref != NULL) ? strchr(ref + 2, '}') : NULL;
+  if (close == NULL) {
+    return NULL;
+  }
+  *name = ref + 2;
+  *name_end = close;
+  return ref;
+}
+
+/* returns the property a ${section:key} reference names and its section, or INI_NOT_FOUND */
+_INI_PRIVATE _ini_off_t _ini_ref_property(const ini_t* ini, const char* name, const char* name_end, int* section) {
+  const char* colon = (const char*) memchr(name, ':', name_end - name);
+  if (colon == NULL) {
+    return INI_NOT_FOUND;
+  }
+  *section = (colon == name) ? INI_GLOBAL_SECTION : _ini_find_section(ini, name, colon - name);
+  if (*section == INI_NOT_FOUND) {
+    return INI_NOT_FOUND;
+  }
+  return _ini_find_property(ini, *section, colon + 1, name_end - colon - 1);
+}
+
+/* returns the text a reference expands to */
+_INI_PRIVATE const char* _ini_ref_text(const ini_t* ini, const char* name, const char* name_end) {
+  if (memchr(name, ':', name_end - name) != NULL) {
+    int section;
+    const _ini_off_t property = _ini_ref_property(ini, name, name_end, &section);
+    return (property != INI_NOT_FOUND) ? _ini_str(ini, _ini_props(ini, property)->value[property]) : "";
+  }
+  char env[_INI_MAX_ENV_NAME];
+  const size_t len = name_end - name;
+  if (len >= _INI_MAX_ENV_NAME) {
+    return "";
+  }
+  memcpy(env, name, len);
+  env[len] = '\0';
+  const char* value = getenv(env);
+  return (value != NULL) ? value : "";
+}
+
+/* the hash of a ${section:key} reference, by the names it is made of */
+_INI_PRIVATE uint32_t _ini_ref_hash(const char* section, size_t section_len, const char* key, size_t key_len) {
+  return _ini_key_hash(key, key_len) ^ (_ini_key_hash(section, section_len) * 0x9E3779B1u);
+}
+
+/* where the map of templates starts looking for the template of a property,
+   by its section and position in it, which stay the same when it moves */
+_INI_PRIVATE size_t _ini_template_slot(const ini_t* ini, int section, _ini_off_t property) {
+  uint32_t h = (uint32_t) section * 0x9E3779B1u ^ (uint32_t) (property - ini->sections[section].first) * 0x85EBCA6Bu;
+  h ^= h >> 15;
+  return (size_t) h & (ini->cap_template_map - 1);
+}
+
+/* returns the template of a property, or INI_NOT_FOUND */
+_INI_PRIVATE int _ini_template_of(const ini_t* ini, int section, _ini_off_t property) {
+  if (ini->cap_template_map == 0) {
+    return INI_NOT_FOUND;
+  }
+  const size_t mask = ini->cap_template_map - 1;
+  for (size_t i = _ini_template_slot(ini, section, property);; i = (i + 1) & mask) {
+    const int t = ini->template_map[i] - 1;
+    if (t < 0) {
+      return INI_NOT_FOUND;
+    }
+    if (ini->templates[t].section == section && ini->templates[t].property == property) {
+      return t;
+    }
+  }
+}
+
+_INI_PRIVATE void _ini_map_template(ini_t* ini, int t) {
+  const size_t mask = ini->cap_template_map - 1;
+  size_t i = _ini_template_slot(ini, ini->templates[t].section, ini->templates[t].property);
+  while (ini->template_map[i] != 0) {
+    i = (i + 1) & mask;
+  }
+  ini->template_map[i] = t + 1;
+}
+
+/* sizes the map for every template and maps them again */
+_INI_PRIVATE void _ini_map_templates(ini_t* ini) {
+  size_t cap = 16;
+  while (cap < (size_t) ini->num_templates * 2) {
+    cap *= 2;
+  }
+  if (cap > ini->cap_template_map) {
+    INI_FREE(ini->template_map);
+    ini->template_map = (int*) INI_MALLOC(cap * sizeof(int));
+    INI_ASSERT(ini->template_map);
+    ini->cap_template_map = cap;
+  }
+  memset(ini->template_map, 0, ini->cap_template_map * sizeof(int));
+  for (int t = 0; t < ini->num_templates; t++) {
+    _ini_map_template(ini, t);
+  }
+}
+
+_INI_PRIVATE int _ini_add_template(ini_t* ini, int section, _ini_off_t property, _ini_off_t raw) {
+  ini->templates = (_ini_template_t*) _ini_grow(ini->templates, ini->num_templates, &ini->cap_templates, sizeof(_ini_template_t));
+  const int t = ini->num_templates++;
+  _ini_template_t* tmpl = &ini->templates[t];
+  tmpl->section = section;
+  tmpl->property = property;
+  tmpl->raw = raw;
+  tmpl->state = _INI_RESOLVED;
+  tmpl->first = tmpl->count = 0;
+  if ((size_t) ini->num_templates * 2 > ini->cap_template_map) {
+    _ini_map_templates(ini);
+  } else {
+    _ini_map_template(ini, t);
+  }
+  return t;
+}
+
+/* points an edge at the property it references, or at nothing */
+_INI_PRIVATE void _ini_target_edge(ini_t* ini, _ini_edge_t* edge, _ini_off_t property) {
+  if (property == INI_NOT_FOUND) {
+    edge->pos = INI_NOT_FOUND;
+    edge->dep = INI_NOT_FOUND;
+    return;
+  }
+  edge->pos = property - ini->sections[edge->section].first;
+  edge->dep = _ini_template_of(ini, edge->section, property);
+}
+
+/* appends an edge for every reference in the raw text of a template */
+_INI_PRIVATE void _ini_add_edges(ini_t* ini, int t) {
+  const char *raw = _ini_str(ini, ini->templates[t].raw), *p = raw, *name, *name_end;
+  ini->templates[t].first = ini->num_edges;
+  ini->templates[t].count = 0;
+  while (_ini_next_ref(p, &name, &name_end) != NULL) {
+    ini->edges = (_ini_edge_t*) _ini_grow(ini->edges, ini->num_edges, &ini->cap_edges, sizeof(_ini_edge_t));
+    _ini_edge_t* edge = &ini->edges[ini->num_edges++];
+    edge->tmpl = t;
+    edge->dep = INI_NOT_FOUND;
+    edge->next = 0;
+    edge->hash = 0;
+    edge->name = (_ini_off_t) (name - raw);
+    edge->len = (_ini_off_t) (name_end - name);
+    edge->section = INI_NOT_FOUND;
+    edge->pos = INI_NOT_FOUND;
+    const char* colon = (const char*) memchr(name, ':', name_end - name);
+    if (colon != NULL) {
+      edge->hash = _ini_ref_hash(name, colon - name, colon + 1, name_end - colon - 1);
+      _ini_target_edge(ini, edge, _ini_ref_property(ini, name, name_end, &edge->section));
+    }
+    ini->templates[t].count++;
+    p = name_end + 1;
+  }
+}
+
+_INI_PRIVATE void _ini_chain_edge(ini_t* ini, _ini_off_t e) {
+  const size_t i = (size_t) ini->edges[e].hash & (ini->cap_edge_heads - 1);
+  ini->edges[e].next = ini->edge_heads[i];
+  ini->edge_heads[i] = e + 1;
+}
+
+/* sizes the chains for the edges in use and chains them again */
+_INI_PRIVATE void _ini_chain_edges(ini_t* ini) {
+  size_t cap = 16;
+  while (cap < (size_t) (ini->num_edges - ini->dead_edges) * 2) {
+    cap *= 2;
+  }
+  if (cap > ini->cap_edge_heads) {
+    INI_FREE(ini->edge_heads);
+    ini->edge_heads = (_ini_off_t*) INI_MALLOC(cap * sizeof(_ini_off_t));
+    INI_ASSERT(ini->edge_heads);
+    ini->cap_edge_heads = cap;
+  }
+  memset(ini->edge_heads, 0, ini->cap_edge_heads * sizeof(_ini_off_t));
+  for (_ini_off_t e = 0; e < ini->num_edges; e++) {
+    if (ini->edges[e].tmpl != INI_NOT_FOUND) {
+      _ini_chain_edge(ini, e);
+    }
+  }
+}
+
+/* reads the references of every template again */
+_INI_PRIVATE void _ini_link_templates(ini_t* ini) {
+  ini->num_edges = 0;
+  ini->dead_edges = 0;
+  for (int t = 0; t < ini->num_templates; t++) {
+    _ini_add_edges(ini, t);
+  }
+  _ini_chain_edges(ini);
+}
+
+/* replaces the edges of a template whose raw text changed; the edges are
+   read again once more of them are dropped than used. */
+_INI_PRIVATE void _ini_relink_template(ini_t* ini, int t) {
+  const _ini_template_t* tmpl = &ini->templates[t];
+  for (_ini_off_t e = tmpl->first; e < tmpl->first + tmpl->count; e++) {
+    ini->edges[e].tmpl = INI_NOT_FOUND;
+  }
+  ini->dead_edges += tmpl->count;
+  if (ini->dead_edges * 2 > ini->num_edges) {
+    _ini_link_templates(ini);
+    return;
+  }
+  const _ini_off_t first = ini->num_edges;
+  _ini_add_edges(ini, t);
+  if ((size_t) (ini->num_edges - ini->dead_edges) * 2 > ini->cap_edge_heads) {
+    _ini_chain_edges(ini);
+    return;
+  }
+  for (_ini_off_t e = first; e < ini->num_edges; e++) {
+    _ini_chain_edge(ini, e);
+  }
+}
+
+/* the hash of the section and key of a property, as a reference names them */
+_INI_PRIVATE uint32_t _ini_property_ref_hash(const ini_t* ini, int section, const char* key, size_t key_len) {
+  const char* name = (section == INI_GLOBAL_SECTION) ? "" : _ini_str(ini, ini->sections[section].name);
+  return _ini_ref_hash(name, strlen(name), key, key_len);
+}
+
+_INI_PRIVATE void _ini_unresolve(ini_t* ini, int t) {
+  if (ini->templates[t].state == _INI_CYCLIC) {
+    ini->num_cyclic--;
+  }
+  ini->templates[t].state = _INI_UNRESOLVED;
+}
+
+/* marks the templates that reference a value unresolved, then those that
+   reference them, following the edges that depend on each. the edges that
+   name the value find its template again, it may have been added. */
+_INI_PRIVATE void _ini_invalidate(ini_t* ini, int section, const char* key, size_t key_len) {
+  if (ini->num_edges == ini->dead_edges) {
+    return;
+  }
+  int* stack = (int*) INI_MALLOC((size_t) ini->num_templates * sizeof(int));
+  INI_ASSERT(stack);
+  int top = 0;
+  const size_t mask = ini->cap_edge_heads - 1;
+  const uint32_t hash = _ini_property_ref_hash(ini, section, key, key_len);
+  for (_ini_off_t e = ini->edge_heads[hash & mask]; e != 0; e = ini->edges[e - 1].next) {
+    _ini_edge_t* edge = &ini->edges[e - 1];
+    if (edge->tmpl == INI_NOT_FOUND || edge->hash != hash) {
+      continue;
+    }
+    const char* name = _ini_str(ini, ini->templates[edge->tmpl].raw) + edge->name;
+    const _ini_off_t property = _ini_ref_property(ini, name, name + edge->len, &edge->section);
+    if (property == INI_NOT_FOUND || edge->section != section || !_ini_str_equal(_ini_str(ini, _ini_props(ini, property)->key[property]), key, key_len)) {
+      continue;
+    }
+    _ini_target_edge(ini, edge, property);
+    if (ini->templates[edge->tmpl].state != _INI_UNRESOLVED) {
+      _ini_unresolve(ini, edge->tmpl);
+      stack[top++] = edge->tmpl;
+    }
+  }
+  while (top > 0) {
+    const int t = stack[--top];
+    const _ini_template_t* tmpl = &ini->templates[t];
+    const _ini_off_t property = tmpl->property;
+    const _ini_properties_t* props = _ini_props(ini, property);
+    const uint32_t dep_hash = _ini_property_ref_hash(ini, tmpl->section, _ini_str(ini, props->key[property]), (size_t) props->key_len[property]);
+    for (_ini_off_t e = ini->edge_heads[dep_hash & mask]; e != 0; e = ini->edges[e - 1].next) {
+      const _ini_edge_t* edge = &ini->edges[e - 1];
+      if (edge->tmpl != INI_NOT_FOUND && edge->dep == t && ini->templates[edge->tmpl].state != _INI_UNRESOLVED) {
+        _ini_unresolve(ini, edge->tmpl);
+        stack[top++] = edge->tmpl;
+      }
+    }
+  }
+  INI_FREE(stack);
+}
+
+/* expands every reference of a template into `out`, or only measures it
+   when `out` is NULL; returns the length of the expansion. */
+_INI_PRIVATE size_t _ini_expand(const ini_t* ini, int t, char* out) {
+  const _ini_template_t* tmpl = &ini->templates[t];
+  const char *raw = _ini_str(ini, tmpl->raw), *p = raw;
+  size_t len = 0;
+  for (_ini_off_t e = tmpl->first; e < tmpl->first + tmpl->count; e++) {
+    const _ini_edge_t* edge = &ini->edges[e];
+    const char* name = raw + edge->name;
+    const char* ref = name - 2;
+    const char* text = "";
+    if (edge->pos != INI_NOT_FOUND) {
+      const _ini_off_t property = ini->sections[edge->section].first + edge->pos;
+      text = _ini_str(ini, _ini_props(ini, property)->value[property]);
+    } else if (edge->section == INI_NOT_FOUND) {
+      text = _ini_ref_text(ini, name, name + edge->len);
+    }
+    const size_t n = strlen(text);
+    if (out != NULL) {
+      memcpy(out + len, p, ref - p);
+      memcpy(out + len + (ref - p), text, n);
+    }
+    len += (ref - p) + n;
+    p = name + edge->len + 1;
+  }
+  const size_t n = strlen(p);
+  if (out != NULL) {
+    memcpy(out + len, p, n + 1);
+  }
+  return len + n;
+}
+
+/* writes the expansion of a template, or its raw text if it is part of,
+   or depends on, a reference cycle */
+_INI_PRIVATE void _ini_finish_template(ini_t* ini, int t, bool acyclic) {
+  _ini_template_t* tmpl = &ini->templates[t];
+  if (!acyclic) {
+    tmpl->state = _INI_CYCLIC;
+    ini->num_cyclic++;
+    _ini_write_value(ini, tmpl->section, tmpl->property, tmpl->raw, strlen(_ini_str(ini, tmpl->raw)));
+    return;
+  }
+  tmpl->state = _INI_RESOLVED;
+  const size_t len = _ini_expand(ini, t, NULL);
+  char* value = _ini_arena_alloc(ini, len + 1);
+  _ini_expand(ini, t, value);
+  /* a value resolved to the text it has already is not kept again */
+  const _ini_properties_t* props = _ini_props(ini, tmpl->property);
+  if ((size_t) props->value_len[tmpl->property] == len && memcmp(_ini_str(ini, props->value[tmpl->property]), value, len) == 0) {
+    _ini_arena_release(ini, len + 1);
+    return;
+  }
+  _ini_write_value(ini, tmpl->section, tmpl->property, _ini_add_string(ini, value), len);
+}
+
+/* resolves every unresolved template after the templates it references,
+   following the edges depth first with a stack rather than recursion, so
+   long chains of references can't overflow the call stack. */
+_INI_PRIVATE void _ini_resolve_all(ini_t* ini) {
+  _ini_frame_t* stack = NULL;
+  int top = 0;
+  for (int t = 0; t < ini->num_templates; t++) {
+    if (ini->templates[t].state != _INI_UNRESOLVED) {
+      continue;
+    }
+    if (stack == NULL) {
+      stack = (_ini_frame_t*) INI_MALLOC((size_t) ini->num_templates * sizeof(_ini_frame_t));
+      INI_ASSERT(stack);
+    }
+    ini->templates[t].state = _INI_RESOLVING;
+    stack[top].tmpl = t;
+    stack[top].edge = ini->templates[t].first;
+    stack[top++].acyclic = true;
+    while (top > 0) {
+      _ini_frame_t* frame = &stack[top - 1];
+      const _ini_template_t* tmpl = &ini->templates[frame->tmpl];
+      if (frame->edge < tmpl->first + tmpl->count) {
+        const int dep = ini->edges[frame->edge++].dep;
+        if (dep == INI_NOT_FOUND) {
+          continue;
+        }
+        switch (ini->templates[dep].state) {
+        case _INI_UNRESOLVED:
+          ini->templates[dep].state = _INI_RESOLVING;
+          stack[top].tmpl = dep;
+          stack[top].edge = ini->templates[dep].first;
+          stack[top++].acyclic = true;
+          break;
+        case _INI_RESOLVING:
+        case _INI_CYCLIC:
+          frame->acyclic = false;
+          break;
+        }
+        continue;
+      }
+      const bool acyclic = frame->acyclic;
+      _ini_finish_template(ini, frame->tmpl, acyclic);
+      if (--top > 0 && !acyclic) {
+        stack[top - 1].acyclic = false;
+      }
+    }
+  }
+  INI_FREE(stack);
+}
+
+/* keeps the templates in step with a new value: its own template reads
+   its references again, and the templates depending on it are unresolved */
+_INI_PRIVATE void _ini_update_templates(ini_t* ini, int section, _ini_off_t property, const char* key, size_t key_len, _ini_off_t raw) {
+  int t = _ini_template_of(ini, section, property);
+  if (t == INI_NOT_FOUND && strstr(_ini_str(ini, raw), "${") != NULL) {
+    t = _ini_add_template(ini, section, property, raw);
+  }
+  if (t != INI_NOT_FOUND) {
+    ini->templates[t].raw = raw;
+    _ini_relink_template(ini, t);
+    _ini_unresolve(ini, t);
+    if (ini->templates[t].count == 0) {
+      ini->templates[t].state = _INI_RESOLVED;
+    }
+  }
+  _ini_invalidate(ini, section, key, key_len);
+}
+
+/* sets a property to a string of the document, adding the property if it
+   doesn't exist; the templates depending on it are left unresolved, for
+   the caller to resolve once it has set all it sets. */
+_INI_PRIVATE void _ini_set(ini_t* ini, int section, const char* key, size_t key_len, _ini_off_t value, size_t value_len) {
+  if (ini->base != NULL) {
+    _ini_own_section(ini, section);
+  }
+  _ini_off_t property = _ini_find_property(ini, section, key, key_len);
+  if (property == INI_NOT_FOUND) {
+    _ini_add_property(ini, section, _ini_intern(ini, key, key_len), key_len, value, value_len);
+    property = ini->sections[section].first + ini->sections[section].count - 1;
+    if (++ini->bloom_count > ini->bloom_keys * 2) {
+      _ini_bloom_build(ini, ini->num_slots);
+    }
+  } else {
+    _ini_write_value(ini, section, property, value, value_len);
+  }
+  if (ini->interpolated) {
+    _ini_update_templates(ini, section, property, key, key_len, value);
+  }
+}
+
+/* compares a name with part of an environment variable; letters match
+   regardless of case, and an underscore also matches a dot or a dash. */
+_INI_PRIVATE bool _ini_env_match(const char* name, size_t len, const char* var, size_t var_len) {
+  if (len != var_len) {
+    return false;
+  }
+  for (size_t i = 0; i < len; i++) {
+    const char a = (name[i] >= 'A' && name[i] <= 'Z') ? name[i] - 'A' + 'a' : name[i];
+    const char b = (var[i] >= 'A' && var[i] <= 'Z') ? var[i] - 'A' + 'a' : var[i];
+    if (a != b && !(b == '_' && (a == '.' || a == '-'))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* returns the property a SECTION__KEY or KEY variable name overrides, or
+   INI_NOT_FOUND; the first section and key that match are used. */
+_INI_PRIVATE _ini_off_t _ini_env_property(const ini_t* ini, const char* name, const char* name_end, int* section) {
+  const char* sep = name;
+  while (sep + 1 < name_end && !(sep[0] == '_' && sep[1] == '_')) {
+    sep++;
+  }
+  const char* key = name;
+  *section = INI_GLOBAL_SECTION;
+  if (sep + 1 < name_end) {
+    key = sep + 2;
+    for (*section = 1; *section < ini->num_sections; (*section)++) {
+      const char* s = _ini_str(ini, ini->sections[*section].name);
+      if (_ini_env_match(s, strlen(s), name, sep - name)) {
+        break;
+      }
+    }
+    if (*section == ini->num_sections) {
+      return INI_NOT_FOUND;
+    }
+  }
+  _ini_ensure_section(ini, *section);
+  const _ini_section_t* sec = &ini->sections[*section];
+  const _ini_properties_t* props = _ini_props(ini, sec->first);
+  for (_ini_off_t i = sec->first; i < sec->first + sec->count; i++) {
+    if (_ini_env_match(_ini_str(ini, props->key[i]), (size_t) props->key_len[i], key, name_end - key)) {
+      return i;
+    }
+  }
+  return INI_NOT_FOUND;
+}
+
+_INI_PRIVATE int _ini_override_of(const ini_t* ini, int section, _ini_off_t key) {
+  for (int i = 0; i < ini->num_overrides; i++) {
+    if (ini->overrides[i].section == section && ini->overrides[i].key == key) {
+      return i;
+    }
+  }
+  return INI_NOT_FOUND;
+}
+
+_INI_PRIVATE const char* _ini_section_name(const ini_t* ini, int section) {
+  return (section == INI_GLOBAL_SECTION) ? "" : _ini_str(ini, ini->sections[section].name);
+}
+
+/* finds the section of `b` named like section `s` of `a`, trying the same
+   index first as documents being compared usually share their layout. */
+_INI_PRIVATE int _ini_match_section(const ini_t* a, int s, const ini_t* b) {
+  if (s == INI_GLOBAL_SECTION) {
+    return INI_GLOBAL_SECTION;
+  }
+  const char* name = _ini_section_name(a, s);
+  if (s < b->num_sections && strcmp(_ini_section_name(b, s), name) == 0) {
+    return s;
+  }
+  for (int t = 1; t < b->num_sections; t++) {
+    if (strcmp(_ini_section_name(b, t), name) == 0) {
+      return t;
+    }
+  }
+  return INI_NOT_FOUND;
+}
+
+/* finds a key in a section of another document, trying the slot at the
+   same position first as sections being compared usually share their order. */
+_INI_PRIVATE _ini_off_t _ini_match_property(const ini_t* ini, int section, _ini_off_t pos, const char* key, size_t len) {
+  const _ini_section_t* sec = &ini->sections[section];
+  const _ini_off_t i = sec->first + pos;
+  const _ini_properties_t* props = _ini_props(ini, sec->first);
+  if (pos < sec->count && (size_t) props->key_len[i] == len && memcmp(_ini_str(ini, props->key[i]), key, len) == 0) {
+    return i;
+  }
+  return _ini_find_property(ini, section, key, len);
+}
+
+/* reports the differences between section `s` of `a` and section `t` of
+   `b`; with `swapped` the documents were passed in reverse and values
+   missing from `b` are reported as added. returns the number of differences. */
+_INI_PRIVATE int _ini_diff_section(const ini_t* a, int s, const ini_t* b, int t, ini_diff_func func, void* user, bool swapped) {
+  const _ini_section_t* sa = &a->sections[s];
+  const _ini_section_t* sb = (t != INI_NOT_FOUND) ? &b->sections[t] : NULL;
+  if (sb != NULL && sa->count == sb->count && ini_hash_equal(sa->hash, sb->hash)) {
+    return 0;
+  }
+  const char* name = _ini_section_name(a, s);
+  const _ini_properties_t* pa = _ini_props(a, sa->first);
+  const _ini_properties_t* pb = (sb != NULL) ? _ini_props(b, sb->first) : NULL;
+  int differences = 0;
+  for (_ini_off_t i = sa->first; i < sa->first + sa->count; i++) {
+    const char* key = _ini_str(a, pa->key[i]);
+    const char* value = _ini_str(a, pa->value[i]);
+    const _ini_off_t j = (sb != NULL) ? _ini_match_property(b, t, i - sa->first, key, (size_t) pa->key_len[i]) : INI_NOT_FOUND;
+    const char* other = (j != INI_NOT_FOUND) ? _ini_str(b, pb->value[j]) : NULL;
+    if (other == NULL || (!swapped && (pa->value_len[i] != pb->value_len[j] || strcmp(value, other) != 0))) {
+      if (func != NULL) {
+        func(name, key, swapped ? other : value, swapped ? value : other, user);
+      }
+      differences++;
+    }
+  }
+  if (sb == NULL || swapped) {
+    return differences;
+  }
+  for (_ini_off_t j = sb->first; j < sb->first + sb->count; j++) {
+    const char* key = _ini_str(b, pb->key[j]);
+    if (_ini_match_property(a, s, j - sb->first, key, (size_t) pb->key_len[j]) == INI_NOT_FOUND) {
+      if (func != NULL) {
+        func(name, key, NULL, _ini_str(b, pb->value[j]), user);
+      }
+      differences++;
+    }
+  }
+  return differences;
+}
+
+/* the first 8 bytes of a key in an order that compares as the bytes do */
+_INI_PRIVATE inline uint64_t _ini_prefix_order(uint64_t prefix) {
+#if defined(__GNUC__)
+  return __builtin_bswap64(prefix);
+#else
+  prefix = ((prefix & 0x00FF00FF00FF00FFull) << 8) | ((prefix >> 8) & 0x00FF00FF00FF00FFull);
+  prefix = ((prefix & 0x0000FFFF0000FFFFull) << 16) | ((prefix >> 16) & 0x0000FFFF0000FFFFull);
+  return (prefix << 32) | (prefix >> 32);
+#endif
+}
+
+/* compares the keys of two properties */
+_INI_PRIVATE int _ini_key_cmp(const ini_t* ini, _ini_off_t a, _ini_off_t b) {
+  const _ini_properties_t* props = _ini_props(ini, a);
+  if (props->prefix[a] != props->prefix[b]) {
+    return (_ini_prefix_order(props->prefix[a]) < _ini_prefix_order(props->prefix[b])) ? -1 : 1;
+  }
+  const size_t a_len = (size_t) props->key_len[a], b_len = (size_t) props->key_len[b];
+  const int cmp = memcmp(_ini_str(ini, props->key[a]), _ini_str(ini, props->key[b]), (a_len < b_len) ? a_len : b_len);
+  return (cmp != 0) ? cmp : (a_len > b_len) - (a_len < b_len);
+}
+
+/* compares the start of a key with a prefix; zero if the key starts with it */
+_INI_PRIVATE int _ini_prefix_cmp(const ini_t* ini, _ini_off_t property, const char* prefix, size_t len) {
+  const _ini_properties_t* props = _ini_props(ini, property);
+  const size_t key_len = (size_t) props->key_len[property];
+  const int cmp = memcmp(_ini_str(ini, props->key[property]), prefix, (key_len < len) ? key_len : len);
+  return (cmp != 0) ? cmp : (key_len < len) ? -1 : 0;
+}
+
+/* sorts the positions of a section's properties by key, with a bottom-up
+   merge sort of runs sorted by insertion; `tmp` holds as many positions. */
+_INI_PRIVATE _ini_off_t* _ini_sort_keys(const ini_t* ini, const _ini_section_t* sec, _ini_off_t* order, _ini_off_t* tmp) {
+  enum { RUN = 16 };
+  const _ini_off_t n = sec->count, first = sec->first;
+  for (_ini_off_t i = 0; i < n; i++) {
+    _ini_off_t j = i;
+    if (i % RUN != 0) {
+      for (; j % RUN != 0 && _ini_key_cmp(ini, first + order[j - 1], first + i) > 0; j--) {
+        order[j] = order[j - 1];
+      }
+    }
+    order[j] = i;
+  }
+  for (_ini_off_t width = RUN; width < n; width *= 2) {
+    for (_ini_off_t lo = 0; lo < n; lo += 2 * width) {
+      const _ini_off_t mid = (lo + width < n) ? lo + width : n;
+      const _ini_off_t hi = (mid + width < n) ? mid + width : n;
+      _ini_off_t a = lo, b = mid, k = lo;
+      while (a < mid && b < hi) {
+        tmp[k++] = (_ini_key_cmp(ini, first + order[b], first + order[a]) < 0) ? order[b++] : order[a++];
+      }
+      while (a < mid) {
+        tmp[k++] = order[a++];
+      }
+      while (b < hi) {
+        tmp[k++] = order[b++];
+      }
+    }
+    _ini_off_t* swap = order;
+    order = tmp;
+    tmp = swap;
+  }
+  return order;
+}
+
+/* sorts the keys of a section on its first key query; concurrent queries
+   wait for the first to finish, as with lazy sections. */
+_INI_PRIVATE void _ini_ensure_order(const ini_t* ini, int section) {
+  _ini_ensure_section(ini, section);
+  _ini_section_t* sec = &((ini_t*) ini)->sections[section];
+  if (_ini_atomic_load(&sec->order_state) == _INI_SECTION_READY) {
+    return;
+  }
+  if (_ini_atomic_cas(&sec->order_state, _INI_SECTION_PENDING, _INI_SECTION_PARSING)) {
+    /* the merge sort needs as many positions again, the index keeps
+       whichever half holds the result */
+    if (sec->count > sec->order_cap) {
+      INI_FREE(sec->order);
+      sec->order = (_ini_off_t*) INI_MALLOC((size_t) sec->count * 2 * sizeof(_ini_off_t));
+      INI_ASSERT(sec->order);
+      sec->order_cap = sec->count;
+    }
+    sec->sorted = _ini_sort_keys(ini, sec, sec->order, sec->order + sec->order_cap);
+    _ini_atomic_store(&sec->order_state, _INI_SECTION_READY);
+    return;
+  }
+  while (_ini_atomic_load(&sec->order_state) != _INI_SECTION_READY) {
+    _ini_yield();
+  }
+}
+
+/* the sorted positions of a section, which documents opened over an
+   image find in the image */
+_INI_PRIVATE inline const _ini_off_t* _ini_sorted(const ini_t* ini, const _ini_section_t* sec) {
+  return (ini->sorted != NULL) ? ini->sorted + sec->first : sec->sorted;
+}
+
+/* finds the range of sorted positions whose keys start with `prefix` */
+_INI_PRIVATE ini_keys_t _ini_keys_range(const ini_t* ini, int section, const char* prefix, size_t len) {
+  ini_keys_t keys;
+  memset(&keys, 0, sizeof(ini_keys_t));
+  keys.ini = ini;
+  keys.section = section;
+  if (section < INI_GLOBAL_SECTION || section >= ini->num_sections) {
+    return keys;
+  }
+  _ini_ensure_order(ini, section);
+  const _ini_section_t* sec = &ini->sections[section];
+  const _ini_off_t* sorted = _ini_sorted(ini, sec);
+  size_t lo = 0, hi = (size_t) sec->count;
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    if (_ini_prefix_cmp(ini, sec->first + sorted[mid], prefix, len) < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  keys.pos = lo;
+  hi = (size_t) sec->count;
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    if (_ini_prefix_cmp(ini, sec->first + sorted[mid], prefix, len) <= 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  keys.end = lo;
+  return keys;
+}
+
+/* matches a string against a glob pattern of `*` and `?` */
+_INI_PRIVATE bool _ini_glob(const char* pattern, const char* str, const char* end) {
+  const char* star = NULL;
+  const char* resume = NULL;
+  while (str < end) {
+    if (*pattern == '*') {
+      star = pattern++;
+      resume = str;
+    } else if (*pattern != '\0' && (*pattern == '?' || *pattern == *str)) {
+      pattern++;
+      str++;
+    } else if (star != NULL) {
+      pattern = star + 1;
+      str = ++resume;
+    } else {
+      return false;
+    }
+  }
+  while (*pattern == '*') {
+    pattern++;
+  }
+  return *pattern == '\0';
+}
+
+/* keys of a batch are resolved in groups, with a small hash table of the
+   group on the stack. a sparse bitmap of the hashes rejects most of the
+   properties of a section before probing the table. */
+#define _INI_BATCH_SIZE (64)
+#define _INI_BATCH_SLOTS (2 * _INI_BATCH_SIZE)
+
+/* resolves up to _INI_BATCH_SIZE keys with one pass over the section;
+   returns the number found. */
+_INI_PRIVATE size_t _ini_values_batch(const ini_t* ini, int section, const char* const* keys, size_t n, const char** out) {
+  uint32_t hashes[_INI_BATCH_SIZE];
+  size_t lens[_INI_BATCH_SIZE];
+  unsigned char table[_INI_BATCH_SLOTS];
+  uint64_t bitmap[16];
+  memset(table, 0, sizeof(table));
+  memset(bitmap, 0, sizeof(bitmap));
+  size_t pending = 0;
+  for (size_t k = 0; k < n; k++) {
+    out[k] = NULL;
+    lens[k] = strlen(keys[k]);
+    hashes[k] = _ini_key_hash(keys[k], lens[k]);
+    if (!_ini_bloom_test(ini, section, hashes[k])) {
+      continue;
+    }
+    size_t slot = hashes[k] & (_INI_BATCH_SLOTS - 1);
+    while (table[slot] != 0) {
+      slot = (slot + 1) & (_INI_BATCH_SLOTS - 1);
+    }
+    table[slot] = (unsigned char) (k + 1);
+    bitmap[(hashes[k] >> 26) & 15] |= 1ull << ((hashes[k] >> 20) & 63);
+    pending++;
+  }
+  const _ini_section_t* sec = &ini->sections[section];
+  const _ini_properties_t* props = _ini_props(ini, sec->first);
+  size_t found = 0;
+  for (_ini_off_t i = sec->first; i < sec->first + sec->count && found < pending; i++) {
+    const uint32_t hash = props->hash[i];
+    if (!(bitmap[(hash >> 26) & 15] & (1ull << ((hash >> 20) & 63)))) {
+      continue;
+    }
+    for (size_t slot = hash & (_INI_BATCH_SLOTS - 1); table[slot] != 0; slot = (slot + 1) & (_INI_BATCH_SLOTS - 1)) {
+      const size_t k = table[slot] - 1;
+      if (hashes[k] == hash && out[k] == NULL && (size_t) props->key_len[i] == lens[k] &&
+          memcmp(_ini_str(ini, props->key[i]), keys[k], lens[k]) == 0) {
+        out[k] = _ini_str(ini, props->value[i]);
+        found++;
+      }
+    }
+  }
+  return found;
+}
+
+_INI_PRIVATE inline size_t _ini_image_align(size_t size) {
+  return (size + 7) & ~(size_t) 7;
+}
+
+/* appends a null terminated string to the strings of an image */
+_INI_PRIVATE _ini_off_t _ini_image_string(char* strings, size_t* pos, const char* str, size_t len) {
+  const _ini_off_t ref = (_ini_off_t) *pos;
+  memcpy(strings + *pos, str, len);
+  strings[*pos + len] = '\0';
+  *pos += len + 1;
+  return ref;
+}
+
+/* lays out the image of a document, tokenizing and sorting every section */
+_INI_PRIVATE size_t _ini_image_layout(const ini_t* ini, _ini_image_t* image) {
+  memset(image, 0, sizeof(_ini_image_t));
+  size_t slots = 0, strings = 0;
+  for (int s = 0; s < ini->num_sections; s++) {
+    _ini_ensure_order(ini, s);
+    const _ini_section_t* sec = &ini->sections[s];
+    strings += (s > INI_GLOBAL_SECTION) ? strlen(_ini_str(ini, sec->name)) + 1 : 0;
+    const _ini_properties_t* props = _ini_props(ini, sec->first);
+    for (_ini_off_t i = sec->first; i < sec->first + sec->count; i++) {
+      strings += (size_t) props->key_len[i] + (size_t) props->value_len[i] + 2;
+    }
+    slots += (size_t) sec->count;
+  }
+  memcpy(image->magic, _INI_IMAGE_MAGIC, 8);
+  image->offset_size = (uint32_t) sizeof(_ini_off_t);
+  image->section_size = (uint32_t) sizeof(_ini_section_t);
+  image->num_sections = (uint64_t) ini->num_sections;
+  image->num_slots = (uint64_t) slots;
+  image->bloom_words = (ini->bloom_keys > 0) ? (uint64_t) ini->bloom_mask + 1 : 0;
+  image->bloom_keys = (uint64_t) ini->bloom_keys;
+  image->cap_names = (uint64_t) ini->cap_names;
+  image->strings_size = (uint64_t) strings;
+  size_t size = _ini_image_align(sizeof(_ini_image_t));
+  image->sections = size;
+  size += _ini_image_align((size_t) ini->num_sections * sizeof(_ini_section_t));
+  image->prefix = size;
+  size += slots * sizeof(uint64_t);
+  image->key = size;
+  size += _ini_image_align(slots * sizeof(_ini_off_t));
+  image->key_len = size;
+  size += _ini_image_align(slots * sizeof(_ini_off_t));
+  image->value = size;
+  size += _ini_image_align(slots * sizeof(_ini_off_t));
+  image->value_len = size;
+  size += _ini_image_align(slots * sizeof(_ini_off_t));
+  image->hash = size;
+  size += _ini_image_align(slots * sizeof(uint32_t));
+  image->bloom = size;
+  size += (size_t) image->bloom_words * sizeof(uint64_t);
+  image->names = size;
+  size += _ini_image_align(ini->cap_names * sizeof(int));
+  image->sorted = size;
+  size += _ini_image_align(slots * sizeof(_ini_off_t));
+  image->strings = size;
+  size += strings;
+  image->size = size;
+  return (strings < (size_t) _INI_MAX_OFFSET) ? size : 0;
+}
+
+/* checks that an array of `count` elements of an image lies within it at
+   an offset aligned for them */
+_INI_PRIVATE bool _ini_image_fits(const _ini_image_t* image, uint64_t offset, uint64_t count, size_t elem, size_t align) {
+  return offset >= sizeof(_ini_image_t) && offset % align == 0 && offset <= image->size && count <= (image->size - offset) / elem;
+}
+
+/* checks the header of an image against its size: every table fits, the
+   tables used as hash tables have a power of two size, and every section
+   refers to slots, a name and sections within the image. the rest of its contents
+   are trusted as `ini_image_write` wrote them. */
+_INI_PRIVATE bool _ini_image_valid(const _ini_image_t* image) {
+  const uint64_t slots = image->num_slots;
+  if (image->num_sections < 1 || image->num_sections > (uint64_t) INT32_MAX || slots >= (uint64_t) _INI_MAX_OFFSET ||
+      image->strings_size >= (uint64_t) _INI_MAX_OFFSET || (image->bloom_words & (image->bloom_words - 1)) != 0 ||
+      (image->cap_names & (image->cap_names - 1)) != 0) {
+    return false;
+  }
+  if (!_ini_image_fits(image, image->sections, image->num_sections, sizeof(_ini_section_t), 8) ||
+      !_ini_image_fits(image, image->prefix, slots, sizeof(uint64_t), sizeof(uint64_t)) ||
+      !_ini_image_fits(image, image->key, slots, sizeof(_ini_off_t), sizeof(_ini_off_t)) ||
+      !_ini_image_fits(image, image->key_len, slots, sizeof(_ini_off_t), sizeof(_ini_off_t)) ||
+      !_ini_image_fits(image, image->value, slots, sizeof(_ini_off_t), sizeof(_ini_off_t)) ||
+      !_ini_image_fits(image, image->value_len, slots, sizeof(_ini_off_t), sizeof(_ini_off_t)) ||
+      !_ini_image_fits(image, image->hash, slots, sizeof(uint32_t), sizeof(uint32_t)) ||
+      !_ini_image_fits(image, image->bloom, image->bloom_words, sizeof(uint64_t), sizeof(uint64_t)) ||
+      !_ini_image_fits(image, image->names, image->cap_names, sizeof(int), sizeof(int)) ||
+      !_ini_image_fits(image, image->sorted, slots, sizeof(_ini_off_t), sizeof(_ini_off_t)) ||
+      !_ini_image_fits(image, image->strings, image->strings_size, 1, 1)) {
+    return false;
+  }
+  const _ini_section_t* sections = (const _ini_section_t*) ((const char*) image + image->sections);
+  for (uint64_t s = 0; s < image->num_sections; s++) {
+    const _ini_section_t* sec = &sections[s];
+    if (sec->first < 0 || sec->count < 0 || (uint64_t) sec->first + (uint64_t) sec->count > slots ||
+        (s > INI_GLOBAL_SECTION && (sec->name < 0 || (uint64_t) sec->name >= image->strings_size)) ||
+        (uint64_t) sec->parent >= image->num_sections || (uint64_t) sec->child >= image->num_sections ||
+        (uint64_t) sec->next >= image->num_sections) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* writes a value as it has to be written in a document to read back the
+   same, quoted when it would lose spaces or characters unquoted; `out`
+   may be NULL to get the length only. */
+_INI_PRIVATE size_t _ini_format_value(char* out, const char* value, size_t len) {
+  bool quote = (len > 0) && (_ini_is_whitespace(value[0]) || _ini_is_whitespace(value[len - 1]) || _ini_is_quote(value[0]));
+  for (size_t i = 0; i < len && !quote; i++) {
+    quote = _ini_is_comment(value[i]) || value[i] == '\n' || value[i] == '\r';
+  }
+  if (!quote) {
+    if (out != NULL) {
+      memcpy(out, value, len);
+    }
+    return len;
+  }
+  size_t n = 0;
+  for (size_t i = 0; i <= len + 1; i++) {
+    const char c = (i == 0 || i == len + 1) ? '"' : value[i - 1];
+    const bool escape = (i > 0 && i <= len) && (c == '"' || c == '\\' || c == '\n' || c == '\r');
+    if (escape && out != NULL) {
+      out[n] = '\\';
+      out[n + 1] = (c == '\n') ? 'n' : (c == '\r') ? 'r' : c;
+    } else if (out != NULL) {
+      out[n] = c;
+    }
+    n += escape ? 2 : 1;
+  }
+  return n;
+}
+
+/* keys that can be written on a line of their own and read back */
+_INI_PRIVATE bool _ini_writable_key(const char* key, size_t len) {
+  if (len == 0 || _ini_is_whitespace(key[0]) || _ini_is_whitespace(key[len - 1]) || _ini_is_comment(key[0]) || key[0] == '[') {
+    return false;
+  }
+  for (size_t i = 0; i < len; i++) {
+    if (_ini_is_delimeter(key[i]) || key[i] == '\n' || key[i] == '\r') {
+      return false;
+    }
+  }
+  return true;
+}
+
+_INI_PRIVATE inline size_t _ini_put(char* out, const char* str, size_t len) {
+  if (out != NULL) {
+    memcpy(out, str, len);
+  }
+  return len;
+}
+
+#define _INI_OUT(out, n) (((out) != NULL) ? (out) + (n) : NULL)
+
+/* writes the line of a property, ended by `newline`, or only its value into `out` */
+_INI_PRIVATE size_t _ini_format_property(char* out, const char* key, size_t key_len, const char* value, size_t value_len, const char* newline) {
+  size_t n = 0;
+  if (newline != NULL) {
+    n += _ini_put(out, key, key_len);
+    n += _ini_put(_INI_OUT(out, n), " = ", 3);
+  }
+  n += _ini_format_value(_INI_OUT(out, n), value, value_len);
+  if (newline != NULL) {
+    n += _ini_put(_INI_OUT(out, n), newline, strlen(newline));
+  }
+  return n;
+}
+
+/* the text of a section added by the editor, its header and every line */
+_INI_PRIVATE size_t _ini_format_section(const ini_t* ini, int section, const char* newline, char* out) {
+  const _ini_section_t* sec = &ini->sections[section];
+  const char* name = _ini_str(ini, sec->name);
+  const size_t newline_len = strlen(newline);
+  size_t n = _ini_put(out, newline, newline_len);
+  n += _ini_put(_INI_OUT(out, n), "[", 1);
+  n += _ini_put(_INI_OUT(out, n), name, strlen(name));
+  n += _ini_put(_INI_OUT(out, n), "]", 1);
+  n += _ini_put(_INI_OUT(out, n), newline, newline_len);
+  const _ini_properties_t* props = _ini_props(ini, sec->first);
+  for (_ini_off_t i = sec->first; i < sec->first + sec->count; i++) {
+    n += _ini_format_property(_INI_OUT(out, n), _ini_str(ini, props->key[i]), (size_t) props->key_len[i],
+      _ini_str(ini, props->value[i]), (size_t) props->value_len[i], newline);
+  }
+  return n;
+}
+
+/* adds a patch, keeping the order by `begin`; returns its id */
+_INI_PRIVATE _ini_off_t _ini_editor_add_patch(ini_editor_t* editor, _ini_off_t begin, _ini_off_t end, bool line) {
+  editor->patches = (_ini_patch_t*) _ini_grow(editor->patches, editor->num_patches, &editor->cap_patches, sizeof(_ini_patch_t));
+  editor->order = (_ini_off_t*) _ini_grow(editor->order, editor->num_patches, &editor->cap_order, sizeof(_ini_off_t));
+  const _ini_off_t id = editor->num_patches++;
+  _ini_patch_t* patch = &editor->patches[id];
+  patch->begin = begin;
+  patch->end = end;
+  patch->text = NULL;
+  patch->len = 0;
+  patch->line = line;
+  _ini_off_t lo = 0, hi = id;
+  while (lo < hi) {
+    const _ini_off_t mid = lo + (hi - lo) / 2;
+    if (editor->patches[editor->order[mid]].begin <= begin) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  memmove(editor->order + lo + 1, editor->order + lo, (size_t) (id - lo) * sizeof(_ini_off_t));
+  editor->order[lo] = id;
+  return id;
+}
+
+_INI_PRIVATE char* _ini_editor_text(ini_editor_t* editor, _ini_off_t id, size_t len) {
+  _ini_patch_t* patch = &editor->patches[id];
+  INI_FREE(patch->text);
+  patch->text = (char*) INI_MALLOC(len + 1);
+  INI_ASSERT(patch->text);
+  patch->len = len;
+  return patch->text;
+}
+
+_INI_PRIVATE inline int _ini_popcount(uint32_t v) {
+#if defined(__GNUC__)
+  return __builtin_popcount(v);
+#else
+  v = v - ((v >> 1) & 0x55555555u);
+  v = (v & 0x33333333u) + ((v >> 2) & 0x33333333u);
+  return (int) ((((v + (v >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24);
+#endif
+}
+
+_INI_PRIVATE inline void** _ini_hamt_entries(const _ini_hamt_t* node) {
+  return (void**) (node + 1);
+}
+
+_INI_PRIVATE inline int _ini_hamt_num_leaves(const _ini_hamt_t* node) {
+  return (int) node->collisions + _ini_popcount(node->leaves);
+}
+
+/* the leaf or child in the slot of `bit`, which must be set */
+_INI_PRIVATE inline void* _ini_hamt_slot(const _ini_hamt_t* node, uint32_t bit) {
+  void** entries = _ini_hamt_entries(node);
+  if (node->leaves & bit) {
+    return entries[_ini_popcount(node->leaves & (bit - 1))];
+  }
+  return entries[_ini_popcount(node->leaves) + _ini_popcount(node->nodes & (bit - 1))];
+}
+
+_INI_PRIVATE inline uint32_t _ini_hamt_bit(uint32_t hash, unsigned shift) {
+  return 1u << ((hash >> shift) & 31);
+}
+
+_INI_PRIVATE inline const char* _ini_leaf_key(const _ini_leaf_t* leaf) {
+  return (const char*) (leaf + 1) + leaf->section_len + 1;
+}
+
+_INI_PRIVATE inline const char* _ini_leaf_value(const _ini_leaf_t* leaf) {
+  return _ini_leaf_key(leaf) + leaf->key_len + 1;
+}
+
+_INI_PRIVATE inline uint32_t _ini_leaf_hash(const char* section, size_t section_len, const char* key, size_t key_len) {
+  return _ini_schema_hash(_ini_key_hash(section, section_len), _ini_key_hash(key, key_len));
+}
+
+/* true if a leaf holds the given section and key */
+_INI_PRIVATE bool _ini_leaf_is(const _ini_leaf_t* leaf, uint32_t hash, const char* section, size_t section_len, const char* key, size_t key_len) {
+  return leaf->hash == hash && (size_t) leaf->section_len == section_len && (size_t) leaf->key_len == key_len &&
+    memcmp(leaf + 1, section, section_len) == 0 && memcmp(_ini_leaf_key(leaf), key, key_len) == 0;
+}
+
+_INI_PRIVATE inline bool _ini_leaf_same(const _ini_leaf_t* a, const _ini_leaf_t* b) {
+  return _ini_leaf_is(a, b->hash, (const char*) (b + 1), (size_t) b->section_len, _ini_leaf_key(b), (size_t) b->key_len);
+}
+
+_INI_PRIVATE _ini_leaf_t* _ini_leaf_new(const char* section, size_t section_len, const char* key, size_t key_len, const char* value) {
+  const size_t value_len = strlen(value);
+  _ini_leaf_t* leaf = (_ini_leaf_t*) INI_MALLOC(sizeof(_ini_leaf_t) + section_len + key_len + value_len + 3);
+  INI_ASSERT(leaf);
+  leaf->refs = 1;
+  leaf->hash = _ini_leaf_hash(section, section_len, key, key_len);
+  leaf->section_len = (_ini_off_t) section_len;
+  leaf->key_len = (_ini_off_t) key_len;
+  leaf->value_len = (_ini_off_t) value_len;
+  char* p = (char*) (leaf + 1);
+  memcpy(p, section, section_len);
+  p[section_len] = '\0';
+  memcpy(p + section_len + 1, key, key_len);
+  p[section_len + 1 + key_len] = '\0';
+  memcpy(p + section_len + key_len + 2, value, value_len + 1);
+  return leaf;
+}
+
+_INI_PRIVATE void _ini_hamt_release(_ini_hamt_t* node) {
+  if (node == NULL || _ini_atomic_add(&node->refs, -1) != 0) {
+    return;
+  }
+  void** entries = _ini_hamt_entries(node);
+  const int leaves = _ini_hamt_num_leaves(node);
+  for (int i = 0; i < leaves; i++) {
+    _ini_leaf_t* leaf = (_ini_leaf_t*) entries[i];
+    if (_ini_atomic_add(&leaf->refs, -1) == 0) {
+      INI_FREE(leaf);
+    }
+  }
+  for (int i = leaves; i < leaves + _ini_popcount(node->nodes); i++) {
+    _ini_hamt_release((_ini_hamt_t*) entries[i]);
+  }
+  INI_FREE(node);
+}
+
+_INI_PRIVATE _ini_hamt_t* _ini_hamt_new(uint32_t leaves, uint32_t nodes, uint32_t collisions) {
+  const size_t n = (size_t) collisions + (size_t) _ini_popcount(leaves) + (size_t) _ini_popcount(nodes);
+  _ini_hamt_t* node = (_ini_hamt_t*) INI_MALLOC(sizeof(_ini_hamt_t) + n * sizeof(void*));
+  INI_ASSERT(node);
+  node->refs = 1;
+  node->leaves = leaves;
+  node->nodes = nodes;
+  node->collisions = collisions;
+  return node;
+}
+
+/* copies a node with the slot of `bit` holding `leaf`, `child` or nothing,
+   taking their references; the other entries are shared with `node`,
+   which may be NULL for an empty node. returns NULL for an empty node. */
+_INI_PRIVATE _ini_hamt_t* _ini_hamt_with(const _ini_hamt_t* node, uint32_t bit, _ini_leaf_t* leaf, _ini_hamt_t* child) {
+  const uint32_t leaves = ((node != NULL) ? node->leaves & ~bit : 0) | ((leaf != NULL) ? bit : 0);
+  const uint32_t nodes = ((node != NULL) ? node->nodes & ~bit : 0) | ((child != NULL) ? bit : 0);
+  if (leaves == 0 && nodes == 0) {
+    return NULL;
+  }
+  _ini_hamt_t* copy = _ini_hamt_new(leaves, nodes, 0);
+  void** entries = _ini_hamt_entries(copy);
+  int i = 0;
+  for (uint32_t m = leaves; m != 0; m &= m - 1) {
+    const uint32_t b = m & (~m + 1);
+    _ini_leaf_t* entry = (b == bit) ? leaf : (_ini_leaf_t*) _ini_hamt_slot(node, b);
+    if (b != bit) {
+      _ini_atomic_add(&entry->refs, 1);
+    }
+    entries[i++] = entry;
+  }
+  for (uint32_t m = nodes; m != 0; m &= m - 1) {
+    const uint32_t b = m & (~m + 1);
+    _ini_hamt_t* entry = (b == bit) ? child : (_ini_hamt_t*) _ini_hamt_slot(node, b);
+    if (b != bit) {
+      _ini_atomic_add(&entry->refs, 1);
+    }
+    entries[i++] = entry;
+  }
+  return copy;
+}
+
+/* copies a node of colliding leaves with leaf `i` replaced by `leaf`, or
+   removed if NULL, or with `leaf` added if `i` is past the last. */
+_INI_PRIVATE _ini_hamt_t* _ini_hamt_collide(const _ini_hamt_t* node, uint32_t i, _ini_leaf_t* leaf) {
+  const uint32_t n = (node != NULL) ? node->collisions : 0;
+  const uint32_t collisions = (leaf == NULL) ? n - 1 : (i < n) ? n : n + 1;
+  if (collisions == 0) {
+    return NULL;
+  }
+  _ini_hamt_t* copy = _ini_hamt_new(0, 0, collisions);
+  void** entries = _ini_hamt_entries(copy);
+  int c = 0;
+  for (uint32_t j = 0; j < n; j++) {
+    if (j != i) {
+      _ini_leaf_t* entry = (_ini_leaf_t*) _ini_hamt_entries(node)[j];
+      _ini_atomic_add(&entry->refs, 1);
+      entries[c++] = entry;
+    } else if (leaf != NULL) {
+      entries[c++] = leaf;
+    }
+  }
+  if (i >= n) {
+    entries[c] = leaf;
+  }
+  return copy;
+}
+
+/* a node holding two leaves of different keys at `shift` */
+_INI_PRIVATE _ini_hamt_t* _ini_hamt_pair(_ini_leaf_t* a, _ini_leaf_t* b, unsigned shift) {
+  if (shift >= 32) {
+    _ini_hamt_t* node = _ini_hamt_new(0, 0, 2);
+    _ini_hamt_entries(node)[0] = a;
+    _ini_hamt_entries(node)[1] = b;
+    return node;
+  }
+  const uint32_t bit_a = _ini_hamt_bit(a->hash, shift), bit_b = _ini_hamt_bit(b->hash, shift);
+  if (bit_a == bit_b) {
+    return _ini_hamt_with(NULL, bit_a, NULL, _ini_hamt_pair(a, b, shift + 5));
+  }
+  _ini_hamt_t* node = _ini_hamt_new(bit_a | bit_b, 0, 0);
+  _ini_hamt_entries(node)[0] = (bit_a < bit_b) ? a : b;
+  _ini_hamt_entries(node)[1] = (bit_a < bit_b) ? b : a;
+  return node;
+}
+
+/* finds the leaf of a section and key in the trie under `node` at `shift` */
+_INI_PRIVATE const _ini_leaf_t* _ini_hamt_find(const _ini_hamt_t* node, unsigned shift, uint32_t hash, const char* section, size_t section_len, const char* key, size_t key_len) {
+  for (; node != NULL; shift += 5) {
+    if (shift >= 32) {
+      for (uint32_t i = 0; i < node->collisions; i++) {
+        const _ini_leaf_t* leaf = (const _ini_leaf_t*) _ini_hamt_entries(node)[i];
+        if (_ini_leaf_is(leaf, hash, section, section_len, key, key_len)) {
+          return leaf;
+        }
+      }
+      return NULL;
+    }
+    const uint32_t bit = _ini_hamt_bit(hash, shift);
+    if (node->leaves & bit) {
+      const _ini_leaf_t* leaf = (const _ini_leaf_t*) _ini_hamt_slot(node, bit);
+      return _ini_leaf_is(leaf, hash, section, section_len, key, key_len) ? leaf : NULL;
+    }
+    node = (node->nodes & bit) ? (const _ini_hamt_t*) _ini_hamt_slot(node, bit) : NULL;
+  }
+  return NULL;
+}
+
+/* copies the path to the key of `leaf` to set it, taking the reference of
+   `leaf`, or to remove the key if `remove` is set; `count` is updated by
+   the properties added or removed. */
+_INI_PRIVATE _ini_hamt_t* _ini_hamt_set(const _ini_hamt_t* node, _ini_leaf_t* leaf, bool remove, unsigned shift, size_t* count) {
+  if (shift >= 32) {
+    uint32_t i = 0;
+    while (i < node->collisions && !_ini_leaf_same((const _ini_leaf_t*) _ini_hamt_entries(node)[i], leaf)) {
+      i++;
+    }
+    const bool found = (i < node->collisions);
+    if (remove && !found) {
+      _ini_atomic_add(&((_ini_hamt_t*) node)->refs, 1);
+      return (_ini_hamt_t*) node;
+    }
+    *count = found ? (remove ? *count - 1 : *count) : *count + 1;
+    return _ini_hamt_collide(node, i, remove ? NULL : leaf);
+  }
+  const uint32_t bit = _ini_hamt_bit(leaf->hash, shift);
+  if (node != NULL && (node->nodes & bit)) {
+    const _ini_hamt_t* old = (const _ini_hamt_t*) _ini_hamt_slot(node, bit);
+    _ini_hamt_t* child = _ini_hamt_set(old, leaf, remove, shift + 5, count);
+    if (child == old) {
+      /* nothing was removed */
+      _ini_hamt_release(child);
+      _ini_atomic_add(&((_ini_hamt_t*) node)->refs, 1);
+      return (_ini_hamt_t*) node;
+    }
+    if (child != NULL && child->nodes == 0 && _ini_hamt_num_leaves(child) == 1) {
+      /* a single leaf moves back up */
+      _ini_leaf_t* single = (_ini_leaf_t*) _ini_hamt_entries(child)[0];
+      _ini_atomic_add(&single->refs, 1);
+      _ini_hamt_release(child);
+      return _ini_hamt_with(node, bit, single, NULL);
+    }
+    return _ini_hamt_with(node, bit, NULL, child);
+  }
+  if (node != NULL && (node->leaves & bit)) {
+    _ini_leaf_t* old = (_ini_leaf_t*) _ini_hamt_slot(node, bit);
+    if (_ini_leaf_same(old, leaf)) {
+      *count -= remove ? 1 : 0;
+      return _ini_hamt_with(node, bit, remove ? NULL : leaf, NULL);
+    }
+    if (remove) {
+      _ini_atomic_add(&((_ini_hamt_t*) node)->refs, 1);
+      return (_ini_hamt_t*) node;
+    }
+    _ini_atomic_add(&old->refs, 1);
+    (*count)++;
+    return _ini_hamt_with(node, bit, NULL, _ini_hamt_pair(old, leaf, shift + 5));
+  }
+  if (remove) {
+    if (node != NULL) {
+      _ini_atomic_add(&((_ini_hamt_t*) node)->refs, 1);
+    }
+    return (_ini_hamt_t*) node;
+  }
+  (*count)++;
+  return _ini_hamt_with(node, bit, leaf, NULL);
+}
+
+/* builds the trie of `n` leaves at `shift` at once, partitioning them by
+   the bits of each level with a stable counting sort into `tmp`; of
+   leaves with the same key the first is kept and the others are freed. */
+_INI_PRIVATE _ini_hamt_t* _ini_hamt_build(_ini_leaf_t** leaves, _ini_leaf_t** tmp, size_t n, unsigned shift, size_t* count) {
+  if (shift >= 32) {
+    size_t kept = 0;
+    for (size_t i = 0; i < n; i++) {
+      size_t j = 0;
+      while (j < kept && !_ini_leaf_same(leaves[j], leaves[i])) {
+        j++;
+      }
+      if (j < kept) {
+        INI_FREE(leaves[i]);
+      } else {
+        leaves[kept++] = leaves[i];
+      }
+    }
+    *count += kept;
+    _ini_hamt_t* node = _ini_hamt_new(0, 0, (uint32_t) kept);
+    memcpy(_ini_hamt_entries(node), leaves, kept * sizeof(void*));
+    return node;
+  }
+  size_t start[33] = { 0 }, pos[32];
+  for (size_t i = 0; i < n; i++) {
+    start[((leaves[i]->hash >> shift) & 31) + 1]++;
+  }
+  for (int b = 0; b < 32; b++) {
+    start[b + 1] += start[b];
+    pos[b] = start[b];
+  }
+  for (size_t i = 0; i < n; i++) {
+    tmp[pos[(leaves[i]->hash >> shift) & 31]++] = leaves[i];
+  }
+  void* slots[32];
+  uint32_t leaf_bits = 0, node_bits = 0;
+  for (int b = 0; b < 32; b++) {
+    const size_t m = start[b + 1] - start[b];
+    if (m == 0) {
+      continue;
+    }
+    if (m == 1) {
+      slots[b] = tmp[start[b]];
+      leaf_bits |= 1u << b;
+      (*count)++;
+      continue;
+    }
+    /* the halves swap roles one level down */
+    _ini_hamt_t* child = _ini_hamt_build(tmp + start[b], leaves + start[b], m, shift + 5, count);
+    if (child->nodes == 0 && _ini_hamt_num_leaves(child) == 1) {
+      /* repeated keys left a single leaf, which moves up */
+      _ini_leaf_t* single = (_ini_leaf_t*) _ini_hamt_entries(child)[0];
+      _ini_atomic_add(&single->refs, 1);
+      _ini_hamt_release(child);
+      slots[b] = single;
+      leaf_bits |= 1u << b;
+    } else {
+      slots[b] = child;
+      node_bits |= 1u << b;
+    }
+  }
+  _ini_hamt_t* node = _ini_hamt_new(leaf_bits, node_bits, 0);
+  void** entries = _ini_hamt_entries(node);
+  int i = 0;
+  for (uint32_t m = leaf_bits; m != 0; m &= m - 1) {
+    entries[i++] = slots[_ini_popcount((m & (~m + 1)) - 1)];
+  }
+  for (uint32_t m = node_bits; m != 0; m &= m - 1) {
+    entries[i++] = slots[_ini_popcount((m & (~m + 1)) - 1)];
+  }
+  return node;
+}
+
+/* reports a leaf of `a`, or of `b` if `a` is NULL, as changed, added or removed */
+_INI_PRIVATE int _ini_leaf_report(const _ini_leaf_t* a, const _ini_leaf_t* b, ini_diff_func func, void* user) {
+  if (a != NULL && b != NULL && a->value_len == b->value_len && strcmp(_ini_leaf_value(a), _ini_leaf_value(b)) == 0) {
+    return 0;
+  }
+  if (func != NULL) {
+    const _ini_leaf_t* leaf = (a != NULL) ? a : b;
+    func((const char*) (leaf + 1), _ini_leaf_key(leaf), (a != NULL) ? _ini_leaf_value(a) : NULL, (b != NULL) ? _ini_leaf_value(b) : NULL, user);
+  }
+  return 1;
+}
+
+/* reports every leaf of `leaf` or the trie under `node` that is changed in,
+   or missing from, the slot of `other` at `other_shift`; only the missing
+   ones when `added`, with the leaves as those of `b`. */
+_INI_PRIVATE int _ini_hamt_diff_slot(const _ini_leaf_t* leaf, const _ini_hamt_t* node, unsigned shift,
+    const _ini_leaf_t* other_leaf, const _ini_hamt_t* other, unsigned other_shift, bool added, ini_diff_func func, void* user) {
+  if (leaf != NULL) {
+    const _ini_leaf_t* match = (other_leaf != NULL) ? (_ini_leaf_same(other_leaf, leaf) ? other_leaf : NULL) :
+      _ini_hamt_find(other, other_shift, leaf->hash, (const char*) (leaf + 1), (size_t) leaf->section_len, _ini_leaf_key(leaf), (size_t) leaf->key_len);
+    if (added) {
+      return (match == NULL) ? _ini_leaf_report(NULL, leaf, func, user) : 0;
+    }
+    return _ini_leaf_report(leaf, match, func, user);
+  }
+  int differences = 0;
+  if (node != NULL) {
+    void** entries = _ini_hamt_entries(node);
+    const int leaves = _ini_hamt_num_leaves(node);
+    for (int i = 0; i < leaves; i++) {
+      differences += _ini_hamt_diff_slot((const _ini_leaf_t*) entries[i], NULL, 0, other_leaf, other, other_shift, added, func, user);
+    }
+    for (int i = leaves; i < leaves + _ini_popcount(node->nodes); i++) {
+      differences += _ini_hamt_diff_slot(NULL, (const _ini_hamt_t*) entries[i], shift + 5, other_leaf, other, other_shift, added, func, user);
+    }
+  }
+  return differences;
+}
+
+/* compares two tries at the same level, skipping the nodes they share */
+_INI_PRIVATE int _ini_hamt_diff(const _ini_hamt_t* a, const _ini_hamt_t* b, unsigned shift, ini_diff_func func, void* user) {
+  if (a == b) {
+    return 0;
+  }
+  if (a == NULL || b == NULL || shift >= 32) {
+    return _ini_hamt_diff_slot(NULL, a, shift, NULL, b, shift, false, func, user) +
+      _ini_hamt_diff_slot(NULL, b, shift, NULL, a, shift, true, func, user);
+  }
+  int differences = 0;
+  for (uint32_t m = a->leaves | a->nodes | b->leaves | b->nodes; m != 0; m &= m - 1) {
+    const uint32_t bit = m & (~m + 1);
+    const _ini_leaf_t* leaf_a = (a->leaves & bit) ? (const _ini_leaf_t*) _ini_hamt_slot(a, bit) : NULL;
+    const _ini_leaf_t* leaf_b = (b->leaves & bit) ? (const _ini_leaf_t*) _ini_hamt_slot(b, bit) : NULL;
+    const _ini_hamt_t* node_a = (a->nodes & bit) ? (const _ini_hamt_t*) _ini_hamt_slot(a, bit) : NULL;
+    const _ini_hamt_t* node_b = (b->nodes & bit) ? (const _ini_hamt_t*) _ini_hamt_slot(b, bit) : NULL;
+    if (node_a != NULL && node_b != NULL) {
+      differences += _ini_hamt_diff(node_a, node_b, shift + 5, func, user);
+    } else if (leaf_a != leaf_b || node_a != node_b) {
+      differences += _ini_hamt_diff_slot(leaf_a, node_a, shift + 5, leaf_b, node_b, shift + 5, false, func, user);
+      differences += _ini_hamt_diff_slot(leaf_b, node_b, shift + 5, leaf_a, node_a, shift + 5, true, func, user);
+    }
+  }
+  return differences;
+}
+
+_INI_PRIVATE ini_version_t* _ini_version_new(_ini_hamt_t* root, size_t count) {
+  ini_version_t* version = (ini_version_t*) INI_MALLOC(sizeof(ini_version_t));
+  INI_ASSERT(version);
+  version->root = root;
+  version->count = count;
+  return version;
+}
+
+#if defined(FS_INCLUDED)
+/* images are named after the shared memory of their publisher and their
+   generation, "name.generation" */
+_INI_PRIVATE void _ini_shared_name(char* buf, const char* name, uint64_t generation) {
+  char digits[20];
+  int n = 0;
+  do {
+    digits[n++] = (char) ('0' + generation % 10);
+    generation /= 10;
+  } while (generation > 0);
+  const size_t len = strlen(name);
+  memcpy(buf, name, len);
+  buf[len] = '.';
+  for (int i = 0; i < n; i++) {
+    buf[len + 1 + i] = digits[n - 1 - i];
+  }
+  buf[len + 1 + n] = '\0';
+}
+
+_INI_PRIVATE ini_shared_t* _ini_shared_new(const char* name, _ini_shared_control_t* control, bool publisher) {
+  ini_shared_t* shared = (ini_shared_t*) INI_MALLOC(sizeof(ini_shared_t));
+  INI_ASSERT(shared);
+  memset(shared, 0, sizeof(ini_shared_t));
+  memcpy(shared->name, name, strlen(name) + 1);
+  shared->publisher = publisher;
+  shared->control = control;
+  return shared;
+}
+#endif
+
 /* public api functions */
 
 ini_t* ini_create() {
-  ini_t* ini = INI_MALLOC(sizeof(ini_t));
-  ini->sections = INI_MALLOC(INI_INITIAL_CAPACITY * sizeof(_ini_section_t));
-  ini->num_sections = 0;
-  ini->properties = INI_MALLOC(INI_INITIAL_CAPACITY * sizeof(_ini_property_t));
-  ini->num_properties = 0;
-  ini->buf = INI_MALLOC(_INI_BUF_SIZE_DEF * sizeof(char));
+  ini_t* ini = (ini_t*) INI_MALLOC(sizeof(ini_t));
+  memset(ini, 0, sizeof(ini_t));
+  _ini_grow_properties(ini, 1);
+  _ini_add_section(ini, 0);
   return ini;
 }
 
 void ini_destroy(ini_t* ini) {
   INI_ASSERT(ini);
-  INI_FREE(ini->properties);
-  INI_FREE(ini->sections);
-  INI_FREE(ini->buf);
+  if (_ini_atomic_add(&ini->refs, -1) >= 0) {
+    /* a clone still shares the document, the last one destroys it */
+    return;
+  }
+  if (ini->image != NULL) {
+    /* the index of a document opened over an image is the image's */
+    INI_FREE(ini);
+    return;
+  }
+#if defined(FS_INCLUDED)
+  if (ini->mapped) {
+    fs_unmap(ini->buf, ini->size);
+    ini->buf = NULL;
+  }
+#endif
+  while (ini->arena != NULL) {
+    _ini_chunk_t* next = ini->arena->next;
+    INI_FREE(ini->arena);
+    ini->arena = next;
+  }
+  while (ini->spare != NULL) {
+    _ini_chunk_t* next = ini->spare->next;
+    INI_FREE(ini->spare);
+    ini->spare = next;
+  }
+  INI_FREE(ini->properties.prefix);
+  INI_FREE(ini->source);
+  if (!ini->borrowed) {
+    for (int s = 0; s < ini->num_orders; s++) {
+      INI_FREE(ini->sections[s].order);
+    }
+    INI_FREE(ini->templates);
+    INI_FREE(ini->template_map);
+    INI_FREE(ini->edges);
+    INI_FREE(ini->edge_heads);
+    INI_FREE(ini->overrides);
+    INI_FREE(ini->bloom);
+    INI_FREE(ini->strings);
+    INI_FREE(ini->sections);
+  }
+  ini_t* base = ini->base;
+  if (base == NULL) {
+    INI_FREE(ini->names);
+    INI_FREE(ini->buf);
+  }
   INI_FREE(ini);
+  if (base != NULL) {
+    ini_destroy(base);
+  }
 }
 
 ini_t* ini_load(const char* data) {
   INI_ASSERT(data);
-  return _ini_parse_data(data);
+  ini_desc desc;
+  memset(&desc, 0, sizeof(ini_desc));
+  desc.data = data;
+  return ini_load_desc(&desc);
+}
+
+#if defined(FS_INCLUDED)
+ini_t* ini_load_file(const char* name) {
+  INI_ASSERT(name);
+  ini_desc desc;
+  memset(&desc, 0, sizeof(ini_desc));
+  desc.name = name;
+  return ini_load_desc(&desc);
+}
+#endif
+
+ini_t* ini_load_into(ini_t* ini, const char* data, size_t len) {
+  INI_ASSERT(data && len < (size_t) _INI_MAX_OFFSET);
+  if (ini == NULL) {
+    ini = ini_create();
+  }
+  ini_reset(ini);
+  if (len + 1 > ini->cap_buf) {
+    size_t cap = (ini->cap_buf > 0) ? ini->cap_buf * 2 : len + 1;
+    cap = (cap > len + 1) ? cap : len + 1;
+    INI_FREE(ini->buf);
+    ini->buf = (char*) INI_MALLOC(cap);
+    INI_ASSERT(ini->buf);
+    ini->cap_buf = cap;
+  }
+  memcpy(ini->buf, data, len);
+  ini->buf[len] = '\0';
+  ini->size = len;
+  _ini_parse_data(ini);
+  return ini;
+}
+
+void ini_reset(ini_t* ini) {
+  INI_ASSERT(ini && ini->image == NULL && ini->base == NULL && ini->refs == 0);
+#if defined(FS_INCLUDED)
+  if (ini->mapped) {
+    fs_unmap(ini->buf, ini->size);
+    ini->buf = NULL;
+    ini->cap_buf = 0;
+    ini->mapped = false;
+  }
+#endif
+  ini->size = 0;
+  /* keep the arena chunks to be reused in the order they were allocated */
+  while (ini->arena != NULL) {
+    _ini_chunk_t* next = ini->arena->next;
+    ini->arena->next = ini->spare;
+    ini->spare = ini->arena;
+    ini->arena = next;
+  }
+  ini->num_strings = 0;
+  ini->num_templates = 0;
+  ini->num_edges = 0;
+  ini->dead_edges = 0;
+  ini->num_cyclic = 0;
+  ini->num_overrides = 0;
+  ini->interpolated = false;
+  ini->violations = 0;
+  ini->lazy = 0;
+  ini->num_slots = 0;
+  ini->bloom_keys = 0;
+  ini->num_names = 0;
+  ini->num_sections = 0;
+  _ini_add_section(ini, 0);
+#if defined(INI_STATS)
+  memset(&ini->stats, 0, sizeof(ini_stats_t));
+#endif
+}
+
+ini_t* ini_clone(const ini_t* ini) {
+  INI_ASSERT(ini);
+  if (_ini_atomic_load(&ini->lazy)) {
+    _ini_ensure_all(ini);
+    _ini_atomic_store(&((ini_t*) ini)->lazy, 0);
+  }
+  ini_t* clone = (ini_t*) INI_MALLOC(sizeof(ini_t));
+  INI_ASSERT(clone);
+  memset(clone, 0, sizeof(ini_t));
+  _ini_atomic_add(&((ini_t*) ini)->refs, 1);
+  clone->base = (ini_t*) ini;
+  clone->borrowed = true;
+  clone->shared_slots = clone->num_slots = ini->num_slots;
+  clone->sections = ini->sections;
+  clone->num_sections = ini->num_sections;
+  clone->buf = ini->buf;
+  clone->size = ini->size;
+  clone->strings = ini->strings;
+  clone->num_strings = ini->num_strings;
+  clone->bloom = ini->bloom;
+  clone->bloom_mask = ini->bloom_mask;
+  clone->bloom_keys = ini->bloom_keys;
+  clone->bloom_count = ini->bloom_count;
+  clone->names = ini->names;
+  clone->cap_names = ini->cap_names;
+  clone->num_names = ini->num_names;
+  clone->templates = ini->templates;
+  clone->num_templates = ini->num_templates;
+  clone->template_map = ini->template_map;
+  clone->cap_template_map = ini->cap_template_map;
+  clone->edges = ini->edges;
+  clone->num_edges = ini->num_edges;
+  clone->dead_edges = ini->dead_edges;
+  clone->edge_heads = ini->edge_heads;
+  clone->cap_edge_heads = ini->cap_edge_heads;
+  clone->num_cyclic = ini->num_cyclic;
+  clone->overrides = ini->overrides;
+  clone->num_overrides = ini->num_overrides;
+  clone->interpolated = ini->interpolated;
+  clone->sorted = ini->sorted;
+  clone->violations = ini->violations;
+  return clone;
+}
+
+ini_t* ini_load_desc(const ini_desc* desc) {
+  INI_ASSERT(desc && (desc->data || desc->name));
+  char* buf = NULL;
+  size_t size = 0;
+  if (desc->name != NULL) {
+#if defined(FS_INCLUDED)
+    buf = (char*) fs_map(desc->name, &size);
+    if (buf == NULL) {
+      return NULL;
+    }
+    if (size >= (size_t) _INI_MAX_OFFSET) {
+      fs_unmap(buf, size);
+      return NULL;
+    }
+#else
+    INI_ASSERT(!"include filesystem.h before ini.h to load files");
+    return NULL;
+#endif
+  } else {
+    size = (desc->size > 0) ? desc->size : strlen(desc->data);
+    if (size >= (size_t) _INI_MAX_OFFSET) {
+      return NULL;
+    }
+    buf = (char*) INI_MALLOC(size + 1);
+    memcpy(buf, desc->data, size);
+    buf[size] = '\0';
+  }
+  ini_t* ini = ini_create();
+  ini->buf = buf;
+  ini->size = size;
+  ini->cap_buf = size + 1;
+  ini->mapped = (desc->name != NULL);
+  ini->utf8 = desc->utf8;
+  _ini_duplicates_t duplicates;
+  if (desc->duplicate_keys != INI_DUPLICATE_KEEP || desc->duplicate_sections != INI_DUPLICATE_KEEP) {
+    _ini_duplicates_begin(ini, &duplicates, desc);
+  }
+  if (desc->num_rules > 0) {
+    _ini_schema_t schema;
+    _ini_schema_begin(ini, &schema, desc);
+    _ini_parse_data(ini);
+    _ini_schema_end(ini);
+  } else if (desc->lazy && ini->duplicates == NULL) {
+    _ini_scan_data(ini);
+    ini->lazy = 1;
+  } else {
+    _ini_parse_data(ini);
+  }
+  if (ini->duplicates != NULL) {
+    _ini_duplicates_end(ini);
+  }
+  ini->utf8 = false;
+  if (ini->invalid) {
+    ini_destroy(ini);
+    return NULL;
+  }
+  if (desc->env_prefix != NULL) {
+    ini_apply_env(ini, desc->env_prefix);
+  }
+  return ini;
+}
+
+size_t ini_num_violations(const ini_t* ini) {
+  INI_ASSERT(ini);
+  return ini->violations;
+}
+
+size_t ini_num_sections(const ini_t* ini) {
+  INI_ASSERT(ini);
+  return (size_t) ini->num_sections - 1;
+}
+
+size_t ini_num_properties(const ini_t* ini, int section) {
+  INI_ASSERT(ini);
+  if (section < INI_GLOBAL_SECTION || section >= ini->num_sections) {
+    return 0;
+  }
+  _ini_ensure_section(ini, section);
+  return (size_t) ini->sections[section].count;
 }
 
 int ini_find_section(const ini_t* ini, const char* name) {
   INI_ASSERT(ini && name);
-  _ini_section_t* section = &ini->sections[0];
-  for (int i = 0; i < ini->num_sections; i++, section = &ini->sections[i]) {
-    if (strcmp(_ini_str(ini, section->name), name) == 0) {
-      return i+1;
+  return _ini_find_section(ini, name, strlen(name));
+}
+
+int ini_find_section_path(const ini_t* ini, const char* path) {
+  INI_ASSERT(ini && path);
+  int section = INI_GLOBAL_SECTION;
+  size_t probes = 0, offset = 0;
+  while (path[offset] != '\0') {
+    /* every child's name starts with the path walked so far */
+    int child = ini->sections[section].child;
+    size_t len = 0;
+    for (; child != 0; child = ini->sections[child].next) {
+      probes++;
+      if ((len = _ini_path_step(_ini_str(ini, ini->sections[child].name) + offset, path + offset)) > 0) {
+        break;
+      }
     }
+    if (child == 0) {
+      break;
+    }
+    section = child;
+    offset += len;
+    if (path[offset] == '\0') {
+      _INI_STAT(_ini_stat_lookup(ini, true, probes));
+      return section;
+    }
+    offset++;
   }
+  _INI_STAT(_ini_stat_lookup(ini, false, probes));
+  (void) probes;
   return INI_NOT_FOUND;
 }
 
+int ini_section_parent(const ini_t* ini, int section) {
+  INI_ASSERT(ini);
+  return (section > INI_GLOBAL_SECTION && section < ini->num_sections) ? ini->sections[section].parent : INI_NOT_FOUND;
+}
+
+int ini_section_child(const ini_t* ini, int section) {
+  INI_ASSERT(ini);
+  if (section < INI_GLOBAL_SECTION || section >= ini->num_sections || ini->sections[section].child == 0) {
+    return INI_NOT_FOUND;
+  }
+  return ini->sections[section].child;
+}
+
+int ini_section_next(const ini_t* ini, int section) {
+  INI_ASSERT(ini);
+  if (section <= INI_GLOBAL_SECTION || section >= ini->num_sections || ini->sections[section].next == 0) {
+    return INI_NOT_FOUND;
+  }
+  return ini->sections[section].next;
+}
+
 bool ini_section_exists(const ini_t* ini, const char* name) {
   return ini_find_section(ini, name) != INI_NOT_FOUND;
 }
 
 bool ini_property_exists(const ini_t* ini, int section, const char* key) {
   INI_ASSERT(ini && key);
-  _ini_property_t* property = &ini->properties[0];
-  for (int i = 0; i < ini->num_properties; i++, property = &ini->properties[i]) {
-    if (property->section == section && strcmp(_ini_str(ini, property->key), key) == 0) {
-      return true;
-    }
-  }
-  return false;
+  return _ini_find_property(ini, section, key, strlen(key)) != INI_NOT_FOUND;
 }
 
 const char* ini_value(const ini_t* ini, int section, const char* key) {
   INI_ASSERT(ini && key);
-  _ini_property_t* property = &ini->properties[0];
-  for (int i = 0; i < ini->num_properties; i++, property = &ini->properties[i]) {
-    if (property->section == section && strcmp(_ini_str(ini, property->key), key) == 0) {
-      return _ini_str(ini, property->value);
+  const _ini_off_t i = _ini_find_property(ini, section, key, strlen(key));
+  return (i != INI_NOT_FOUND) ? _ini_str(ini, _ini_props(ini, i)->value[i]) : NULL;
+}
+
+size_t ini_values_batch(const ini_t* ini, int section, const char* const* keys, size_t n, const char** out) {
+  INI_ASSERT(ini && ((keys && out) || n == 0));
+  if (section < INI_GLOBAL_SECTION || section >= ini->num_sections) {
+    for (size_t k = 0; k < n; k++) {
+      out[k] = NULL;
     }
+    return 0;
   }
-  return NULL;
+  _ini_ensure_section(ini, section);
+  size_t found = 0;
+  for (size_t k = 0; k < n; k += _INI_BATCH_SIZE) {
+    const size_t group = (n - k < _INI_BATCH_SIZE) ? n - k : _INI_BATCH_SIZE;
+    found += _ini_values_batch(ini, section, keys + k, group, out + k);
+  }
+  _INI_STAT(((ini_t*) ini)->stats.lookups += n);
+  _INI_STAT(((ini_t*) ini)->stats.hits += found);
+  _INI_STAT(((ini_t*) ini)->stats.misses += n - found);
+  return found;
+}
+
+ini_span_t ini_value_span(const ini_t* ini, int section, const char* key) {
+  INI_ASSERT(ini && key);
+  ini_span_t span = { NULL, 0 };
+  const _ini_off_t i = _ini_find_property(ini, section, key, strlen(key));
+  if (i != INI_NOT_FOUND) {
+    const _ini_properties_t* props = _ini_props(ini, i);
+    span.ptr = _ini_str(ini, props->value[i]);
+    span.len = (size_t) props->value_len[i];
+  }
+  return span;
 }
 
 int ini_value_as_int(const ini_t* ini, int section, const char* key) {
@@ -416,4 +4442,679 @@ bool ini_value_as_bool(const ini_t* ini, int section, const char* key) {
   return (strcmp(value, "true") == 0);
 }
 
+ini_list_t ini_value_as_list(const ini_t* ini, int section, const char* key) {
+  ini_list_t list = { NULL, NULL };
+  const ini_span_t value = ini_value_span(ini, section, key);
+  if (value.len > 0) {
+    list.pos = value.ptr;
+    list.end = value.ptr + value.len;
+  }
+  return list;
+}
+
+bool ini_list_next(ini_list_t* list, ini_span_t* item) {
+  INI_ASSERT(list && item);
+  if (list->pos == NULL) {
+    return false;
+  }
+  const char* p = list->pos;
+  const char* comma = (const char*) memchr(p, ',', list->end - p);
+  const char* end = (comma != NULL) ? comma : list->end;
+  list->pos = (comma != NULL) ? comma + 1 : NULL;
+  while (p < end && _ini_is_whitespace(*p)) {
+    p++;
+  }
+  while (end > p && _ini_is_whitespace(end[-1])) {
+    end--;
+  }
+  item->ptr = p;
+  item->len = (size_t) (end - p);
+  return true;
+}
+
+ini_keys_t ini_keys_with_prefix(const ini_t* ini, int section, const char* prefix) {
+  INI_ASSERT(ini && prefix);
+  return _ini_keys_range(ini, section, prefix, strlen(prefix));
+}
+
+ini_keys_t ini_keys_matching(const ini_t* ini, int section, const char* pattern) {
+  INI_ASSERT(ini && pattern);
+  ini_keys_t keys = _ini_keys_range(ini, section, pattern, strcspn(pattern, "*?"));
+  keys.pattern = pattern;
+  return keys;
+}
+
+bool ini_keys_next(ini_keys_t* keys, ini_span_t* key, ini_span_t* value) {
+  INI_ASSERT(keys && key && value);
+  while (keys->pos < keys->end) {
+    const ini_t* ini = keys->ini;
+    const _ini_section_t* sec = &ini->sections[keys->section];
+    const _ini_off_t i = sec->first + _ini_sorted(ini, sec)[keys->pos++];
+    const _ini_properties_t* props = _ini_props(ini, i);
+    key->ptr = _ini_str(ini, props->key[i]);
+    key->len = (size_t) props->key_len[i];
+    if (keys->pattern == NULL || _ini_glob(keys->pattern, key->ptr, key->ptr + key->len)) {
+      value->ptr = _ini_str(ini, props->value[i]);
+      value->len = (size_t) props->value_len[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t ini_value_as_int_array(const ini_t* ini, int section, const char* key, int64_t* out, size_t cap) {
+  INI_ASSERT(out || cap == 0);
+  size_t count = 0;
+  ini_span_t item;
+  ini_list_t list = ini_value_as_list(ini, section, key);
+  while (ini_list_next(&list, &item)) {
+    if (count < cap) {
+      out[count] = _ini_parse_int(item.ptr, item.ptr + item.len);
+    }
+    count++;
+  }
+  return count;
+}
+
+bool ini_set_value(ini_t* ini, int section, const char* key, const char* value) {
+  INI_ASSERT(ini && key && value && ini->image == NULL && ini->refs == 0);
+  if (section < INI_GLOBAL_SECTION || section >= ini->num_sections) {
+    return false;
+  }
+  if (ini->base != NULL) {
+    _ini_own(ini);
+  }
+  const size_t value_len = strlen(value);
+  _ini_set(ini, section, key, strlen(key), _ini_intern(ini, value, value_len), value_len);
+  if (ini->interpolated) {
+    _ini_resolve_all(ini);
+  }
+  return true;
+}
+
+bool ini_interpolate(ini_t* ini) {
+  INI_ASSERT(ini && ini->image == NULL && ini->base == NULL && ini->refs == 0);
+  if (!ini->interpolated) {
+    _ini_ensure_all(ini);
+    for (int s = 0; s < ini->num_sections; s++) {
+      const _ini_section_t* section = &ini->sections[s];
+      for (_ini_off_t i = section->first; i < section->first + section->count; i++) {
+        if (strstr(_ini_str(ini, ini->properties.value[i]), "${") != NULL) {
+          ini->templates = (_ini_template_t*) _ini_grow(ini->templates, ini->num_templates, &ini->cap_templates, sizeof(_ini_template_t));
+          _ini_template_t* tmpl = &ini->templates[ini->num_templates++];
+          tmpl->section = s;
+          tmpl->property = i;
+          tmpl->raw = ini->properties.value[i];
+        }
+      }
+    }
+    _ini_map_templates(ini);
+    ini->interpolated = true;
+  }
+  /* every template is resolved again, to read the environment again */
+  _ini_link_templates(ini);
+  for (int t = 0; t < ini->num_templates; t++) {
+    ini->templates[t].state = (ini->templates[t].count > 0) ? _INI_UNRESOLVED : _INI_RESOLVED;
+  }
+  ini->num_cyclic = 0;
+  _ini_resolve_all(ini);
+  return ini->num_cyclic == 0;
+}
+
+size_t ini_num_cyclic(const ini_t* ini) {
+  INI_ASSERT(ini);
+  return (size_t) ini->num_cyclic;
+}
+
+size_t ini_apply_env(ini_t* ini, const char* prefix) {
+  INI_ASSERT(ini && prefix && ini->image == NULL && ini->refs == 0);
+  if (ini->base != NULL) {
+    _ini_own(ini);
+  }
+  const size_t prefix_len = strlen(prefix);
+  for (int o = 0; o < ini->num_overrides; o++) {
+    ini->overrides[o].seen = false;
+  }
+  for (char** env = _ini_environ; env != NULL && *env != NULL; env++) {
+    const char* var = *env;
+    const char* eq = strchr(var, '=');
+    if (eq == NULL || strncmp(var, prefix, prefix_len) != 0 || strncmp(var + prefix_len, "__", 2) != 0) {
+      continue;
+    }
+    int section;
+    const _ini_off_t property = _ini_env_property(ini, var + prefix_len + 2, eq, &section);
+    if (property == INI_NOT_FOUND) {
+      continue;
+    }
+    const _ini_properties_t* props = _ini_props(ini, property);
+    const _ini_off_t key = props->key[property];
+    int o = _ini_override_of(ini, section, key);
+    if (o == INI_NOT_FOUND) {
+      /* keep the value as written, a template's rather than its expansion */
+      const int t = ini->interpolated ? _ini_template_of(ini, section, property) : INI_NOT_FOUND;
+      ini->overrides = (_ini_override_t*) _ini_grow(ini->overrides, ini->num_overrides, &ini->cap_overrides, sizeof(_ini_override_t));
+      o = ini->num_overrides++;
+      ini->overrides[o].section = section;
+      ini->overrides[o].key = key;
+      ini->overrides[o].value = (t != INI_NOT_FOUND) ? ini->templates[t].raw : props->value[property];
+    } else if (strcmp(_ini_str(ini, props->value[property]), eq + 1) == 0) {
+      ini->overrides[o].seen = true;
+      continue;
+    }
+    ini->overrides[o].seen = true;
+    const size_t value_len = strlen(eq + 1);
+    const char* name = _ini_str(ini, key);
+    _ini_set(ini, section, name, strlen(name), _ini_intern(ini, eq + 1, value_len), value_len);
+  }
+  /* restore the values whose variables are gone, to the text they had */
+  for (int o = 0; o < ini->num_overrides;) {
+    const _ini_override_t override = ini->overrides[o];
+    if (override.seen) {
+      o++;
+      continue;
+    }
+    ini->overrides[o] = ini->overrides[--ini->num_overrides];
+    const char* name = _ini_str(ini, override.key);
+    _ini_set(ini, override.section, name, strlen(name), override.value, strlen(_ini_str(ini, override.value)));
+  }
+  /* resolve what depends on the overrides once, after all are written */
+  if (ini->interpolated) {
+    _ini_resolve_all(ini);
+  }
+  return (size_t) ini->num_overrides;
+}
+
+ini_hash_t ini_fingerprint(const ini_t* ini) {
+  INI_ASSERT(ini);
+  _ini_ensure_all(ini);
+  ini_hash_t fingerprint = { 0, 0 };
+  for (int s = 0; s < ini->num_sections; s++) {
+    const _ini_section_t* section = &ini->sections[s];
+    if (section->count > 0) {
+      const char* name = _ini_section_name(ini, s);
+      _ini_hash_add(&fingerprint, _ini_hash(name, strlen(name), section->hash));
+    }
+  }
+  return fingerprint;
+}
+
+bool ini_hash_equal(ini_hash_t a, ini_hash_t b) {
+  return a.lo == b.lo && a.hi == b.hi;
+}
+
+int ini_diff(const ini_t* a, const ini_t* b, ini_diff_func func, void* user) {
+  INI_ASSERT(a && b);
+  _ini_ensure_all(a);
+  _ini_ensure_all(b);
+  int differences = 0;
+  for (int s = 0; s < a->num_sections; s++) {
+    const int t = _ini_match_section(a, s, b);
+    differences += _ini_diff_section(a, s, b, t, func, user, false);
+  }
+  for (int t = 0; t < b->num_sections; t++) {
+    if (_ini_match_section(b, t, a) == INI_NOT_FOUND) {
+      differences += _ini_diff_section(b, t, a, INI_NOT_FOUND, func, user, true);
+    }
+  }
+  return differences;
+}
+
+bool ini_get_stats(const ini_t* ini, ini_stats_t* stats) {
+  INI_ASSERT(ini && stats);
+#if defined(INI_STATS)
+  *stats = ini->stats;
+  return true;
+#else
+  (void) ini;
+  memset(stats, 0, sizeof(ini_stats_t));
+  return false;
+#endif
+}
+
+size_t ini_image_write(const ini_t* ini, void* dst, size_t cap) {
+  INI_ASSERT(ini && (dst || cap == 0) && ((uintptr_t) dst & 7) == 0);
+  _ini_image_t layout;
+  const size_t size = _ini_image_layout(ini, &layout);
+  if (size == 0 || dst == NULL || cap < size) {
+    return size;
+  }
+  char* base = (char*) dst;
+  memcpy(base, &layout, sizeof(_ini_image_t));
+  _ini_section_t* sections = (_ini_section_t*) (base + layout.sections);
+  uint64_t* prefix = (uint64_t*) (base + layout.prefix);
+  _ini_off_t* key = (_ini_off_t*) (base + layout.key);
+  _ini_off_t* key_len = (_ini_off_t*) (base + layout.key_len);
+  _ini_off_t* value = (_ini_off_t*) (base + layout.value);
+  _ini_off_t* value_len = (_ini_off_t*) (base + layout.value_len);
+  uint32_t* hash = (uint32_t*) (base + layout.hash);
+  _ini_off_t* sorted = (_ini_off_t*) (base + layout.sorted);
+  char* strings = base + layout.strings;
+  size_t pos = 0;
+  _ini_off_t slot = 0;
+  /* sections are packed without spare slots, tokenized and sorted */
+  for (int s = 0; s < ini->num_sections; s++) {
+    const _ini_section_t* sec = &ini->sections[s];
+    const _ini_off_t* order = _ini_sorted(ini, sec);
+    _ini_section_t* out = &sections[s];
+    memset(out, 0, sizeof(_ini_section_t));
+    out->hash = sec->hash;
+    out->first = slot;
+    out->count = out->cap = sec->count;
+    out->parent = sec->parent;
+    out->child = sec->child;
+    out->next = sec->next;
+    out->state = _INI_SECTION_READY;
+    out->order_state = _INI_SECTION_READY;
+    if (s > INI_GLOBAL_SECTION) {
+      const char* name = _ini_str(ini, sec->name);
+      out->name = _ini_image_string(strings, &pos, name, strlen(name));
+    }
+    const _ini_properties_t* props = _ini_props(ini, sec->first);
+    for (_ini_off_t j = 0; j < sec->count; j++) {
+      const _ini_off_t i = sec->first + j;
+      prefix[slot + j] = props->prefix[i];
+      key_len[slot + j] = props->key_len[i];
+      value_len[slot + j] = props->value_len[i];
+      hash[slot + j] = props->hash[i];
+      key[slot + j] = _ini_image_string(strings, &pos, _ini_str(ini, props->key[i]), (size_t) props->key_len[i]);
+      value[slot + j] = _ini_image_string(strings, &pos, _ini_str(ini, props->value[i]), (size_t) props->value_len[i]);
+      sorted[slot + j] = order[j];
+    }
+    slot += sec->count;
+  }
+  if (layout.bloom_words > 0) {
+    memcpy(base + layout.bloom, ini->bloom, (size_t) layout.bloom_words * sizeof(uint64_t));
+  }
+  if (layout.cap_names > 0) {
+    memcpy(base + layout.names, ini->names, (size_t) layout.cap_names * sizeof(int));
+  }
+  return size;
+}
+
+ini_t* ini_image_open(const void* image, size_t size) {
+  INI_ASSERT(image);
+  const _ini_image_t* layout = (const _ini_image_t*) image;
+  if (size < sizeof(_ini_image_t) || ((uintptr_t) image & 7) != 0 || memcmp(layout->magic, _INI_IMAGE_MAGIC, 8) != 0 ||
+      layout->size > size || layout->offset_size != sizeof(_ini_off_t) || layout->section_size != sizeof(_ini_section_t) ||
+      !_ini_image_valid(layout)) {
+    return NULL;
+  }
+  const char* base = (const char*) image;
+  ini_t* ini = (ini_t*) INI_MALLOC(sizeof(ini_t));
+  INI_ASSERT(ini);
+  memset(ini, 0, sizeof(ini_t));
+  ini->image = image;
+  ini->sections = (_ini_section_t*) (base + layout->sections);
+  ini->num_sections = ini->cap_sections = (_ini_off_t) layout->num_sections;
+  ini->num_slots = ini->cap_slots = (_ini_off_t) layout->num_slots;
+  ini->properties.prefix = (uint64_t*) (base + layout->prefix);
+  ini->properties.key = (_ini_off_t*) (base + layout->key);
+  ini->properties.key_len = (_ini_off_t*) (base + layout->key_len);
+  ini->properties.value = (_ini_off_t*) (base + layout->value);
+  ini->properties.value_len = (_ini_off_t*) (base + layout->value_len);
+  ini->properties.hash = (uint32_t*) (base + layout->hash);
+  ini->sorted = (const _ini_off_t*) (base + layout->sorted);
+  ini->buf = (char*) (base + layout->strings);
+  ini->size = (size_t) layout->strings_size;
+  if (layout->bloom_words > 0) {
+    ini->bloom = (uint64_t*) (base + layout->bloom);
+    ini->bloom_mask = (size_t) layout->bloom_words - 1;
+    ini->cap_bloom = (size_t) layout->bloom_words;
+    ini->bloom_keys = (_ini_off_t) layout->bloom_keys;
+  }
+  ini->names = (int*) (base + layout->names);
+  ini->cap_names = (size_t) layout->cap_names;
+  ini->num_names = ini->num_sections;
+  ini->interpolated = true;
+  return ini;
+}
+
+ini_editor_t* ini_editor_create(const char* data, size_t size) {
+  INI_ASSERT(data);
+  size = (size > 0) ? size : strlen(data);
+  if (size >= (size_t) _INI_MAX_OFFSET) {
+    return NULL;
+  }
+  ini_editor_t* editor = (ini_editor_t*) INI_MALLOC(sizeof(ini_editor_t));
+  INI_ASSERT(editor);
+  memset(editor, 0, sizeof(ini_editor_t));
+  ini_t* ini = ini_create();
+  ini->source = (_ini_off_t*) INI_MALLOC((size_t) ini->cap_slots * 2 * sizeof(_ini_off_t));
+  INI_ASSERT(ini->source);
+  ini_load_into(ini, data, size);
+  editor->ini = ini;
+  editor->source = data;
+  editor->size = size;
+  const char* nl = (const char*) memchr(data, '\n', size);
+  editor->newline = (nl != NULL && nl > data && nl[-1] == '\r') ? "\r\n" : "\n";
+  return editor;
+}
+
+void ini_editor_destroy(ini_editor_t* editor) {
+  INI_ASSERT(editor);
+  for (_ini_off_t i = 0; i < editor->num_patches; i++) {
+    INI_FREE(editor->patches[i].text);
+  }
+  INI_FREE(editor->patches);
+  INI_FREE(editor->order);
+  ini_destroy(editor->ini);
+  INI_FREE(editor);
+}
+
+const ini_t* ini_editor_document(const ini_editor_t* editor) {
+  INI_ASSERT(editor);
+  return editor->ini;
+}
+
+bool ini_editor_set_value(ini_editor_t* editor, int section, const char* key, const char* value) {
+  INI_ASSERT(editor && key && value);
+  ini_t* ini = editor->ini;
+  const size_t key_len = strlen(key);
+  if (section < INI_GLOBAL_SECTION || section >= ini->num_sections || !_ini_writable_key(key, key_len)) {
+    return false;
+  }
+  const bool added = (_ini_find_property(ini, section, key, key_len) == INI_NOT_FOUND);
+  ini_set_value(ini, section, key, value);
+  const _ini_section_t* sec = &ini->sections[section];
+  if (sec->tail < 0) {
+    /* a section added by the editor is written again as a whole */
+    const _ini_off_t id = ~sec->tail;
+    _ini_format_section(ini, section, editor->newline, _ini_editor_text(editor, id, _ini_format_section(ini, section, editor->newline, NULL)));
+    return true;
+  }
+  const _ini_off_t i = _ini_find_property(ini, section, key, key_len);
+  _ini_off_t* source = &ini->source[i * 2];
+  const size_t value_len = strlen(value);
+  _ini_off_t id;
+  if (added) {
+    id = _ini_editor_add_patch(editor, sec->tail, sec->tail, true);
+  } else if (source[0] >= 0) {
+    id = _ini_editor_add_patch(editor, source[0], source[1], false);
+  } else {
+    id = ~source[0];
+  }
+  const char* line = editor->patches[id].line ? editor->newline : NULL;
+  /* a value that was empty is written after a space following the '=' */
+  const bool space = (line == NULL) && editor->patches[id].begin == editor->patches[id].end &&
+    editor->patches[id].begin > 0 && _ini_is_delimeter(editor->source[editor->patches[id].begin - 1]);
+  char* text = _ini_editor_text(editor, id, _ini_format_property(NULL, key, key_len, value, value_len, line) + (space ? 1 : 0));
+  if (space) {
+    *text++ = ' ';
+  }
+  _ini_format_property(text, key, key_len, value, value_len, line);
+  source[0] = ~id;
+  return true;
+}
+
+int ini_editor_add_section(ini_editor_t* editor, const char* name) {
+  INI_ASSERT(editor && name);
+  ini_t* ini = editor->ini;
+  const int existing = ini_find_section(ini, name);
+  if (existing != INI_NOT_FOUND) {
+    return existing;
+  }
+  const size_t len = strlen(name);
+  if (len == 0 || _ini_is_whitespace(name[0]) || _ini_is_whitespace(name[len - 1]) || strpbrk(name, "]\r\n") != NULL) {
+    return INI_NOT_FOUND;
+  }
+  _ini_add_section(ini, _ini_intern(ini, name, len));
+  _ini_link_sections(ini);
+  const int section = ini->num_sections - 1;
+  const _ini_off_t id = _ini_editor_add_patch(editor, (_ini_off_t) editor->size, (_ini_off_t) editor->size, false);
+  ini->sections[section].tail = ~id;
+  _ini_format_section(ini, section, editor->newline, _ini_editor_text(editor, id, _ini_format_section(ini, section, editor->newline, NULL)));
+  return section;
+}
+
+size_t ini_editor_spans(const ini_editor_t* editor, ini_span_t* out, size_t cap) {
+  INI_ASSERT(editor && (out || cap == 0));
+  const char* source = editor->source;
+  const size_t size = editor->size;
+  bool newline = (size == 0 || source[size - 1] == '\n');
+  size_t n = 0, pos = 0;
+  for (_ini_off_t k = 0; k <= editor->num_patches; k++) {
+    const _ini_patch_t* patch = (k < editor->num_patches) ? &editor->patches[editor->order[k]] : NULL;
+    const size_t begin = (patch != NULL) ? (size_t) patch->begin : size;
+    if (begin > pos) {
+      if (n < cap) {
+        out[n].ptr = source + pos;
+        out[n].len = begin - pos;
+      }
+      n++;
+      pos = begin;
+    }
+    if (patch == NULL) {
+      break;
+    }
+    /* lines added at the end of a document that doesn't end a line */
+    if (begin == size && !newline) {
+      if (n < cap) {
+        out[n].ptr = editor->newline;
+        out[n].len = strlen(editor->newline);
+      }
+      n++;
+      newline = true;
+    }
+    if (n < cap) {
+      out[n].ptr = patch->text;
+      out[n].len = patch->len;
+    }
+    n++;
+    pos = (size_t) patch->end;
+  }
+  return n;
+}
+
+ini_version_t* ini_version_create(const ini_t* ini) {
+  _ini_hamt_t* root = NULL;
+  size_t count = 0;
+  if (ini != NULL) {
+    _ini_ensure_all(ini);
+    size_t n = 0;
+    for (int s = 0; s < ini->num_sections; s++) {
+      n += (size_t) ini->sections[s].count;
+    }
+    if (n > 0) {
+      /* in document order, so the first of a repeated key is the one kept */
+      _ini_leaf_t** leaves = (_ini_leaf_t**) INI_MALLOC(n * 2 * sizeof(_ini_leaf_t*));
+      INI_ASSERT(leaves);
+      n = 0;
+      for (int s = 0; s < ini->num_sections; s++) {
+        const _ini_section_t* sec = &ini->sections[s];
+        const char* name = _ini_section_name(ini, s);
+        const size_t name_len = strlen(name);
+        const _ini_properties_t* props = _ini_props(ini, sec->first);
+        for (_ini_off_t i = sec->first; i < sec->first + sec->count; i++) {
+          leaves[n++] = _ini_leaf_new(name, name_len, _ini_str(ini, props->key[i]), (size_t) props->key_len[i], _ini_str(ini, props->value[i]));
+        }
+      }
+      root = _ini_hamt_build(leaves, leaves + n, n, 0, &count);
+      INI_FREE(leaves);
+    }
+  }
+  return _ini_version_new(root, count);
+}
+
+void ini_version_destroy(ini_version_t* version) {
+  INI_ASSERT(version);
+  _ini_hamt_release(version->root);
+  INI_FREE(version);
+}
+
+ini_version_t* ini_version_set(const ini_version_t* version, const char* section, const char* key, const char* value) {
+  INI_ASSERT(version && key);
+  section = (section != NULL) ? section : "";
+  size_t count = version->count;
+  _ini_leaf_t* leaf = _ini_leaf_new(section, strlen(section), key, strlen(key), (value != NULL) ? value : "");
+  _ini_hamt_t* root = _ini_hamt_set(version->root, leaf, value == NULL, 0, &count);
+  if (value == NULL) {
+    INI_FREE(leaf);
+  }
+  return _ini_version_new(root, count);
+}
+
+const char* ini_version_value(const ini_version_t* version, const char* section, const char* key) {
+  INI_ASSERT(version && key);
+  section = (section != NULL) ? section : "";
+  const size_t section_len = strlen(section), key_len = strlen(key);
+  const _ini_leaf_t* leaf = _ini_hamt_find(version->root, 0, _ini_leaf_hash(section, section_len, key, key_len), section, section_len, key, key_len);
+  return (leaf != NULL) ? _ini_leaf_value(leaf) : NULL;
+}
+
+size_t ini_version_num_properties(const ini_version_t* version) {
+  INI_ASSERT(version);
+  return version->count;
+}
+
+int ini_version_diff(const ini_version_t* a, const ini_version_t* b, ini_diff_func func, void* user) {
+  INI_ASSERT(a && b);
+  return _ini_hamt_diff(a->root, b->root, 0, func, user);
+}
+
+#if defined(FS_INCLUDED)
+bool ini_editor_write(const ini_editor_t* editor, const char* name) {
+  INI_ASSERT(editor && name);
+  const size_t n = ini_editor_spans(editor, NULL, 0);
+  ini_span_t* spans = (ini_span_t*) INI_MALLOC((n + 1) * (sizeof(ini_span_t) + sizeof(fs_data)));
+  INI_ASSERT(spans);
+  fs_data* data = (fs_data*) (spans + n + 1);
+  ini_editor_spans(editor, spans, n);
+  for (size_t i = 0; i < n; i++) {
+    data[i].data = spans[i].ptr;
+    data[i].size = spans[i].len;
+  }
+  const bool ok = fs_writev(name, data, n);
+  INI_FREE(spans);
+  return ok;
+}
+
+ini_shared_t* ini_shared_create(const char* name) {
+  INI_ASSERT(name);
+  if (strlen(name) + 22 > _INI_MAX_SHARED_NAME) {
+    return NULL;
+  }
+  /* carry the generation over from a previous publisher, so its workers
+     don't mistake a new image for the one they have */
+  uint64_t generation = 0;
+  size_t size;
+  const _ini_shared_control_t* previous = (const _ini_shared_control_t*) fs_shm_open(name, &size);
+  if (previous != NULL) {
+    if (size >= sizeof(_ini_shared_control_t) && memcmp(previous->magic, _INI_SHARED_MAGIC, 8) == 0) {
+      generation = _ini_atomic_load64(&previous->generation);
+    }
+    fs_shm_unmap(previous, size);
+  }
+  _ini_shared_control_t* control = (_ini_shared_control_t*) fs_shm_create(name, sizeof(_ini_shared_control_t));
+  if (control == NULL) {
+    return NULL;
+  }
+  memcpy(control->magic, _INI_SHARED_MAGIC, 8);
+  _ini_atomic_store64(&control->generation, generation);
+  ini_shared_t* shared = _ini_shared_new(name, control, true);
+  shared->generation = generation;
+  return shared;
+}
+
+ini_shared_t* ini_shared_open(const char* name) {
+  INI_ASSERT(name);
+  if (strlen(name) + 22 > _INI_MAX_SHARED_NAME) {
+    return NULL;
+  }
+  size_t size;
+  const _ini_shared_control_t* control = (const _ini_shared_control_t*) fs_shm_open(name, &size);
+  if (control == NULL) {
+    return NULL;
+  }
+  if (size < sizeof(_ini_shared_control_t) || memcmp(control->magic, _INI_SHARED_MAGIC, 8) != 0) {
+    fs_shm_unmap(control, size);
+    return NULL;
+  }
+  return _ini_shared_new(name, (_ini_shared_control_t*) control, false);
+}
+
+bool ini_shared_publish(ini_shared_t* shared, const ini_t* ini) {
+  INI_ASSERT(shared && shared->publisher && ini);
+  const size_t size = ini_image_write(ini, NULL, 0);
+  if (size == 0) {
+    return false;
+  }
+  char name[_INI_MAX_SHARED_NAME];
+  const uint64_t generation = shared->generation + 1;
+  _ini_shared_name(name, shared->name, generation);
+  void* image = fs_shm_create(name, size);
+  if (image == NULL) {
+    return false;
+  }
+  ini_image_write(ini, image, size);
+  _ini_atomic_store64(&shared->control->generation, generation);
+  /* workers that mapped the previous image keep it until they switch */
+  if (shared->published != NULL) {
+    fs_shm_unmap(shared->published, shared->published_size);
+    _ini_shared_name(name, shared->name, shared->generation);
+    fs_shm_delete(name);
+  }
+  shared->published = image;
+  shared->published_size = size;
+  shared->generation = generation;
+  return true;
+}
+
+const ini_t* ini_shared_get(ini_shared_t* shared) {
+  INI_ASSERT(shared && !shared->publisher);
+  uint64_t generation = _ini_atomic_load64(&shared->control->generation);
+  while (generation != shared->generation) {
+    char name[_INI_MAX_SHARED_NAME];
+    _ini_shared_name(name, shared->name, generation);
+    size_t size;
+    const void* image = fs_shm_open(name, &size);
+    ini_t* ini = (image != NULL) ? ini_image_open(image, size) : NULL;
+    if (ini != NULL) {
+      if (shared->ini != NULL) {
+        ini_destroy(shared->ini);
+        fs_shm_unmap(shared->image, shared->image_size);
+      }
+      shared->ini = ini;
+      shared->image = image;
+      shared->image_size = size;
+      shared->generation = generation;
+      break;
+    }
+    if (image != NULL) {
+      fs_shm_unmap(image, size);
+    }
+    /* the image was replaced before it could be opened, try the newer one */
+    const uint64_t latest = _ini_atomic_load64(&shared->control->generation);
+    if (latest == generation) {
+      break;
+    }
+    generation = latest;
+  }
+  return shared->ini;
+}
+
+uint64_t ini_shared_generation(const ini_shared_t* shared) {
+  INI_ASSERT(shared);
+  return shared->generation;
+}
+
+void ini_shared_close(ini_shared_t* shared) {
+  INI_ASSERT(shared);
+  if (shared->ini != NULL) {
+    ini_destroy(shared->ini);
+    fs_shm_unmap(shared->image, shared->image_size);
+  }
+  if (shared->published != NULL) {
+    char name[_INI_MAX_SHARED_NAME];
+    fs_shm_unmap(shared->published, shared->published_size);
+    _ini_shared_name(name, shared->name, shared->generation);
+    fs_shm_delete(name);
+  }
+  fs_shm_unmap(shared->control, sizeof(_ini_shared_control_t));
+  if (shared->publisher) {
+    fs_shm_delete(shared->name);
+  }
+  INI_FREE(shared);
+}
+#endif
+
 #endif /* INI_IMPLEMENTATION */
\ No newline at end of file
@@ -0,0 +1,95 @@
+/*
+    alloc.h -- counting allocators for header-test.
+
+    Point the allocator macros of a header at them before including its
+    implementation:
+
+      #define INI_MALLOC(s) alloc_malloc(s)
+      #define INI_FREE(p)   alloc_free(p)
+      #define INI_IMPL
+      #include "ini.h"
+
+    Every compilation unit counts its own allocations. A test takes a
+    snapshot with `alloc_begin`, runs the code it measures, and gets what
+    that code allocated with `alloc_end`:
+
+      alloc_stats_t stats;
+      alloc_begin();
+      ini_destroy(ini_load(data));
+      alloc_end(&stats);
+      TEST_CHECK(stats.allocs == 6 && stats.bytes == 0);
+
+    Counts are exact on one thread; with several, the peak is approximate.
+*/
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef struct alloc_stats_t {
+  size_t allocs;    /* allocations made */
+  size_t frees;     /* allocations freed, including ones made before */
+  int64_t bytes;    /* bytes allocated and not freed, negative if more was freed */
+  int64_t peak;     /* most bytes allocated at once */
+} alloc_stats_t;
+
+/* every allocation is preceded by its size, padded to keep the alignment of malloc */
+#define ALLOC_HEADER_ (16)
+
+#if defined(__GNUC__) || defined(__clang__)
+  #define ALLOC_ADD_(p, v) __atomic_add_fetch((p), (v), __ATOMIC_RELAXED)
+#else
+  #define ALLOC_ADD_(p, v) (*(p) += (v))
+#endif
+
+static struct {
+  size_t allocs;
+  size_t frees;
+  int64_t bytes;
+  int64_t peak;
+  int64_t start;
+} alloc_state_;
+
+static inline void* alloc_malloc(size_t size) {
+  char* p = (char*) malloc(size + ALLOC_HEADER_);
+  if (p == NULL) {
+    return NULL;
+  }
+  *(size_t*) p = size;
+  ALLOC_ADD_(&alloc_state_.allocs, 1);
+  const int64_t bytes = ALLOC_ADD_(&alloc_state_.bytes, (int64_t) size);
+  if (bytes > alloc_state_.peak) {
+    alloc_state_.peak = bytes;
+  }
+  return p + ALLOC_HEADER_;
+}
+
+static inline void alloc_free(void* ptr) {
+  if (ptr == NULL) {
+    return;
+  }
+  char* p = (char*) ptr - ALLOC_HEADER_;
+  ALLOC_ADD_(&alloc_state_.frees, 1);
+  ALLOC_ADD_(&alloc_state_.bytes, -(int64_t) *(size_t*) p);
+  free(p);
+}
+
+/* starts counting from zero */
+static inline void alloc_begin(void) {
+  alloc_state_.allocs = 0;
+  alloc_state_.frees = 0;
+  alloc_state_.start = alloc_state_.bytes;
+  alloc_state_.peak = alloc_state_.bytes;
+}
+
+/* get what was allocated since `alloc_begin` */
+static inline void alloc_end(alloc_stats_t* stats) {
+  stats->allocs = alloc_state_.allocs;
+  stats->frees = alloc_state_.frees;
+  stats->bytes = alloc_state_.bytes - alloc_state_.start;
+  stats->peak = alloc_state_.peak - alloc_state_.start;
+}
+
+#endif /* ALLOC_H */
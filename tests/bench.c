@@ -0,0 +1,52 @@
+#include "bench.h"
+
+/* ini.h */
+extern void bench_ini_parse(void);
+extern void bench_ini_load_into(void);
+extern void bench_ini_clone(void);
+extern void bench_ini_schema(void);
+extern void bench_ini_encoding(void);
+extern void bench_ini_duplicates(void);
+extern void bench_ini_value(void);
+extern void bench_ini_value_1m(void);
+extern void bench_ini_find_section_path(void);
+extern void bench_ini_values_batch(void);
+extern void bench_ini_keys_with_prefix(void);
+extern void bench_ini_property_exists(void);
+extern void bench_ini_value_as_int_array(void);
+extern void bench_ini_apply_env(void);
+extern void bench_ini_load_file(void);
+extern void bench_ini_load_lazy(void);
+extern void bench_ini_diff(void);
+extern void bench_ini_shared(void);
+extern void bench_ini_editor(void);
+extern void bench_ini_version(void);
+extern void bench_ini_scaling(void);
+
+BENCH_LIST = {
+  /* ini.h */
+  { "ini_parse", bench_ini_parse },
+  { "ini_load_into", bench_ini_load_into },
+  { "ini_clone", bench_ini_clone },
+  { "ini_schema", bench_ini_schema },
+  { "ini_encoding", bench_ini_encoding },
+  { "ini_duplicates", bench_ini_duplicates },
+  { "ini_value", bench_ini_value },
+  { "ini_value_1m", bench_ini_value_1m },
+  { "ini_find_section_path", bench_ini_find_section_path },
+  { "ini_values_batch", bench_ini_values_batch },
+  { "ini_keys_with_prefix", bench_ini_keys_with_prefix },
+  { "ini_property_exists", bench_ini_property_exists },
+  { "ini_value_as_int_array", bench_ini_value_as_int_array },
+  { "ini_apply_env", bench_ini_apply_env },
+  { "ini_load_file", bench_ini_load_file },
+  { "ini_load_lazy", bench_ini_load_lazy },
+  { "ini_diff", bench_ini_diff },
+  { "ini_shared", bench_ini_shared },
+  { "ini_editor", bench_ini_editor },
+  { "ini_version", bench_ini_version },
+  { "ini_scaling", bench_ini_scaling },
+
+  /* always last. */
+  { NULL, NULL }
+};
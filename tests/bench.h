@@ -0,0 +1,170 @@
+/*
+    bench.h -- a *tiny* benchmark harness for header-bench.
+
+    Benchmarks are listed the same way as acutest tests:
+
+      BENCH_LIST = {
+        { "name", bench_func },
+        { NULL, NULL }
+      };
+
+    Define BENCH_NO_MAIN in all compilation units but one. Every argument
+    on the command line selects the benchmarks whose name contains it; with
+    no arguments all benchmarks are run. Each benchmark reports its results
+    with `bench_report` as `name case metric value unit` lines, or as a JSON
+    array of objects when `--json` is passed, for tracking over time:
+
+      [
+        { "bench": "ini_parse", "case": "small", "metric": "parse", "value": 512.3, "unit": "MB/s" },
+        ...
+      ]
+*/
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+struct bench_ {
+  const char* name;
+  void (*func)(void);
+};
+
+#define BENCH_LIST const struct bench_ bench_list_[]
+
+/* monotonic time in nanoseconds */
+static inline uint64_t bench_now(void) {
+  struct timespec ts;
+#if defined(CLOCK_MONOTONIC)
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+  timespec_get(&ts, TIME_UTC);
+#endif
+  return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+/* hardware cache misses of the calling thread so far, or -1 if they
+   can't be counted on this system; take the difference of two calls. */
+static inline int64_t bench_cache_misses(void) {
+#if defined(__linux__)
+  static int fd = -2;
+  if (fd == -2) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+  int64_t count;
+  if (fd >= 0 && read(fd, &count, sizeof(count)) == sizeof(count)) {
+    return count;
+  }
+#endif
+  return -1;
+}
+
+/* most memory resident in the process since it started, or since
+   `bench_reset_peak_rss`, in bytes; -1 if it can't be read. */
+static inline int64_t bench_peak_rss(void) {
+  int64_t kb = -1;
+#if defined(__linux__)
+  FILE* f = fopen("/proc/self/status", "r");
+  char line[128];
+  while (f != NULL && fgets(line, sizeof(line), f) != NULL) {
+    if (strncmp(line, "VmHWM:", 6) == 0) {
+      kb = 0;
+      for (const char* c = line + 6; *c != '\0'; c++) {
+        if (*c >= '0' && *c <= '9') {
+          kb = kb * 10 + (*c - '0');
+        }
+      }
+      break;
+    }
+  }
+  if (f != NULL) {
+    fclose(f);
+  }
+#endif
+  return (kb < 0) ? -1 : kb * 1024;
+}
+
+/* starts measuring `bench_peak_rss` from what is resident now */
+static inline void bench_reset_peak_rss(void) {
+#if defined(__linux__)
+  FILE* f = fopen("/proc/self/clear_refs", "w");
+  if (f != NULL) {
+    fputs("5", f);
+    fclose(f);
+  }
+#endif
+}
+
+/* reports a single measurement of the running benchmark */
+extern void bench_report(const char* case_name, const char* metric, double value, const char* unit);
+
+#ifndef BENCH_NO_MAIN
+
+extern const struct bench_ bench_list_[];
+static const char* bench_current_ = NULL;
+static int bench_json_ = 0;
+static int bench_reports_ = 0;
+
+void bench_report(const char* case_name, const char* metric, double value, const char* unit) {
+  if (bench_json_) {
+    printf("%s\n  { \"bench\": \"%s\", \"case\": \"%s\", \"metric\": \"%s\", \"value\": %.3f, \"unit\": \"%s\" }",
+      (bench_reports_ > 0) ? "," : "", bench_current_, case_name, metric, value, unit);
+  } else {
+    printf("%-24s %-28s %-20s %14.3f %s\n", bench_current_, case_name, metric, value, unit);
+  }
+  bench_reports_++;
+  fflush(stdout);
+}
+
+static int bench_selected_(const char* name, int argc, char** argv) {
+  int filtered = 0;
+  for (int i = 1; i < argc; i++) {
+    if (argv[i][0] == '-') {
+      continue;
+    }
+    filtered = 1;
+    if (strstr(name, argv[i]) != NULL) {
+      return 1;
+    }
+  }
+  return !filtered;
+}
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--json") == 0) {
+      bench_json_ = 1;
+    }
+  }
+  if (bench_json_) {
+    printf("[");
+  }
+  for (const struct bench_* bench = bench_list_; bench->name != NULL; bench++) {
+    if (bench_selected_(bench->name, argc, argv)) {
+      bench_current_ = bench->name;
+      bench->func();
+    }
+  }
+  if (bench_json_) {
+    printf("\n]\n");
+  }
+  return 0;
+}
+
+#endif /* BENCH_NO_MAIN */
+#endif /* BENCH_H */
@@ -1,6 +1,10 @@
 #define TEST_NO_MAIN
 #include "acutest.h"
 
+#include "alloc.h"
+
+#define FS_MALLOC(s) alloc_malloc(s)
+#define FS_FREE(p)   alloc_free(p)
 #define FS_IMPL
 #include "filesystem.h"
 
@@ -59,6 +63,7 @@ void test__fs_native_read(void) {
   FILE *fp; const char* str = "The quick brown fox jumps over the lazy dog.";
   fp = fopen("is_a_file.txt" , "wb");
   fwrite(str, 1, strlen(str), fp);
+  fclose(fp);
   size_t size;
 
   TEST_CASE("read from null file");
@@ -68,12 +73,14 @@ void test__fs_native_read(void) {
   TEST_CASE("read file that doesn't exist");
   TEST_CHECK(_fs_native_read(fp, &size) == NULL);
 
+  /* reading closes the file */
   fp = fopen("is_a_file.txt", "rb");
   TEST_CASE("read file that does exist");
-  TEST_CHECK(_fs_native_read(fp, &size) != NULL);
+  char* data = (char*) _fs_native_read(fp, &size);
+  TEST_CHECK(data != NULL && size == strlen(str) && strcmp(data, str) == 0);
 
   /* cleanup */
-  fclose(fp);
+  fs_free(data);
   remove("is_a_file.txt");
 }
 
@@ -85,6 +92,7 @@ void test__fs_native_write(void) {
   TEST_CASE("write to null file");
   TEST_CHECK(_fs_native_write(NULL, &desc) == false);
 
+  /* writing closes the file */
   fp = fopen("test_write.txt", "w");
   TEST_CASE("read file that doesn't exist");
   TEST_CHECK(_fs_native_write(fp, &desc) == true);
@@ -94,7 +102,6 @@ void test__fs_native_write(void) {
   TEST_CHECK(_fs_native_write(fp, &desc) == true);
 
   /* cleanup */
-  fclose(fp);
   remove("test_write.txt");
 }
 
@@ -130,6 +137,7 @@ void test_fs_append(void) {
     char *data = fs_read("is_a_file.txt", &size);
     TEST_CHECK(data != NULL);
     TEST_CHECK(strcmp(data, str) == 0);
+    fs_free(data);
   }
 
   TEST_CASE("append to file that does exist");
@@ -142,6 +150,7 @@ void test_fs_append(void) {
     char *data = fs_read("is_a_file.txt", &size);
     TEST_CHECK(data != NULL);
     TEST_CHECK(strcmp(data, full) == 0);
+    fs_free(data);
   }
 
   /* cleanup */
@@ -262,24 +271,127 @@ void test_fs_read(void) {
   TEST_CASE("read file that doesn't exist");
   if (TEST_CHECK(!fs_exists("not_a_file.txt"))) {
     size_t size;
+    alloc_stats_t stats;
+    alloc_begin();
     char* data = fs_read("not_a_file.txt", &size);
-    
+    alloc_end(&stats);
+
     TEST_CHECK(data == NULL);
+    TEST_CHECK(stats.allocs == 0);
   }
 
   TEST_CASE("read file that does exist");
   if (TEST_CHECK(fs_exists("is_a_file.txt"))) {
     size_t size;
+    alloc_stats_t stats;
+    alloc_begin();
     char* data = fs_read("is_a_file.txt", &size);
-    
+    alloc_end(&stats);
+
     TEST_CHECK(data != NULL);
     TEST_CHECK(strcmp(data, str) == 0);
+
+    TEST_CASE("read into a single allocation");
+    TEST_CHECK(stats.allocs == 1 && stats.peak == (int64_t) size + 1);
+    TEST_MSG("Allocations: %d, peak: %d bytes", (int) stats.allocs, (int) stats.peak);
+    fs_free(data);
+  }
+
+  /* cleanup */
+  fs_delete("is_a_file.txt");
+}
+
+void test_fs_map(void) {
+  /* setup filesystem */
+  char* cwd = (char*) fs_get_cwd();
+  fs_setup(&(fs_desc) { .write_dir = cwd, .base_paths = { cwd } });
+
+  /* create a file */
+  const char* str = "The quick brown fox jumps over the lazy dog.";
+  fs_write("is_a_file.txt", FS_DATA_STR_REF(str));
+
+  TEST_CASE("map file that doesn't exist");
+  if (TEST_CHECK(!fs_exists("not_a_file.txt"))) {
+    size_t size;
+    TEST_CHECK(fs_map("not_a_file.txt", &size) == NULL);
+  }
+
+  TEST_CASE("map file that does exist");
+  if (TEST_CHECK(fs_exists("is_a_file.txt"))) {
+    size_t size;
+    char* data = fs_map("is_a_file.txt", &size);
+    if (TEST_CHECK(data != NULL)) {
+      TEST_CHECK(size == strlen(str));
+      TEST_CHECK(strcmp(data, str) == 0);
+
+      TEST_CASE("writes to a mapping are private");
+      data[0] = 't';
+      fs_unmap(data, size);
+      data = fs_map("is_a_file.txt", &size);
+      TEST_CHECK(data != NULL && data[0] == 'T');
+      fs_unmap(data, size);
+    }
   }
 
   /* cleanup */
   fs_delete("is_a_file.txt");
 }
 
+void test_fs_shm_create(void) {
+  TEST_CASE("create a shared memory object");
+  char* data = (char*) fs_shm_create("header-test-shm", 4096);
+  if (TEST_CHECK(data != NULL)) {
+    TEST_CHECK(data[0] == 0 && data[4095] == 0);
+    strcpy(data, "The quick brown fox jumps over the lazy dog.");
+
+    TEST_CASE("replace a shared memory object");
+    char* other = (char*) fs_shm_create("header-test-shm", 8192);
+    if (TEST_CHECK(other != NULL)) {
+      TEST_CHECK(other[0] == 0);
+      fs_shm_unmap(other, 8192);
+    }
+    fs_shm_unmap(data, 4096);
+  }
+
+  TEST_CASE("create an empty shared memory object");
+  TEST_CHECK(fs_shm_create("header-test-shm-empty", 0) == NULL);
+
+  /* cleanup */
+  fs_shm_delete("header-test-shm");
+}
+
+void test_fs_shm_open(void) {
+  TEST_CASE("open a shared memory object that doesn't exist");
+  size_t size;
+  TEST_CHECK(fs_shm_open("header-test-not-shm", &size) == NULL);
+
+  TEST_CASE("open a shared memory object that does exist");
+  const char* str = "The quick brown fox jumps over the lazy dog.";
+  char* data = (char*) fs_shm_create("header-test-shm", 4096);
+  if (TEST_CHECK(data != NULL)) {
+    const char* view = (const char*) fs_shm_open("header-test-shm", &size);
+    if (TEST_CHECK(view != NULL)) {
+      TEST_CHECK(size == 4096);
+
+      TEST_CASE("writes are seen by other mappings");
+      strcpy(data, str);
+      TEST_CHECK(strcmp(view, str) == 0);
+      fs_shm_unmap(view, size);
+    }
+    fs_shm_unmap(data, 4096);
+  }
+
+  TEST_CASE("mappings outlive the name");
+  data = (char*) fs_shm_create("header-test-shm", 4096);
+  if (TEST_CHECK(data != NULL)) {
+    strcpy(data, str);
+    TEST_CHECK(fs_shm_delete("header-test-shm") == true);
+    TEST_CHECK(fs_shm_open("header-test-shm", &size) == NULL);
+    TEST_CHECK(strcmp(data, str) == 0);
+    fs_shm_unmap(data, 4096);
+  }
+}
+
 void test_fs_write(void) {
   /* setup filesystem */
   char* cwd = (char*) fs_get_cwd();
@@ -288,13 +400,20 @@ void test_fs_write(void) {
   TEST_CASE("write to file that doesn't exist");
   if (TEST_CHECK(!fs_exists("is_a_file.txt"))) {
     const char* str = "The quick brown fox jumps over the lazy dog.";
+    alloc_stats_t stats;
+    alloc_begin();
     TEST_CHECK(fs_write("is_a_file.txt", FS_DATA_STR_REF(str)) == true);
+    alloc_end(&stats);
     TEST_CHECK(fs_exists("is_a_file.txt") == true);
 
+    TEST_CASE("write without allocating");
+    TEST_CHECK(stats.allocs == 0);
+
     size_t size;
     char *data = fs_read("is_a_file.txt", &size);
     TEST_CHECK(data != NULL);
     TEST_CHECK(strcmp(data, str) == 0);
+    fs_free(data);
   }
 
   TEST_CASE("write to file that does exist");
@@ -306,12 +425,55 @@ void test_fs_write(void) {
     char *data = fs_read("is_a_file.txt", &size);
     TEST_CHECK(data != NULL);
     TEST_CHECK(strcmp(data, str) == 0);
+    fs_free(data);
   }
 
   /* cleanup */
   fs_delete("is_a_file.txt");
 }
 
+void test_fs_writev(void) {
+  /* setup filesystem */
+  char* cwd = (char*) fs_get_cwd();
+  fs_setup(&(fs_desc) { .write_dir = cwd, .base_paths = { cwd } });
+
+  TEST_CASE("write buffers one after another");
+  const fs_data pieces[] = {
+    { "The quick brown fox ", 20 },
+    { "", 0 },
+    { "jumps over ", 11 },
+    { "the lazy dog.", 13 },
+  };
+  TEST_CHECK(fs_writev("is_a_file.txt", pieces, 4) == true);
+  size_t size;
+  char* data = fs_read("is_a_file.txt", &size);
+  if (TEST_CHECK(data != NULL)) {
+    TEST_CHECK(size == 44 && memcmp(data, "The quick brown fox jumps over the lazy dog.", 44) == 0);
+    fs_free(data);
+  }
+
+  TEST_CASE("write more buffers than a single batch");
+  static fs_data letters[200];
+  for (int i = 0; i < 200; i++) {
+    letters[i].data = &"abcdefghijklmnopqrstuvwxyz"[i % 26];
+    letters[i].size = 1;
+  }
+  TEST_CHECK(fs_writev("is_a_file.txt", letters, 200) == true);
+  data = fs_read("is_a_file.txt", &size);
+  if (TEST_CHECK(data != NULL)) {
+    TEST_CHECK(size == 200 && data[0] == 'a' && data[26] == 'a' && data[199] == 'r');
+    fs_free(data);
+  }
+
+  TEST_CASE("write no buffers");
+  TEST_CHECK(fs_writev("is_a_file.txt", NULL, 0) == true);
+  fs_info info;
+  TEST_CHECK(fs_get_info("is_a_file.txt", &info) == true && info.size == 0);
+
+  /* cleanup */
+  fs_delete("is_a_file.txt");
+}
+
 void test_fs_insert_basepath(void) {
   /* setup filesystem */
   fs_setup(&(fs_desc) {  });
@@ -0,0 +1,1248 @@
+#define BENCH_NO_MAIN
+#include "bench.h"
+
+#include <stdlib.h>
+
+/* counting allocator, tracks allocations and live bytes made by ini.h */
+static size_t bench_allocs = 0;
+static size_t bench_live = 0;
+static size_t bench_peak = 0;
+
+static void* bench_malloc(size_t size) {
+  size_t* p = (size_t*) malloc(size + sizeof(size_t) * 2);
+  if (p == NULL) {
+    return NULL;
+  }
+  p[0] = size;
+  bench_allocs++;
+  bench_live += size;
+  bench_peak = (bench_live > bench_peak) ? bench_live : bench_peak;
+  return p + 2;
+}
+
+static void bench_free(void* ptr) {
+  if (ptr != NULL) {
+    size_t* p = (size_t*) ptr - 2;
+    bench_live -= p[0];
+    free(p);
+  }
+}
+
+#define FS_IMPL
+#include "filesystem.h"
+
+#define INI_MALLOC(s) bench_malloc(s)
+#define INI_FREE(p)   bench_free(p)
+#define INI_IMPL
+#include "ini.h"
+
+/* helpers */
+
+typedef struct {
+  const char* name;
+  int sections;
+  int keys;           /* properties per section */
+  int key_len;
+  int value_len;
+  int comment_every;  /* a comment line every n properties, 0 for none */
+  int escape_every;   /* quote values and escape every n characters, 0 for none */
+} corpus_desc;
+
+enum { CORPUS_UNESCAPED = 1 << 30 };
+
+static const corpus_desc corpora[] = {
+  { "small",         16,   16,  8,  16, 0, 0 },
+  { "many-sections", 4096, 4,   8,  16, 0, 0 },
+  { "wide-section",  4,    4096, 8, 16, 0, 0 },
+  { "long-keys",     64,   64,  48, 16, 0, 0 },
+  { "long-values",   64,   64,  8,  512, 0, 0 },
+  { "commented",     64,   64,  8,  16, 1, 0 },
+  { "quoted",        64,   64,  8,  128, 0, CORPUS_UNESCAPED },
+  { "escaped",       64,   64,  8,  128, 0, 4 },
+};
+
+static volatile size_t bench_sink = 0;
+
+/* writes the name of key `k`, padded to `len` characters */
+static int corpus_key(char* dst, int k, int len) {
+  int n = sprintf(dst, "key%d", k);
+  if (n < 0) {
+    n = 0;
+  }
+  for (; n < len; n++) {
+    dst[n] = 'a' + (n % 26);
+  }
+  dst[n] = '\0';
+  return n;
+}
+
+static char* corpus_make(const corpus_desc* desc, size_t* len) {
+  size_t line = desc->key_len + desc->value_len * 2 + 64;
+  size_t size = (size_t) desc->sections * desc->keys * line * 2 + 64;
+  char* buf = (char*) malloc(size);
+  size_t pos = 0;
+  for (int s = 0; s < desc->sections; s++) {
+    pos += sprintf(buf + pos, "[section%d]\n", s);
+    for (int k = 0; k < desc->keys; k++) {
+      if (desc->comment_every > 0 && (k % desc->comment_every) == 0) {
+        pos += sprintf(buf + pos, "; comment for key %d of section %d\n", k, s);
+      }
+      pos += corpus_key(buf + pos, k, desc->key_len);
+      pos += sprintf(buf + pos, " = ");
+      if (desc->escape_every > 0) {
+        buf[pos++] = '"';
+      }
+      for (int v = 0; v < desc->value_len; v++) {
+        if (desc->escape_every > 0 && (v % desc->escape_every) == desc->escape_every - 1) {
+          buf[pos++] = '\\';
+          buf[pos++] = (v & 1) ? '"' : 'n';
+          continue;
+        }
+        buf[pos++] = 'a' + ((s + k + v) % 26);
+      }
+      if (desc->escape_every > 0) {
+        buf[pos++] = '"';
+      }
+      buf[pos++] = '\n';
+    }
+  }
+  buf[pos] = '\0';
+  *len = pos;
+  return buf;
+}
+
+/* properties parsed by a document */
+static int corpus_properties(const ini_t* ini) {
+  int n = 0;
+  for (int s = 0; s < ini->num_sections; s++) {
+    n += ini->sections[s].count;
+  }
+  return n;
+}
+
+static int iterations_for(size_t size) {
+  size_t n = (64u << 20) / size;
+  return (n < 1) ? 1 : (n > 2000) ? 2000 : (int) n;
+}
+
+/* benchmarks */
+
+void bench_ini_parse(void) {
+  for (size_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); i++) {
+    const corpus_desc* desc = &corpora[i];
+    size_t len;
+    char* corpus = corpus_make(desc, &len);
+    const int n = iterations_for(len);
+
+    bench_allocs = bench_live = bench_peak = 0;
+    ini_t* ini = ini_load(corpus);
+    const double properties = (double) corpus_properties(ini);
+    const size_t allocs = bench_allocs;
+    const size_t index = bench_peak - (ini->size + 1);
+    ini_destroy(ini);
+
+    uint64_t start = bench_now();
+    for (int j = 0; j < n; j++) {
+      ini_destroy(ini_load(corpus));
+    }
+    const double seconds = (double) (bench_now() - start) / 1e9;
+
+    bench_report(desc->name, "parse", (double) len * n / seconds / (1 << 20), "MB/s");
+    bench_report(desc->name, "allocations", (double) allocs, "allocs/load");
+    bench_report(desc->name, "index", (double) index / properties, "bytes/property");
+    free(corpus);
+  }
+}
+
+void bench_ini_encoding(void) {
+  /* the cost of checking UTF-8 while tokenizing, and of "\r\n" lines,
+     against parsing the same corpus as it is */
+  static const corpus_desc cases[] = {
+    { "long-values", 64, 64, 8, 512, 0, 0 },
+    { "commented", 256, 64, 8, 16, 1, 0 },
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    size_t len;
+    char* corpus = corpus_make(&cases[i], &len);
+    char* crlf = (char*) malloc(len * 2 + 1);
+    size_t crlf_len = 0;
+    for (size_t k = 0; k < len; k++) {
+      if (corpus[k] == '\n') {
+        crlf[crlf_len++] = '\r';
+      }
+      crlf[crlf_len++] = corpus[k];
+    }
+    crlf[crlf_len] = '\0';
+    const int n = iterations_for(len);
+
+    const struct { const char* metric; const char* data; size_t size; bool utf8; } runs[] = {
+      { "parse", corpus, len, false },
+      { "parse+utf8", corpus, len, true },
+      { "parse crlf", crlf, crlf_len, false },
+      { "parse crlf+utf8", crlf, crlf_len, true },
+    };
+    for (size_t r = 0; r < sizeof(runs) / sizeof(runs[0]); r++) {
+      uint64_t start = bench_now();
+      for (int j = 0; j < n; j++) {
+        ini_destroy(ini_load_desc(&(ini_desc) { .data = runs[r].data, .size = runs[r].size, .utf8 = runs[r].utf8 }));
+      }
+      const double seconds = (double) (bench_now() - start) / 1e9;
+      bench_report(cases[i].name, runs[r].metric, (double) runs[r].size * n / seconds / (1 << 20), "MB/s");
+    }
+    free(crlf);
+    free(corpus);
+  }
+}
+
+void bench_ini_load_into(void) {
+  for (size_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); i++) {
+    const corpus_desc* desc = &corpora[i];
+    size_t len;
+    char* corpus = corpus_make(desc, &len);
+    const int n = iterations_for(len);
+
+    bench_allocs = 0;
+    uint64_t start = bench_now();
+    for (int j = 0; j < n; j++) {
+      ini_destroy(ini_load(corpus));
+    }
+    bench_report(desc->name, "ini_load", (double) (bench_now() - start) / n / 1000.0, "us/load");
+    bench_report(desc->name, "ini_load", (double) bench_allocs / n, "allocs/load");
+
+    ini_t* ini = ini_load_into(NULL, corpus, len);
+    bench_allocs = 0;
+    start = bench_now();
+    for (int j = 0; j < n; j++) {
+      ini = ini_load_into(ini, corpus, len);
+    }
+    bench_report(desc->name, "ini_load_into", (double) (bench_now() - start) / n / 1000.0, "us/load");
+    bench_report(desc->name, "ini_load_into", (double) bench_allocs / n, "allocs/load");
+    ini_destroy(ini);
+    free(corpus);
+  }
+}
+
+void bench_ini_value(void) {
+  for (size_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); i++) {
+    const corpus_desc* desc = &corpora[i];
+    size_t len;
+    char* corpus = corpus_make(desc, &len);
+    ini_t* ini = ini_load(corpus);
+
+    /* spread the probes over every section and key */
+    enum { PROBES = 1024 };
+    static char keys[PROBES][80];
+    static int sections[PROBES];
+    for (int j = 0; j < PROBES; j++) {
+      sections[j] = 1 + (int) ((j * 7919u) % desc->sections);
+      corpus_key(keys[j], (int) ((j * 104729u) % desc->keys), desc->key_len);
+    }
+    /* run whole rounds of probes for at least 100ms */
+    uint64_t start = bench_now(), elapsed = 0;
+    size_t ops = 0;
+    while (elapsed < 100000000u) {
+      for (int j = 0; j < PROBES; j++) {
+        bench_sink += (size_t) ini_value(ini, sections[j], keys[j]);
+      }
+      ops += PROBES;
+      elapsed = bench_now() - start;
+    }
+    bench_report(desc->name, "lookup hit", (double) elapsed / ops, "ns/op");
+
+    /* same keys with the last character changed never match */
+    for (int j = 0; j < PROBES; j++) {
+      keys[j][strlen(keys[j]) - 1] = '!';
+    }
+    start = bench_now(), elapsed = 0, ops = 0;
+    while (elapsed < 100000000u) {
+      for (int j = 0; j < PROBES; j++) {
+        bench_sink += (size_t) ini_value(ini, sections[j], keys[j]);
+      }
+      ops += PROBES;
+      elapsed = bench_now() - start;
+    }
+    bench_report(desc->name, "lookup miss", (double) elapsed / ops, "ns/op");
+
+    ini_destroy(ini);
+    free(corpus);
+  }
+}
+
+void bench_ini_value_1m(void) {
+  /* a million properties over 1024 sections, probed in random order */
+  corpus_desc desc = { "1M properties", 1024, 1024, 12, 16, 0, 0 };
+  size_t len;
+  char* corpus = corpus_make(&desc, &len);
+  ini_t* ini = ini_load(corpus);
+
+  enum { PROBES = 4096 };
+  static char keys[PROBES][32];
+  static int sections[PROBES];
+  uint64_t x = 88172645463325252ull;
+  for (int j = 0; j < PROBES; j++) {
+    x ^= x << 13, x ^= x >> 7, x ^= x << 17;
+    sections[j] = 1 + (int) (x % desc.sections);
+    corpus_key(keys[j], (int) ((x >> 32) % desc.keys), desc.key_len);
+  }
+  for (int miss = 0; miss < 2; miss++) {
+    if (miss) {
+      for (int j = 0; j < PROBES; j++) {
+        keys[j][strlen(keys[j]) - 1] = '!';
+      }
+    }
+    const int64_t misses = bench_cache_misses();
+    uint64_t start = bench_now(), elapsed = 0;
+    size_t ops = 0;
+    while (elapsed < 200000000u) {
+      for (int j = 0; j < PROBES; j++) {
+        bench_sink += ini_value_span(ini, sections[j], keys[j]).len;
+      }
+      ops += PROBES;
+      elapsed = bench_now() - start;
+    }
+    const char* metric = miss ? "lookup miss" : "lookup hit";
+    bench_report(desc.name, metric, (double) elapsed / ops, "ns/op");
+    if (misses >= 0) {
+      bench_report(desc.name, metric, (double) (bench_cache_misses() - misses) / ops, "cache misses/op");
+    }
+  }
+  ini_destroy(ini);
+  free(corpus);
+}
+
+void bench_ini_values_batch(void) {
+  /* binding 50 keys of a section, one call per key or a single batch */
+  static const int widths[] = { 64, 1024, 16384 };
+  for (size_t i = 0; i < sizeof(widths) / sizeof(widths[0]); i++) {
+    corpus_desc desc = { NULL, 4, widths[i], 12, 16, 0, 0 };
+    char name[32];
+    sprintf(name, "50 of %d keys", widths[i]);
+    size_t len;
+    char* corpus = corpus_make(&desc, &len);
+    ini_t* ini = ini_load(corpus);
+
+    enum { KEYS = 50 };
+    static char names[KEYS][32];
+    const char* keys[KEYS];
+    const char* values[KEYS];
+    for (int j = 0; j < KEYS; j++) {
+      corpus_key(names[j], (int) ((j * 104729u) % desc.keys), desc.key_len);
+      keys[j] = names[j];
+    }
+    uint64_t start = bench_now(), elapsed = 0;
+    size_t ops = 0;
+    while (elapsed < 100000000u) {
+      for (int j = 0; j < KEYS; j++) {
+        values[j] = ini_value(ini, 2, keys[j]);
+      }
+      bench_sink += (size_t) values[KEYS - 1];
+      ops++;
+      elapsed = bench_now() - start;
+    }
+    bench_report(name, "ini_value", (double) elapsed / ops / 1000.0, "us/bind");
+
+    start = bench_now(), elapsed = 0, ops = 0;
+    while (elapsed < 100000000u) {
+      bench_sink += ini_values_batch(ini, 2, keys, KEYS, values);
+      ops++;
+      elapsed = bench_now() - start;
+    }
+    bench_report(name, "ini_values_batch", (double) elapsed / ops / 1000.0, "us/bind");
+    ini_destroy(ini);
+    free(corpus);
+  }
+}
+
+void bench_ini_find_section_path(void) {
+  /* sections nested three deep, `[sN.sM.sK]`, found by their full name in
+     the flat list of sections or by walking the tree */
+  static const int fanouts[] = { 4, 16, 32 };
+  for (size_t i = 0; i < sizeof(fanouts) / sizeof(fanouts[0]); i++) {
+    const int n = fanouts[i];
+    char name[32];
+    sprintf(name, "%d sections", n + n * n + n * n * n);
+    char* corpus = (char*) malloc((size_t) (n + n * n + n * n * n) * 32 + 1);
+    size_t len = 0;
+    for (int a = 0; a < n; a++) {
+      len += (size_t) sprintf(corpus + len, "[s%d]\nk = v\n", a);
+      for (int b = 0; b < n; b++) {
+        len += (size_t) sprintf(corpus + len, "[s%d.s%d]\nk = v\n", a, b);
+        for (int c = 0; c < n; c++) {
+          len += (size_t) sprintf(corpus + len, "[s%d.s%d.s%d]\nk = v\n", a, b, c);
+        }
+      }
+    }
+    ini_t* ini = ini_load(corpus);
+    char path[48];
+
+    uint64_t start = bench_now(), elapsed = 0;
+    size_t ops = 0;
+    while (elapsed < 100000000u) {
+      const unsigned k = (unsigned) (ops * 7919u);
+      sprintf(path, "s%u.s%u.s%u", k % n, (k / n) % n, (k / n / n) % n);
+      bench_sink += (size_t) ini_find_section(ini, path);
+      ops++;
+      elapsed = bench_now() - start;
+    }
+    bench_report(name, "ini_find_section", (double) elapsed / ops, "ns/op");
+
+    start = bench_now(), elapsed = 0, ops = 0;
+    while (elapsed < 100000000u) {
+      const unsigned k = (unsigned) (ops * 7919u);
+      sprintf(path, "s%u.s%u.s%u", k % n, (k / n) % n, (k / n / n) % n);
+      bench_sink += (size_t) ini_find_section_path(ini, path);
+      ops++;
+      elapsed = bench_now() - start;
+    }
+    bench_report(name, "ini_find_section_path", (double) elapsed / ops, "ns/op");
+    ini_destroy(ini);
+    free(corpus);
+  }
+}
+
+void bench_ini_keys_with_prefix(void) {
+  /* one pool of four keys out of a section of pools, found by scanning
+     every key of the section or with a prefix query */
+  static const int pools[] = { 256, 4096, 65536 };
+  for (size_t i = 0; i < sizeof(pools) / sizeof(pools[0]); i++) {
+    char name[32];
+    sprintf(name, "%d keys", pools[i] * 4);
+    size_t len = 0;
+    char* corpus = (char*) malloc((size_t) pools[i] * 4 * 48 + 16);
+    len += (size_t) sprintf(corpus + len, "[upstream]\n");
+    for (int j = 0; j < pools[i]; j++) {
+      static const char* const fields[] = { "host", "port", "weight", "timeout" };
+      for (int f = 0; f < 4; f++) {
+        len += (size_t) sprintf(corpus + len, "pool%d.%s = %d\n", j, fields[f], j);
+      }
+    }
+    ini_t* ini = ini_load(corpus);
+    const _ini_section_t* sec = &ini->sections[1];
+    char prefix[32];
+
+    /* the first query sorts the keys of the section */
+    uint64_t start = bench_now();
+    ini_keys_t first = ini_keys_with_prefix(ini, 1, "");
+    bench_sink += first.end;
+    bench_report(name, "sort", (double) (bench_now() - start) / 1000.0, "us");
+
+    start = bench_now();
+    uint64_t elapsed = 0;
+    size_t ops = 0;
+    while (elapsed < 100000000u) {
+      const size_t prefix_len = (size_t) sprintf(prefix, "pool%d.", (int) ((ops * 7919u) % pools[i]));
+      for (_ini_off_t p = sec->first; p < sec->first + sec->count; p++) {
+        if ((size_t) ini->properties.key_len[p] >= prefix_len && memcmp(_ini_str(ini, ini->properties.key[p]), prefix, prefix_len) == 0) {
+          bench_sink += (size_t) ini->properties.value_len[p];
+        }
+      }
+      ops++;
+      elapsed = bench_now() - start;
+    }
+    bench_report(name, "scan", (double) elapsed / ops / 1000.0, "us/query");
+
+    start = bench_now(), elapsed = 0, ops = 0;
+    while (elapsed < 100000000u) {
+      sprintf(prefix, "pool%d.", (int) ((ops * 7919u) % pools[i]));
+      ini_span_t key, value;
+      ini_keys_t keys = ini_keys_with_prefix(ini, 1, prefix);
+      while (ini_keys_next(&keys, &key, &value)) {
+        bench_sink += value.len;
+      }
+      ops++;
+      elapsed = bench_now() - start;
+    }
+    bench_report(name, "ini_keys_with_prefix", (double) elapsed / ops / 1000.0, "us/query");
+    ini_destroy(ini);
+    free(corpus);
+  }
+}
+
+void bench_ini_property_exists(void) {
+  /* sections of 1000 properties, probed for optional keys that are absent */
+  static const struct { const char* name; int sections; } cases[] = {
+    { "1k properties", 1 },
+    { "100k properties", 100 },
+    { "1M properties", 1000 },
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    corpus_desc desc = { cases[i].name, cases[i].sections, 1000, 12, 16, 0, 0 };
+    size_t len;
+    char* corpus = corpus_make(&desc, &len);
+    ini_t* ini = ini_load(corpus);
+
+    enum { PROBES = 4096 };
+    static char keys[PROBES][32];
+    static int sections[PROBES];
+    for (int j = 0; j < PROBES; j++) {
+      sections[j] = 1 + (int) ((j * 7919u) % desc.sections);
+      sprintf(keys[j], "override.tenant%d", j);
+    }
+    uint64_t start = bench_now(), elapsed = 0;
+    size_t ops = 0;
+    while (elapsed < 100000000u) {
+      for (int j = 0; j < PROBES; j++) {
+        bench_sink += ini_property_exists(ini, sections[j], keys[j]);
+      }
+      ops += PROBES;
+      elapsed = bench_now() - start;
+    }
+    bench_report(desc.name, "absent", (double) elapsed / ops, "ns/op");
+
+    for (int j = 0; j < PROBES; j++) {
+      corpus_key(keys[j], (int) ((j * 104729u) % desc.keys), desc.key_len);
+    }
+    start = bench_now(), elapsed = 0, ops = 0;
+    while (elapsed < 100000000u) {
+      for (int j = 0; j < PROBES; j++) {
+        bench_sink += ini_property_exists(ini, sections[j], keys[j]);
+      }
+      ops += PROBES;
+      elapsed = bench_now() - start;
+    }
+    bench_report(desc.name, "present", (double) elapsed / ops, "ns/op");
+    ini_destroy(ini);
+    free(corpus);
+  }
+}
+
+void bench_ini_value_as_int_array(void) {
+  enum { ITEMS = 4096 };
+  char* corpus = (char*) malloc(ITEMS * 24 + 16);
+  size_t pos = sprintf(corpus, "ids = ");
+  uint64_t id = 88172645463325252ull;
+  for (int i = 0; i < ITEMS; i++) {
+    id ^= id << 13, id ^= id >> 7, id ^= id << 17;
+    pos += sprintf(corpus + pos, (i > 0) ? ", %llu" : "%llu", (unsigned long long) (id >> (i % 48)));
+  }
+  ini_t* ini = ini_load(corpus);
+  static int64_t ids[ITEMS];
+
+  /* split into temporary strings and convert each with strtoll */
+  uint64_t start = bench_now(), elapsed = 0;
+  size_t ops = 0;
+  while (elapsed < 100000000u) {
+    const char* p = ini_value(ini, INI_GLOBAL_SECTION, "ids");
+    for (size_t n = 0; *p; n++) {
+      char tmp[32];
+      size_t len = strcspn(p, ",");
+      memcpy(tmp, p, len);
+      tmp[len] = '\0';
+      ids[n] = strtoll(tmp, NULL, 10);
+      p += len + (p[len] == ',');
+    }
+    ops += ITEMS;
+    elapsed = bench_now() - start;
+  }
+  bench_report("4096 ids", "strtoll", (double) elapsed / ops, "ns/item");
+
+  start = bench_now(), elapsed = 0, ops = 0;
+  while (elapsed < 100000000u) {
+    ops += ini_value_as_int_array(ini, INI_GLOBAL_SECTION, "ids", ids, ITEMS);
+    elapsed = bench_now() - start;
+  }
+  bench_report("4096 ids", "ini_value_as_int_array", (double) elapsed / ops, "ns/item");
+
+  ini_destroy(ini);
+  free(corpus);
+}
+
+void bench_ini_diff(void) {
+  for (size_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); i++) {
+    const corpus_desc* desc = &corpora[i];
+    size_t len;
+    char* corpus = corpus_make(desc, &len);
+    ini_t* a = ini_load(corpus);
+    ini_t* b = ini_load(corpus);
+
+    uint64_t start = bench_now(), elapsed = 0;
+    size_t ops = 0;
+    while (elapsed < 100000000u) {
+      bench_sink += ini_fingerprint(a).lo;
+      ops++;
+      elapsed = bench_now() - start;
+    }
+    bench_report(desc->name, "fingerprint", (double) elapsed / ops / 1000.0, "us/op");
+
+    start = bench_now(), elapsed = 0, ops = 0;
+    while (elapsed < 100000000u) {
+      bench_sink += (size_t) ini_diff(a, b, NULL, NULL);
+      ops++;
+      elapsed = bench_now() - start;
+    }
+    bench_report(desc->name, "diff identical", (double) elapsed / ops / 1000.0, "us/op");
+
+    /* a single changed value in the middle section */
+    char key[80];
+    corpus_key(key, desc->keys / 2, desc->key_len);
+    ini_set_value(b, 1 + desc->sections / 2, key, "changed");
+    start = bench_now(), elapsed = 0, ops = 0;
+    while (elapsed < 100000000u) {
+      bench_sink += (size_t) ini_diff(a, b, NULL, NULL);
+      ops++;
+      elapsed = bench_now() - start;
+    }
+    bench_report(desc->name, "diff one change", (double) elapsed / ops / 1000.0, "us/op");
+
+    ini_destroy(b);
+    ini_destroy(a);
+    free(corpus);
+  }
+}
+
+void bench_ini_load_lazy(void) {
+  static const struct { const char* name; size_t size; } cases[] = {
+    { "1MB", 1u << 20 },
+    { "100MB", 100u << 20 },
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    const int sections = (int) (cases[i].size / 360) + 1;
+    corpus_desc desc = { cases[i].name, sections, 8, 8, 24, 4, 0 };
+    size_t len;
+    char* corpus = corpus_make(&desc, &len);
+    const int n = iterations_for(len);
+
+    /* tokenize everything, then read a single value */
+    uint64_t start = bench_now();
+    for (int j = 0; j < n; j++) {
+      ini_t* ini = ini_load_desc(&(ini_desc) { .data = corpus, .size = len });
+      bench_sink += (size_t) ini_value(ini, sections / 2, "key3");
+      ini_destroy(ini);
+    }
+    bench_report(cases[i].name, "eager load+lookup", (double) (bench_now() - start) / n / 1000.0, "us/load");
+
+    /* only the section that is read is tokenized */
+    start = bench_now();
+    for (int j = 0; j < n; j++) {
+      ini_t* ini = ini_load_desc(&(ini_desc) { .data = corpus, .size = len, .lazy = true });
+      bench_sink += (size_t) ini_value(ini, sections / 2, "key3");
+      ini_destroy(ini);
+    }
+    bench_report(cases[i].name, "lazy load+lookup", (double) (bench_now() - start) / n / 1000.0, "us/load");
+    free(corpus);
+  }
+}
+
+void bench_ini_load_file(void) {
+  static const struct { const char* name; size_t size; } cases[] = {
+    { "1KB", 1u << 10 },
+    { "1MB", 1u << 20 },
+    { "100MB", 100u << 20 },
+  };
+  char* cwd = (char*) fs_get_cwd();
+  fs_setup(&(fs_desc) { .write_dir = cwd, .base_paths = { cwd } });
+
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    /* sections of eight 40 byte properties and a comment */
+    const int sections = (int) (cases[i].size / 360) + 1;
+    corpus_desc desc = { cases[i].name, sections, 8, 8, 24, 4, 0 };
+    size_t len;
+    char* corpus = corpus_make(&desc, &len);
+    fs_write("bench.ini", &(fs_data) { .data = corpus, .size = len });
+    free(corpus);
+    const int n = iterations_for(len);
+
+    /* fs_read, copy into a null terminated string, then parse */
+    uint64_t start = bench_now();
+    bool failed = false;
+    for (int j = 0; j < n && !failed; j++) {
+      size_t size = 0;
+      void* data = fs_read("bench.ini", &size);
+      char* str = (data != NULL) ? (char*) malloc(size + 1) : NULL;
+      failed = (str == NULL);
+      if (!failed) {
+        memcpy(str, data, size);
+        str[size] = '\0';
+        ini_destroy(ini_load(str));
+        free(str);
+      }
+      fs_free(data);
+    }
+    if (failed) {
+      bench_report(cases[i].name, "skipped", 0.0, "fs_read failed");
+      continue;
+    }
+    bench_report(cases[i].name, "fs_read+ini_load", (double) (bench_now() - start) / n / 1000.0, "us/load");
+
+    start = bench_now();
+    for (int j = 0; j < n; j++) {
+      ini_t* ini = ini_load_file("bench.ini");
+      ini_destroy(ini);
+    }
+    bench_report(cases[i].name, "ini_load_file", (double) (bench_now() - start) / n / 1000.0, "us/load");
+  }
+
+  /* cleanup */
+  fs_delete("bench.ini");
+  fs_shutdown();
+}
+
+void bench_ini_shared(void) {
+  /* what each worker pays for a document: parsing its own copy, or
+     attaching to the image a publisher put in shared memory */
+  static const corpus_desc cases[] = {
+    { "10k properties", 100, 100, 12, 16, 0, 0 },
+    { "1M properties", 1024, 1024, 12, 16, 0, 0 },
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    const corpus_desc* desc = &cases[i];
+    size_t len;
+    char* corpus = corpus_make(desc, &len);
+    const int n = iterations_for(len);
+
+    size_t live = bench_live;
+    uint64_t start = bench_now();
+    ini_t* ini = ini_load(corpus);
+    bench_report(desc->name, "ini_load", (double) (bench_now() - start) / 1000000.0, "ms/worker");
+    bench_report(desc->name, "ini_load", (double) (bench_live - live) / (1 << 20), "MB/worker");
+
+    ini_shared_t* publisher = ini_shared_create("header-bench");
+    start = bench_now();
+    ini_shared_publish(publisher, ini);
+    bench_report(desc->name, "ini_shared_publish", (double) (bench_now() - start) / 1000000.0, "ms");
+    bench_report(desc->name, "ini_shared_publish", (double) ini_image_write(ini, NULL, 0) / (1 << 20), "MB shared");
+
+    live = bench_live;
+    start = bench_now();
+    for (int j = 0; j < n; j++) {
+      ini_shared_t* worker = ini_shared_open("header-bench");
+      bench_sink += ini_num_sections(ini_shared_get(worker));
+      ini_shared_close(worker);
+    }
+    bench_report(desc->name, "ini_shared_get", (double) (bench_now() - start) / n / 1000000.0, "ms/worker");
+    ini_shared_t* worker = ini_shared_open("header-bench");
+    bench_sink += ini_num_sections(ini_shared_get(worker));
+    bench_report(desc->name, "ini_shared_get", (double) (bench_live - live) / (1 << 20), "MB/worker");
+
+    enum { PROBES = 4096 };
+    static char keys[PROBES][32];
+    static int sections[PROBES];
+    uint64_t x = 88172645463325252ull;
+    for (int j = 0; j < PROBES; j++) {
+      x ^= x << 13, x ^= x >> 7, x ^= x << 17;
+      sections[j] = 1 + (int) (x % desc->sections);
+      corpus_key(keys[j], (int) ((x >> 32) % desc->keys), desc->key_len);
+    }
+    for (int view = 0; view < 2; view++) {
+      const ini_t* doc = view ? ini_shared_get(worker) : ini;
+      start = bench_now();
+      uint64_t elapsed = 0;
+      size_t ops = 0;
+      while (elapsed < 100000000u) {
+        for (int j = 0; j < PROBES; j++) {
+          bench_sink += ini_value_span(doc, sections[j], keys[j]).len;
+        }
+        ops += PROBES;
+        elapsed = bench_now() - start;
+      }
+      bench_report(desc->name, view ? "lookup shared" : "lookup private", (double) elapsed / ops, "ns/op");
+    }
+    ini_shared_close(worker);
+    ini_shared_close(publisher);
+    ini_destroy(ini);
+    free(corpus);
+  }
+}
+
+void bench_ini_editor(void) {
+  /* changing one value of a 10MB document: the editor patches it where the
+     alternative is writing the whole document again */
+  static const corpus_desc desc = { "10MB", 512, 512, 8, 16, 8, 0 };
+  char* cwd = (char*) fs_get_cwd();
+  fs_setup(&(fs_desc) { .write_dir = cwd, .base_paths = { cwd } });
+  size_t len;
+  char* corpus = corpus_make(&desc, &len);
+  char key[80];
+  corpus_key(key, desc.keys / 2, desc.key_len);
+  const int section = 1 + desc.sections / 2;
+
+  uint64_t start = bench_now();
+  ini_editor_t* editor = ini_editor_create(corpus, len);
+  bench_report(desc.name, "ini_editor_create", (double) (bench_now() - start) / 1000000.0, "ms");
+
+  start = bench_now();
+  ini_t* ini = ini_load(corpus);
+  bench_report(desc.name, "ini_load", (double) (bench_now() - start) / 1000000.0, "ms");
+
+  uint64_t elapsed = 0;
+  size_t ops = 0;
+  start = bench_now();
+  while (elapsed < 100000000u) {
+    ini_editor_set_value(editor, section, key, (ops & 1) ? "changed" : "edited");
+    ops++;
+    elapsed = bench_now() - start;
+  }
+  bench_report(desc.name, "ini_editor_set_value", (double) elapsed / ops / 1000.0, "us/op");
+
+  start = bench_now(), elapsed = 0, ops = 0;
+  while (elapsed < 100000000u) {
+    bench_sink += ini_editor_spans(editor, NULL, 0);
+    ops++;
+    elapsed = bench_now() - start;
+  }
+  bench_report(desc.name, "ini_editor_spans", (double) elapsed / ops / 1000.0, "us/op");
+
+  const int n = 8;
+  start = bench_now();
+  for (int j = 0; j < n; j++) {
+    ini_editor_write(editor, "bench.ini");
+  }
+  bench_report(desc.name, "ini_editor_write", (double) (bench_now() - start) / n / 1000000.0, "ms");
+
+  /* the same change made to a copy of the document, written whole */
+  start = bench_now();
+  for (int j = 0; j < n; j++) {
+    char* copy = (char*) malloc(len);
+    memcpy(copy, corpus, len);
+    fs_write("bench.ini", &(fs_data) { .data = copy, .size = len });
+    free(copy);
+  }
+  bench_report(desc.name, "copy+fs_write", (double) (bench_now() - start) / n / 1000000.0, "ms");
+
+  ini_destroy(ini);
+  ini_editor_destroy(editor);
+  free(corpus);
+
+  /* cleanup */
+  fs_delete("bench.ini");
+  fs_shutdown();
+}
+
+/* the checks of a schema made after loading, one lookup per rule */
+static size_t schema_check_after(const ini_t* ini, const ini_rule_t* rules, size_t n) {
+  size_t violations = 0;
+  int section = INI_NOT_FOUND;
+  const char* name = NULL;
+  for (size_t r = 0; r < n; r++) {
+    if (rules[r].section != name) {
+      name = rules[r].section;
+      section = (name != NULL) ? ini_find_section(ini, name) : INI_GLOBAL_SECTION;
+    }
+    const char* value = (section != INI_NOT_FOUND) ? ini_value(ini, section, rules[r].key) : NULL;
+    if (value == NULL) {
+      violations += rules[r].required ? 1 : 0;
+      continue;
+    }
+    char* end;
+    if (rules[r].type == INI_TYPE_INT) {
+      const long long v = strtoll(value, &end, 10);
+      violations += (*end != '\0' || v < rules[r].min || v > rules[r].max) ? 1 : 0;
+    } else if (rules[r].type == INI_TYPE_BOOL) {
+      violations += (strcmp(value, "true") != 0 && strcmp(value, "false") != 0) ? 1 : 0;
+    } else if (rules[r].type == INI_TYPE_ENUM) {
+      violations += (strcmp(value, "fast") != 0 && strcmp(value, "safe") != 0) ? 1 : 0;
+    }
+  }
+  return violations;
+}
+
+void bench_ini_schema(void) {
+  /* services of 4 checked keys and 12 others, with a rule for each
+     checked key of every service */
+  static const struct { const char* name; int sections; } cases[] = {
+    { "64 sections", 64 },
+    { "4096 sections", 4096 },
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    const int sections = cases[i].sections;
+    char* doc = (char*) malloc((size_t) sections * 512);
+    char (*names)[16] = (char (*)[16]) malloc((size_t) sections * 16);
+    ini_rule_t* rules = (ini_rule_t*) malloc((size_t) sections * 4 * sizeof(ini_rule_t));
+    size_t len = 0, num_rules = 0;
+    for (int s = 0; s < sections; s++) {
+      sprintf(names[s], "service%d", s);
+      len += sprintf(doc + len, "[%s]\nport = %d\nmode = fast\nenabled = true\nworkers = %d\n", names[s], 1024 + s, s % 64);
+      for (int k = 0; k < 12; k++) {
+        len += sprintf(doc + len, "option%d = value%d\n", k, k);
+      }
+      const ini_rule_t service[] = {
+        { names[s], "port", INI_TYPE_INT, true, 1, 65535, NULL },
+        { names[s], "mode", INI_TYPE_ENUM, true, 0, 0, "fast|safe" },
+        { names[s], "enabled", INI_TYPE_BOOL, false, 0, 0, NULL },
+        { names[s], "workers", INI_TYPE_INT, false, 0, 256, NULL },
+      };
+      memcpy(rules + num_rules, service, sizeof(service));
+      num_rules += 4;
+    }
+    const int n = iterations_for(len);
+
+    uint64_t start = bench_now();
+    for (int j = 0; j < n; j++) {
+      ini_t* ini = ini_load_desc(&(ini_desc) { .data = doc, .size = len });
+      bench_sink += schema_check_after(ini, rules, num_rules);
+      ini_destroy(ini);
+    }
+    bench_report(cases[i].name, "load, then check", (double) (bench_now() - start) / n / 1000.0, "us/load");
+
+    start = bench_now();
+    for (int j = 0; j < n; j++) {
+      ini_t* ini = ini_load_desc(&(ini_desc) { .data = doc, .size = len, .rules = rules, .num_rules = num_rules });
+      bench_sink += ini_num_violations(ini);
+      ini_destroy(ini);
+    }
+    bench_report(cases[i].name, "load with schema", (double) (bench_now() - start) / n / 1000.0, "us/load");
+
+    start = bench_now();
+    for (int j = 0; j < n; j++) {
+      ini_t* ini = ini_load_desc(&(ini_desc) { .data = doc, .size = len });
+      ini_destroy(ini);
+    }
+    bench_report(cases[i].name, "load only", (double) (bench_now() - start) / n / 1000.0, "us/load");
+
+    free(rules);
+    free(names);
+    free(doc);
+  }
+}
+
+void bench_ini_clone(void) {
+  const corpus_desc desc = { "1mb", 1024, 32, 8, 16, 0, 0 };
+  size_t len;
+  char* corpus = corpus_make(&desc, &len);
+  ini_t* ini = ini_load(corpus);
+  const int n = 2000;
+  char key[16];
+  corpus_key(key, 7, desc.key_len);
+
+  /* a private copy of the document, as a clone replaces */
+  bench_allocs = 0;
+  uint64_t start = bench_now();
+  for (int j = 0; j < 100; j++) {
+    ini_destroy(ini_load(corpus));
+  }
+  bench_report(desc.name, "ini_load", (double) (bench_now() - start) / 100 / 1000.0, "us/copy");
+  bench_report(desc.name, "ini_load", (double) bench_allocs / 100, "allocs/copy");
+
+  bench_allocs = 0;
+  start = bench_now();
+  for (int j = 0; j < n; j++) {
+    ini_destroy(ini_clone(ini));
+  }
+  bench_report(desc.name, "ini_clone", (double) (bench_now() - start) / n, "ns/clone");
+  bench_report(desc.name, "ini_clone", (double) bench_allocs / n, "allocs/clone");
+
+  /* the first write copies the tables and one section */
+  bench_allocs = 0;
+  const size_t live = bench_live;
+  bench_peak = live;
+  start = bench_now();
+  for (int j = 0; j < n; j++) {
+    ini_t* clone = ini_clone(ini);
+    ini_set_value(clone, 1 + j % desc.sections, key, "changed");
+    ini_destroy(clone);
+  }
+  bench_report(desc.name, "clone + first write", (double) (bench_now() - start) / n / 1000.0, "us/clone");
+  bench_report(desc.name, "clone + first write", (double) bench_allocs / n, "allocs/clone");
+  /* the clone's own slots are numbered after the shared ones, which are
+     allocated but never touched */
+  bench_report(desc.name, "clone + first write", (double) (bench_peak - live) / 1024.0, "KB allocated");
+
+  /* further writes only copy the sections they touch */
+  ini_t* clone = ini_clone(ini);
+  ini_set_value(clone, 1, key, "changed");
+  start = bench_now();
+  for (int j = 0; j < n; j++) {
+    ini_set_value(clone, 1 + j % desc.sections, key, "changed");
+  }
+  bench_report(desc.name, "ini_set_value on clone", (double) (bench_now() - start) / n, "ns/write");
+  bench_sink += (size_t) ini_value(clone, 1, key)[0];
+  ini_destroy(clone);
+
+  ini_destroy(ini);
+  free(corpus);
+}
+
+void bench_ini_duplicates(void) {
+  /* every key is written four times and every section twice */
+  enum { SECTIONS = 512, KEYS = 16, REPEATS = 4 };
+  char* corpus = (char*) malloc((size_t) SECTIONS * 2 * KEYS * REPEATS * 48 + 64);
+  size_t len = 0;
+  for (int r = 0; r < 2; r++) {
+    for (int s = 0; s < SECTIONS; s++) {
+      len += sprintf(corpus + len, "[section%d]\n", s);
+      for (int k = 0; k < KEYS * REPEATS; k++) {
+        len += corpus_key(corpus + len, k % KEYS, 8);
+        len += sprintf(corpus + len, " = value%d\n", r * KEYS * REPEATS + k);
+      }
+    }
+  }
+  const struct {
+    const char* name;
+    ini_duplicate_t keys;
+    ini_duplicate_t sections;
+  } policies[] = {
+    { "keep", INI_DUPLICATE_KEEP, INI_DUPLICATE_KEEP },
+    { "first", INI_DUPLICATE_FIRST, INI_DUPLICATE_FIRST },
+    { "last", INI_DUPLICATE_LAST, INI_DUPLICATE_LAST },
+    { "list", INI_DUPLICATE_LIST, INI_DUPLICATE_LIST },
+  };
+  enum { PROBES = 1024 };
+  static int sections[PROBES];
+  static char keys[PROBES][16];
+  for (int j = 0; j < PROBES; j++) {
+    sections[j] = 1 + (int) ((j * 7919u) % SECTIONS);
+    corpus_key(keys[j], (int) ((j * 104729u) % KEYS), 8);
+  }
+  for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+    const ini_desc desc = { .data = corpus, .size = len, .duplicate_keys = policies[i].keys, .duplicate_sections = policies[i].sections };
+    const int n = 20;
+    uint64_t start = bench_now();
+    for (int j = 0; j < n; j++) {
+      ini_destroy(ini_load_desc(&desc));
+    }
+    bench_report(policies[i].name, "ini_load_desc", (double) (bench_now() - start) / n / 1000.0, "us/load");
+
+    ini_t* ini = ini_load_desc(&desc);
+    bench_report(policies[i].name, "properties indexed", (double) corpus_properties(ini), "properties");
+    start = bench_now();
+    uint64_t elapsed = 0;
+    size_t ops = 0;
+    while (elapsed < 100000000u) {
+      for (int j = 0; j < PROBES; j++) {
+        bench_sink += (size_t) ini_value(ini, sections[j], keys[j]);
+      }
+      ops += PROBES;
+      elapsed = bench_now() - start;
+    }
+    bench_report(policies[i].name, "lookup hit", (double) elapsed / ops, "ns/op");
+    ini_destroy(ini);
+  }
+  free(corpus);
+}
+
+void bench_ini_version(void) {
+  const corpus_desc desc = { "1mb", 1024, 32, 8, 16, 0, 0 };
+  size_t len;
+  char* corpus = corpus_make(&desc, &len);
+  ini_t* ini = ini_load(corpus);
+  enum { VERSIONS = 100, PROBES = 1024 };
+  char key[16], section[24], value[24];
+  corpus_key(key, 7, desc.key_len);
+
+  /* 100 edits, each kept as a full copy of the document */
+  ini_t* copies[VERSIONS];
+  size_t live = bench_live;
+  bench_allocs = 0;
+  uint64_t start = bench_now();
+  for (int j = 0; j < VERSIONS; j++) {
+    copies[j] = ini_load(corpus);
+    sprintf(value, "v%d", j);
+    ini_set_value(copies[j], 1 + j % desc.sections, key, value);
+  }
+  bench_report(desc.name, "ini_load + write", (double) (bench_now() - start) / VERSIONS / 1000.0, "us/version");
+  bench_report(desc.name, "ini_load + write", (double) (bench_live - live) / VERSIONS / 1024.0, "KB/version");
+  for (int j = 0; j < VERSIONS; j++) {
+    ini_destroy(copies[j]);
+  }
+
+  /* the same edits, each on a clone of the original */
+  live = bench_live;
+  start = bench_now();
+  for (int j = 0; j < VERSIONS; j++) {
+    copies[j] = ini_clone(ini);
+    sprintf(value, "v%d", j);
+    ini_set_value(copies[j], 1 + j % desc.sections, key, value);
+  }
+  bench_report(desc.name, "ini_clone + write", (double) (bench_now() - start) / VERSIONS / 1000.0, "us/version");
+  bench_report(desc.name, "ini_clone + write", (double) (bench_live - live) / VERSIONS / 1024.0, "KB/version");
+  for (int j = 0; j < VERSIONS; j++) {
+    ini_destroy(copies[j]);
+  }
+
+  /* the same edits as a chain of versions, each sharing all but one path */
+  live = bench_live;
+  start = bench_now();
+  ini_version_t* versions[VERSIONS + 1];
+  versions[0] = ini_version_create(ini);
+  bench_report(desc.name, "ini_version_create", (double) (bench_now() - start) / 1000000.0, "ms");
+  bench_report(desc.name, "ini_version_create", (double) (bench_live - live) / 1024.0, "KB");
+  live = bench_live;
+  start = bench_now();
+  for (int j = 0; j < VERSIONS; j++) {
+    sprintf(section, "section%d", j % desc.sections);
+    sprintf(value, "v%d", j);
+    versions[j + 1] = ini_version_set(versions[j], section, key, value);
+  }
+  bench_report(desc.name, "ini_version_set", (double) (bench_now() - start) / VERSIONS / 1000.0, "us/version");
+  bench_report(desc.name, "ini_version_set", (double) (bench_live - live) / VERSIONS / 1024.0, "KB/version");
+
+  char sections[PROBES][24], keys[PROBES][16];
+  for (int j = 0; j < PROBES; j++) {
+    sprintf(sections[j], "section%d", (int) ((j * 7919u) % desc.sections));
+    corpus_key(keys[j], (int) ((j * 104729u) % desc.keys), desc.key_len);
+  }
+  const ini_version_t* last = versions[VERSIONS];
+  start = bench_now();
+  uint64_t elapsed = 0;
+  size_t ops = 0;
+  while (elapsed < 100000000u) {
+    for (int j = 0; j < PROBES; j++) {
+      bench_sink += (size_t) ini_version_value(last, sections[j], keys[j]);
+    }
+    ops += PROBES;
+    elapsed = bench_now() - start;
+  }
+  bench_report(desc.name, "ini_version_value", (double) elapsed / ops, "ns/op");
+
+  /* shared subtrees are skipped, so this only walks the edited paths */
+  const int n = 1000;
+  int changes = 0;
+  start = bench_now();
+  for (int j = 0; j < n; j++) {
+    changes += ini_version_diff(versions[0], last, NULL, NULL);
+  }
+  bench_report(desc.name, "ini_version_diff", (double) (bench_now() - start) / n / 1000.0, "us/diff");
+  bench_report(desc.name, "ini_version_diff", (double) changes / n, "changes");
+
+  for (int j = 0; j <= VERSIONS; j++) {
+    ini_version_destroy(versions[j]);
+  }
+  ini_destroy(ini);
+  free(corpus);
+}
+
+/* the value of a key as a wrapper reading APP__SECTION__KEY on every lookup would return it */
+static const char* env_wrapped_value(const ini_t* ini, int section, const char* section_name, const char* key) {
+  char name[96];
+  int n = snprintf(name, sizeof(name), "INI_BENCH__%s__%s", section_name, key);
+  for (int i = 0; i < n; i++) {
+    name[i] = (name[i] >= 'a' && name[i] <= 'z') ? name[i] - 'a' + 'A' : name[i];
+  }
+  const char* value = getenv(name);
+  return (value != NULL) ? value : ini_value(ini, section, key);
+}
+
+void bench_ini_apply_env(void) {
+  const corpus_desc desc = { "1mb", 1024, 32, 8, 16, 0, 0 };
+  size_t len;
+  char* corpus = corpus_make(&desc, &len);
+  enum { PROBES = 1024, OVERRIDES = 16 };
+  char name[96], key[16];
+  for (int j = 0; j < OVERRIDES; j++) {
+    corpus_key(key, j, desc.key_len);
+    sprintf(name, "INI_BENCH__SECTION%d__%s", j * 61, key);
+    setenv(name, "override", 1);
+  }
+  const ini_desc load = { .data = corpus, .size = len, .env_prefix = "INI_BENCH" };
+  ini_t* ini = ini_load_desc(&load);
+
+  int sections[PROBES];
+  char section_names[PROBES][24], keys[PROBES][16];
+  for (int j = 0; j < PROBES; j++) {
+    const int s = (int) ((j * 7919u) % desc.sections);
+    sections[j] = 1 + s;
+    sprintf(section_names[j], "section%d", s);
+    corpus_key(keys[j], (int) ((j * 104729u) % desc.keys), desc.key_len);
+  }
+
+  const char* names[] = { "getenv per lookup", "ini_value" };
+  for (int m = 0; m < 2; m++) {
+    uint64_t start = bench_now();
+    uint64_t elapsed = 0;
+    size_t ops = 0;
+    while (elapsed < 100000000u) {
+      for (int j = 0; j < PROBES; j++) {
+        bench_sink += (size_t) ((m == 0) ? env_wrapped_value(ini, sections[j], section_names[j], keys[j]) : ini_value(ini, sections[j], keys[j]));
+      }
+      ops += PROBES;
+      elapsed = bench_now() - start;
+    }
+    bench_report(desc.name, names[m], (double) elapsed / ops, "ns/op");
+  }
+
+  const int n = 1000;
+  uint64_t start = bench_now();
+  for (int j = 0; j < n; j++) {
+    bench_sink += ini_apply_env(ini, "INI_BENCH");
+  }
+  bench_report(desc.name, "ini_apply_env", (double) (bench_now() - start) / n / 1000.0, "us/refresh");
+  bench_report(desc.name, "ini_apply_env", (double) ini_apply_env(ini, "INI_BENCH"), "overrides");
+
+  for (int j = 0; j < OVERRIDES; j++) {
+    corpus_key(key, j, desc.key_len);
+    sprintf(name, "INI_BENCH__SECTION%d__%s", j * 61, key);
+    unsetenv(name);
+  }
+  ini_destroy(ini);
+  free(corpus);
+}
+
+/* a section of 64 keys every 1.5 KB, in a buffer of exactly `size` bytes */
+static char* scaling_make(size_t size) {
+  char* buf = (char*) malloc(size + 1);
+  if (buf == NULL) {
+    return NULL;
+  }
+  size_t pos = 0;
+  char line[48];
+  for (unsigned n = 0;; n++) {
+    const int len = (n % 64 == 0)
+      ? sprintf(line, "[s%u]\nk%u = %016x\n", n / 64, n % 64, n)
+      : sprintf(line, "k%u = %016x\n", n % 64, n);
+    if (pos + (size_t) len > size) {
+      break;
+    }
+    memcpy(buf + pos, line, (size_t) len);
+    pos += (size_t) len;
+  }
+  memset(buf + pos, '\n', size - pos);
+  buf[size] = '\0';
+  return buf;
+}
+
+void bench_ini_scaling(void) {
+  /* parse time and memory from 1 KB to 1 GB, against the targets
+     documented under LARGE DOCUMENTS */
+  static const struct { const char* name; size_t size; } tiers[] = {
+    { "1kb", (size_t) 1 << 10 },
+    { "16kb", (size_t) 16 << 10 },
+    { "256kb", (size_t) 256 << 10 },
+    { "4mb", (size_t) 4 << 20 },
+    { "64mb", (size_t) 64 << 20 },
+    { "1gb", (size_t) 1 << 30 },
+  };
+  for (size_t i = 0; i < sizeof(tiers) / sizeof(tiers[0]); i++) {
+    const size_t len = tiers[i].size;
+    char* corpus = scaling_make(len);
+    if (corpus == NULL) {
+      bench_report(tiers[i].name, "skipped", 0.0, "out of memory");
+      continue;
+    }
+    const ini_desc desc = { .data = corpus, .size = len };
+    const int n = (len < ((size_t) 64 << 20)) ? iterations_for(len) : 1;
+
+    bench_reset_peak_rss();
+    const int64_t rss = bench_peak_rss();
+    bench_live = bench_peak = 0;
+    uint64_t start = bench_now();
+    ini_t* ini = ini_load_desc(&desc);
+    uint64_t elapsed = bench_now() - start;
+    if (ini == NULL) {
+      bench_report(tiers[i].name, "skipped", 0.0, "out of memory");
+      free(corpus);
+      continue;
+    }
+    const int64_t peak_rss = bench_peak_rss();
+    const double properties = (double) corpus_properties(ini);
+    const size_t index = bench_live - ini->cap_buf;
+    const size_t peak = bench_peak - ini->cap_buf;
+    ini_destroy(ini);
+
+    for (int j = 1; j < n; j++) {
+      start = bench_now();
+      ini_destroy(ini_load_desc(&desc));
+      const uint64_t t = bench_now() - start;
+      elapsed = (t < elapsed) ? t : elapsed;
+    }
+    const double seconds = (double) elapsed / 1e9;
+
+    bench_report(tiers[i].name, "parse", (double) len / seconds / (1 << 20), "MB/s");
+    bench_report(tiers[i].name, "parse", seconds * 1e9 / properties, "ns/property");
+    bench_report(tiers[i].name, "index", (double) index / properties, "bytes/property");
+    bench_report(tiers[i].name, "index peak", (double) peak / properties, "bytes/property");
+    if (rss >= 0 && peak_rss >= 0) {
+      bench_report(tiers[i].name, "peak rss", (double) (peak_rss - rss) / (1 << 20), "MB");
+    }
+    free(corpus);
+  }
+}
@@ -1,9 +1,37 @@
 #define TEST_NO_MAIN
 #include "acutest.h"
 
+#include "filesystem.h"
+
+#include "alloc.h"
+
+#define INI_MALLOC(s) alloc_malloc(s)
+#define INI_FREE(p)   alloc_free(p)
+#define INI_STATS
 #define INI_IMPL
 #include "ini.h"
 
+#include <stdio.h>
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+/* sets an environment variable, or unsets it if `value` is NULL */
+static void test_setenv(const char* name, const char* value) {
+#if defined(_WIN32)
+  _putenv_s(name, (value != NULL) ? value : "");
+#else
+  if (value != NULL) {
+    setenv(name, value, 1);
+  } else {
+    unsetenv(name);
+  }
+#endif
+}
+
 const char* data_str = 
 "; global section\n"
 "network = wireless\n"
@@ -23,12 +51,685 @@ const char* data_str =
 "bool=true\n"
 "string=hello\n";
 
+void test_ini_load(void) {
+  alloc_stats_t stats;
+  alloc_begin();
+  ini_t* ini = ini_load(data_str);
+  alloc_end(&stats);
+
+  TEST_CASE("load into a fixed set of tables");
+  const size_t slot = sizeof(uint64_t) + sizeof(_ini_off_t) * 4 + sizeof(uint32_t);
+  const int64_t tables = (int64_t) (sizeof(ini_t) + ini->cap_buf + (size_t) ini->cap_slots * slot +
+    (size_t) ini->cap_sections * sizeof(_ini_section_t) + (ini->bloom_mask + 1) * sizeof(uint64_t) + ini->cap_names * sizeof(int));
+  TEST_CHECK(stats.allocs == 6);
+  TEST_CHECK(stats.bytes == tables && stats.peak == tables);
+  TEST_MSG("Allocations: %d, peak: %d bytes of %d", (int) stats.allocs, (int) stats.peak, (int) tables);
+  TEST_CHECK(ini->cap_buf == strlen(data_str) + 1);
+
+  TEST_CASE("destroy frees everything");
+  alloc_begin();
+  ini_destroy(ini);
+  alloc_end(&stats);
+  TEST_CHECK(stats.frees == 6 && stats.bytes == -tables);
+}
+
+/* a document of `sections` sections of `keys` properties, with 16 character values */
+static char* scaling_make(int sections, int keys, size_t* len) {
+  char* buf = (char*) malloc((size_t) sections * ((size_t) keys * 40 + 24) + 1);
+  size_t pos = 0;
+  for (int s = 0; s < sections; s++) {
+    pos += sprintf(buf + pos, "[s%d]\n", s);
+    for (int k = 0; k < keys; k++) {
+      pos += sprintf(buf + pos, "k%d = %016x\n", k, (unsigned) (s * keys + k));
+    }
+  }
+  *len = pos;
+  return buf;
+}
+
+void test_ini_scaling(void) {
+  /* bytes of index per property with full slots, and at the peak of the
+     load, the targets documented under LARGE DOCUMENTS */
+#if defined(INI_64BIT_OFFSETS)
+  const double target = 52.0, peak_target = 72.0;
+#else
+  const double target = 36.0, peak_target = 48.0;
+#endif
+  char key[16], value[32];
+  for (int sections = 32; sections <= 8192; sections *= 16) {
+    size_t len;
+    char* data = scaling_make(sections, 64, &len);
+    alloc_stats_t stats;
+    alloc_begin();
+    ini_t* ini = ini_load_desc(&(ini_desc) { .data = data, .size = len });
+    alloc_end(&stats);
+
+    TEST_CASE_("%d KB document", (int) (len >> 10));
+    const size_t properties = (size_t) sections * 64;
+    TEST_CHECK(ini != NULL && ini_num_sections(ini) == (size_t) sections);
+    bool found = true;
+    for (int s = 0; s < sections; s += sections / 16) {
+      const int k = (s * 7) % 64;
+      sprintf(key, "k%d", k);
+      sprintf(value, "%016x", (unsigned) (s * 64 + k));
+      const char* v = ini_value(ini, s + 1, key);
+      found = found && ini_num_properties(ini, s + 1) == 64 && v != NULL && strcmp(v, value) == 0;
+    }
+    TEST_CHECK(found);
+
+    const double index = (double) (stats.bytes - (int64_t) ini->cap_buf) / properties;
+    const double peak = (double) (stats.peak - (int64_t) ini->cap_buf) / properties;
+    if (len >= 64 * 1024) {
+      TEST_CHECK(index < target);
+      TEST_CHECK(peak < peak_target);
+    }
+    TEST_MSG("%d properties, %.2f bytes of index per property, %.2f at the peak", (int) properties, index, peak);
+    ini_destroy(ini);
+    free(data);
+  }
+
+  TEST_CASE("a section of 128k properties");
+  size_t len;
+  char* data = scaling_make(1, 1 << 17, &len);
+  ini_t* ini = ini_load_desc(&(ini_desc) { .data = data, .size = len });
+  TEST_CHECK(ini_num_properties(ini, 1) == (1 << 17));
+  TEST_CHECK(strcmp(ini_value(ini, 1, "k0"), "0000000000000000") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, 1, "k131071"), "000000000001ffff") == 0);
+  TEST_CHECK(ini_value(ini, 1, "k131072") == NULL);
+  ini_destroy(ini);
+  free(data);
+
+  TEST_CASE("64k sections");
+  data = scaling_make(1 << 16, 2, &len);
+  ini = ini_load_desc(&(ini_desc) { .data = data, .size = len });
+  TEST_CHECK(ini_num_sections(ini) == (1 << 16));
+  TEST_CHECK(ini_find_section(ini, "s65535") == (1 << 16));
+  TEST_CHECK(strcmp(ini_value(ini, 1 << 16, "k1"), "000000000001ffff") == 0);
+  TEST_CHECK(ini_find_section(ini, "s65536") == INI_NOT_FOUND);
+  ini_destroy(ini);
+  free(data);
+}
+
+void test_ini_load_file(void) {
+  /* setup filesystem */
+  char* cwd = (char*) fs_get_cwd();
+  fs_setup(&(fs_desc) { .write_dir = cwd, .base_paths = { cwd } });
+
+  TEST_CASE("load file that doesn't exist");
+  TEST_CHECK(ini_load_file("not_a_file.ini") == NULL);
+
+  TEST_CASE("load file that does exist");
+  fs_write("is_a_file.ini", FS_DATA_STR_REF(data_str));
+  ini_t* ini = ini_load_file("is_a_file.ini");
+  if (TEST_CHECK(ini != NULL)) {
+    int database_id = ini_find_section(ini, "database");
+    TEST_CHECK(strcmp(ini_value(ini, INI_GLOBAL_SECTION, "network"), "wireless") == 0);
+    TEST_CHECK(strcmp(ini_value(ini, database_id, "file"), "payroll.dat") == 0);
+    TEST_CHECK(strcmp(ini_value(ini, ini_find_section(ini, "variables"), "string"), "hello") == 0);
+    ini_destroy(ini);
+  }
+
+  TEST_CASE("load file without a trailing newline");
+  const char* str = "[owner]\nname = John Doe";
+  fs_write("is_a_file.ini", FS_DATA_STR_REF(str));
+  ini = ini_load_file("is_a_file.ini");
+  if (TEST_CHECK(ini != NULL)) {
+    TEST_CHECK(strcmp(ini_value(ini, 1, "name"), "John Doe") == 0);
+    ini_destroy(ini);
+  }
+
+  /* cleanup */
+  fs_delete("is_a_file.ini");
+}
+
+#if !defined(_WIN32)
+static void* lazy_reader(void* arg) {
+  ini_t* ini = (ini_t*) arg;
+  intptr_t ok = 1;
+  for (int i = 0; i < 64; i++) {
+    ok &= (strcmp(ini_value(ini, 2, "port"), "143") == 0);
+    ok &= (strcmp(ini_value(ini, 3, "string"), "hello") == 0);
+  }
+  return (void*) ok;
+}
+#endif
+
+void test_ini_load_desc(void) {
+  TEST_CASE("load sized data");
+  ini_t* ini = ini_load_desc(&(ini_desc) { .data = "a = 1\nb = 2\n", .size = 6 });
+  TEST_CHECK(strcmp(ini_value(ini, INI_GLOBAL_SECTION, "a"), "1") == 0);
+  TEST_CHECK(ini_property_exists(ini, INI_GLOBAL_SECTION, "b") == false);
+  ini_destroy(ini);
+
+  TEST_CASE("lazy load tokenizes sections on lookup");
+  ini = ini_load_desc(&(ini_desc) { .data = data_str, .lazy = true });
+  ini_stats_t stats;
+  ini_get_stats(ini, &stats);
+  TEST_CHECK(stats.sections == 3);
+  TEST_CHECK(stats.properties == 0);
+  int database_id = ini_find_section(ini, "database");
+  TEST_CHECK(database_id == 2);
+  TEST_CHECK(strcmp(ini_value(ini, database_id, "port"), "143") == 0);
+  ini_get_stats(ini, &stats);
+  TEST_CHECK(stats.properties == 3);
+  TEST_CHECK(strcmp(ini_value(ini, INI_GLOBAL_SECTION, "network"), "wireless") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, 1, "organization"), "Acme Widgets Inc.") == 0);
+  TEST_CHECK(ini_value_as_int(ini, 3, "int") == 1234);
+  TEST_CHECK(ini_value(ini, 4, "int") == NULL);
+  ini_destroy(ini);
+
+  TEST_CASE("lazy load with edits");
+  ini = ini_load_desc(&(ini_desc) { .data = data_str, .lazy = true });
+  TEST_CHECK(ini_set_value(ini, 1, "email", "john@example.com"));
+  TEST_CHECK(ini_set_value(ini, 1, "title", "owner"));
+  TEST_CHECK(strcmp(ini_value(ini, 1, "name"), "John Doe") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, 1, "title"), "owner") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, 2, "file"), "payroll.dat") == 0);
+  ini_destroy(ini);
+
+  TEST_CASE("lines that end with \r\n");
+  const char* crlf = "\xEF\xBB\xBFnetwork = wireless\r\n\r\n[database]\r\nserver = 192.0.2.62 ; primary\r\nfile = \"payroll.dat\"\r\nport = 143\r";
+  for (int lazy = 0; lazy < 2; lazy++) {
+    ini = ini_load_desc(&(ini_desc) { .data = crlf, .lazy = (lazy == 1) });
+    TEST_CHECK(ini_num_sections(ini) == 1);
+    TEST_CHECK(strcmp(ini_value(ini, INI_GLOBAL_SECTION, "network"), "wireless") == 0);
+    TEST_CHECK(strcmp(ini_value(ini, 1, "server"), "192.0.2.62") == 0);
+    TEST_CHECK(strcmp(ini_value(ini, 1, "file"), "payroll.dat") == 0);
+    TEST_CHECK(strcmp(ini_value(ini, 1, "port"), "143") == 0);
+    TEST_CHECK(ini_num_properties(ini, 1) == 3);
+    ini_destroy(ini);
+  }
+
+  TEST_CASE("byte order mark");
+  ini = ini_load("\xEF\xBB\xBF[owner]\nname = John Doe\n");
+  TEST_CHECK(ini_find_section(ini, "owner") == 1);
+  TEST_CHECK(ini_num_properties(ini, INI_GLOBAL_SECTION) == 0);
+  ini_destroy(ini);
+
+  TEST_CASE("valid UTF-8");
+  const char* utf8 = "name = J\xC3\xBCrgen \xE2\x82\xAC \xF0\x9F\x98\x80\n[\xE6\x97\xA5\xE6\x9C\xAC]\nkey = value\n";
+  for (int lazy = 0; lazy < 2; lazy++) {
+    ini = ini_load_desc(&(ini_desc) { .data = utf8, .utf8 = true, .lazy = (lazy == 1) });
+    if (TEST_CHECK(ini != NULL)) {
+      TEST_CHECK(strcmp(ini_value(ini, INI_GLOBAL_SECTION, "name"), "J\xC3\xBCrgen \xE2\x82\xAC \xF0\x9F\x98\x80") == 0);
+      TEST_CHECK(ini_find_section(ini, "\xE6\x97\xA5\xE6\x9C\xAC") == 1);
+      ini_destroy(ini);
+    }
+  }
+
+  TEST_CASE("invalid UTF-8");
+  static const char* invalid[] = {
+    "a = \x80\n",                         /* continuation without a lead */
+    "a = \xC0\xAF\n",                     /* overlong */
+    "a = \xE0\x80\xAF\n",                 /* overlong */
+    "a = \xED\xA0\x80\n",                 /* surrogate */
+    "a = \xF4\x90\x80\x80\n",             /* above U+10FFFF */
+    "a = 1\n[b]\nc = 12345678\xE2\x82\n", /* truncated */
+    "a = 1\n[b]\nc = \xFF\n",
+  };
+  for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+    TEST_CHECK(ini_load_desc(&(ini_desc) { .data = invalid[i], .utf8 = true }) == NULL);
+    TEST_CHECK(ini_load_desc(&(ini_desc) { .data = invalid[i], .utf8 = true, .lazy = true }) == NULL);
+    ini = ini_load_desc(&(ini_desc) { .data = invalid[i] });
+    TEST_CHECK(ini != NULL);
+    ini_destroy(ini);
+  }
+
+  TEST_CASE("repeated keys and sections");
+  const char* repeated =
+    "a = 1\n"
+    "[s]\n"
+    "x = 1\n"
+    "y = 2\n"
+    "x = 3\n"
+    "[t]\n"
+    "z = 4\n"
+    "[s]\n"
+    "x = 5\n"
+    "w = 6\n";
+  ini = ini_load(repeated);
+  TEST_CHECK(ini_num_sections(ini) == 3);
+  TEST_CHECK(ini_num_properties(ini, 1) == 3);
+  TEST_CHECK(strcmp(ini_value(ini, ini_find_section(ini, "s"), "x"), "1") == 0);
+  ini_destroy(ini);
+
+  ini = ini_load_desc(&(ini_desc) { .data = repeated, .duplicate_keys = INI_DUPLICATE_FIRST });
+  TEST_CHECK(ini_num_properties(ini, 1) == 2);
+  TEST_CHECK(strcmp(ini_value(ini, 1, "x"), "1") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, 3, "x"), "5") == 0);
+  ini_destroy(ini);
+
+  ini = ini_load_desc(&(ini_desc) { .data = repeated, .duplicate_keys = INI_DUPLICATE_LAST, .duplicate_sections = INI_DUPLICATE_LIST });
+  TEST_CHECK(ini_num_sections(ini) == 2);
+  TEST_CHECK(ini_find_section(ini, "t") == 2);
+  TEST_CHECK(ini_num_properties(ini, 1) == 3);
+  TEST_CHECK(strcmp(ini_value(ini, 1, "x"), "5") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, 1, "y"), "2") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, 1, "w"), "6") == 0);
+  ini_t* expected = ini_load("a = 1\n[s]\nx = 5\ny = 2\nw = 6\n[t]\nz = 4\n");
+  TEST_CHECK(ini_hash_equal(ini_fingerprint(ini), ini_fingerprint(expected)));
+  ini_destroy(expected);
+  ini_destroy(ini);
+
+  ini = ini_load_desc(&(ini_desc) { .data = repeated, .duplicate_keys = INI_DUPLICATE_LIST, .duplicate_sections = INI_DUPLICATE_LIST });
+  TEST_CHECK(strcmp(ini_value(ini, 1, "x"), "1, 3, 5") == 0);
+  int64_t items[4];
+  TEST_CHECK(ini_value_as_int_array(ini, 1, "x", items, 4) == 3);
+  TEST_CHECK(items[0] == 1 && items[1] == 3 && items[2] == 5);
+  ini_destroy(ini);
+
+  ini = ini_load_desc(&(ini_desc) { .data = repeated, .duplicate_sections = INI_DUPLICATE_FIRST });
+  TEST_CHECK(ini_num_sections(ini) == 2);
+  TEST_CHECK(ini_value(ini, 1, "w") == NULL);
+  TEST_CHECK(strcmp(ini_value(ini, 2, "z"), "4") == 0);
+  ini_destroy(ini);
+
+  ini = ini_load_desc(&(ini_desc) { .data = repeated, .duplicate_sections = INI_DUPLICATE_LAST });
+  TEST_CHECK(ini_num_sections(ini) == 2);
+  TEST_CHECK(ini_num_properties(ini, 1) == 2);
+  TEST_CHECK(ini_value(ini, 1, "y") == NULL);
+  TEST_CHECK(strcmp(ini_value(ini, 1, "x"), "5") == 0);
+  ini_destroy(ini);
+
+  TEST_CHECK(ini_load_desc(&(ini_desc) { .data = repeated, .duplicate_keys = INI_DUPLICATE_ERROR }) == NULL);
+  TEST_CHECK(ini_load_desc(&(ini_desc) { .data = repeated, .duplicate_sections = INI_DUPLICATE_ERROR }) == NULL);
+  ini = ini_load_desc(&(ini_desc) { .data = data_str, .lazy = true,
+    .duplicate_keys = INI_DUPLICATE_ERROR, .duplicate_sections = INI_DUPLICATE_ERROR });
+  TEST_CHECK(ini != NULL);
+  ini_destroy(ini);
+
+#if !defined(_WIN32)
+  TEST_CASE("lazy load read from multiple threads");
+  ini = ini_load_desc(&(ini_desc) { .data = data_str, .lazy = true });
+  pthread_t threads[8];
+  for (int i = 0; i < 8; i++) {
+    pthread_create(&threads[i], NULL, lazy_reader, ini);
+  }
+  for (int i = 0; i < 8; i++) {
+    void* ok;
+    pthread_join(threads[i], &ok);
+    TEST_CHECK(ok == (void*) 1);
+  }
+  ini_destroy(ini);
+#endif
+}
+
+void test_ini_load_into(void) {
+  const size_t len = strlen(data_str);
+
+  TEST_CASE("load into a new document");
+  ini_t* ini = ini_load_into(NULL, data_str, len);
+  TEST_CHECK(strcmp(ini_value(ini, INI_GLOBAL_SECTION, "network"), "wireless") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, ini_find_section(ini, "database"), "port"), "143") == 0);
+
+  TEST_CASE("reload without allocations");
+  ini_span_t key, value;
+  ini_set_value(ini, 1, "email", "john@example.com");
+  ini = ini_load_into(ini, data_str, len);
+  TEST_CHECK(ini_value(ini, 1, "email") == NULL);
+  ini_set_value(ini, 1, "email", "john@example.com");
+  ini_keys_t keys = ini_keys_with_prefix(ini, 1, "");
+  while (ini_keys_next(&keys, &key, &value)) {}
+  keys = ini_keys_matching(ini, 3, "*");
+  while (ini_keys_next(&keys, &key, &value)) {}
+  alloc_stats_t stats;
+  alloc_begin();
+  for (int i = 0; i < 100; i++) {
+    ini = ini_load_into(ini, data_str, len);
+    ini_set_value(ini, 1, "email", "john@example.com");
+    TEST_CHECK_(strcmp(ini_value(ini, 3, "string"), "hello") == 0, "reload %d", i);
+    /* the sort buffers of key queries are kept across reloads */
+    size_t n = 0;
+    keys = ini_keys_with_prefix(ini, 1, "");
+    while (ini_keys_next(&keys, &key, &value)) {
+      n++;
+    }
+    keys = ini_keys_matching(ini, 3, "*");
+    while (ini_keys_next(&keys, &key, &value)) {
+      n++;
+    }
+    TEST_CHECK_(n == 3 + 4, "keys %d", i);
+  }
+  alloc_end(&stats);
+  TEST_CHECK(stats.allocs == 0);
+  TEST_MSG("Allocations: %d", (int) stats.allocs);
+
+  TEST_CASE("reload a larger document");
+  char* larger = (char*) malloc(len * 2 + 32);
+  sprintf(larger, "%s[more]\n%s", data_str, data_str);
+  ini = ini_load_into(ini, larger, strlen(larger));
+  TEST_CHECK(strcmp(ini_value(ini, ini_find_section(ini, "more"), "network"), "wireless") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, 3, "string"), "hello") == 0);
+  TEST_CHECK(ini_find_section(ini, "database") == 2);
+  free(larger);
+
+  TEST_CASE("reload a smaller document");
+  ini = ini_load_into(ini, "a = 1\n", 6);
+  TEST_CHECK(strcmp(ini_value(ini, INI_GLOBAL_SECTION, "a"), "1") == 0);
+  TEST_CHECK(ini_section_exists(ini, "database") == false);
+
+  ini_destroy(ini);
+}
+
+void test_ini_reset(void) {
+  ini_t* ini = ini_load(data_str);
+  ini_interpolate(ini);
+  ini_reset(ini);
+
+  TEST_CASE("empty after reset");
+  TEST_CHECK(ini_section_exists(ini, "owner") == false);
+  TEST_CHECK(ini_value(ini, INI_GLOBAL_SECTION, "network") == NULL);
+  TEST_CHECK(ini_set_value(ini, 1, "name", "John Doe") == false);
+
+  TEST_CASE("usable after reset");
+  TEST_CHECK(ini_set_value(ini, INI_GLOBAL_SECTION, "network", "wired"));
+  TEST_CHECK(strcmp(ini_value(ini, INI_GLOBAL_SECTION, "network"), "wired") == 0);
+  ini_stats_t stats;
+  ini_get_stats(ini, &stats);
+  TEST_CHECK(stats.properties == 0);
+
+  ini_destroy(ini);
+}
+
+void test_ini_clone(void) {
+  ini_t* ini = ini_load(data_str);
+
+  TEST_CASE("clone without allocating the index");
+  alloc_stats_t stats;
+  alloc_begin();
+  ini_t* clone = ini_clone(ini);
+  alloc_end(&stats);
+  TEST_CHECK(stats.allocs == 1 && stats.bytes == (int64_t) sizeof(ini_t));
+  TEST_CHECK(ini_num_sections(clone) == ini_num_sections(ini));
+  TEST_CHECK(ini_find_section(clone, "database") == 2);
+  TEST_CHECK(strcmp(ini_value(clone, 2, "server"), "192.0.2.62") == 0);
+  TEST_CHECK(ini_value(clone, 2, "nope") == NULL);
+  TEST_CHECK(ini_hash_equal(ini_fingerprint(clone), ini_fingerprint(ini)));
+
+  TEST_CASE("writes to a clone are its own");
+  TEST_CHECK(ini_set_value(clone, 2, "port", "144"));
+  TEST_CHECK(ini_set_value(clone, 2, "user", "admin"));
+  TEST_CHECK(ini_set_value(clone, INI_GLOBAL_SECTION, "mode", "fast"));
+  TEST_CHECK(strcmp(ini_value(clone, 2, "port"), "144") == 0);
+  TEST_CHECK(strcmp(ini_value(clone, 2, "user"), "admin") == 0);
+  TEST_CHECK(strcmp(ini_value(clone, 2, "server"), "192.0.2.62") == 0);
+  TEST_CHECK(strcmp(ini_value(clone, 1, "name"), "John Doe") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, 2, "port"), "143") == 0);
+  TEST_CHECK(ini_value(ini, 2, "user") == NULL);
+  TEST_CHECK(ini_property_exists(ini, INI_GLOBAL_SECTION, "mode") == false);
+  TEST_CHECK(ini_property_exists(clone, INI_GLOBAL_SECTION, "mode"));
+  TEST_CHECK(ini_diff(ini, clone, NULL, NULL) == 3);
+
+  TEST_CASE("key queries see the writes");
+  ini_span_t key, value;
+  ini_keys_t keys = ini_keys_with_prefix(clone, 2, "");
+  size_t count = 0;
+  while (ini_keys_next(&keys, &key, &value)) {
+    count++;
+  }
+  TEST_CHECK(count == 4);
+  TEST_CHECK(ini_num_properties(ini, 2) == 3);
+
+  TEST_CASE("clone of a clone");
+  ini_t* second = ini_clone(clone);
+  ini_set_value(second, 3, "int", "5678");
+  TEST_CHECK(ini_value_as_int(second, 3, "int") == 5678);
+  TEST_CHECK(ini_value_as_int(clone, 3, "int") == 1234);
+  TEST_CHECK(strcmp(ini_value(second, 2, "user"), "admin") == 0);
+  TEST_CHECK(ini_diff(clone, second, NULL, NULL) == 1);
+
+  TEST_CASE("destroy the original first");
+  ini_destroy(ini);
+  ini_destroy(clone);
+  TEST_CHECK(strcmp(ini_value(second, 2, "port"), "144") == 0);
+  TEST_CHECK(strcmp(ini_value(second, 1, "organization"), "Acme Widgets Inc.") == 0);
+  ini_destroy(second);
+
+  TEST_CASE("clone of a lazy document");
+  ini = ini_load_desc(&(ini_desc) { .data = data_str, .lazy = true });
+  clone = ini_clone(ini);
+  TEST_CHECK(strcmp(ini_value(clone, 3, "string"), "hello") == 0);
+  ini_set_value(clone, 3, "string", "world");
+  TEST_CHECK(strcmp(ini_value(ini, 3, "string"), "hello") == 0);
+  TEST_CHECK(strcmp(ini_value(clone, 3, "string"), "world") == 0);
+  ini_destroy(clone);
+  ini_destroy(ini);
+
+  TEST_CASE("clone of an interpolated document");
+  ini = ini_load("base = /usr\n[paths]\nbin = ${:base}/bin\n");
+  ini_interpolate(ini);
+  clone = ini_clone(ini);
+  ini_set_value(clone, INI_GLOBAL_SECTION, "base", "/opt");
+  TEST_CHECK(strcmp(ini_value(clone, 1, "bin"), "/opt/bin") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, 1, "bin"), "/usr/bin") == 0);
+  ini_destroy(clone);
+  ini_destroy(ini);
+}
+
+static void violation_collect(const ini_rule_t* rule, ini_violation_t violation, size_t line, const char* value, void* user) {
+  char* out = (char*) user;
+  static const char* names[] = { "type", "range", "choice", "missing" };
+  sprintf(out + strlen(out), "%s.%s:%s@%zu=%s;", (rule->section != NULL) ? rule->section : "", rule->key, names[violation], line, (value != NULL) ? value : "-");
+}
+
+void test_ini_num_violations(void) {
+  static const ini_rule_t rules[] = {
+    { NULL, "network", INI_TYPE_ENUM, true, 0, 0, "wired|wireless" },
+    { "database", "port", INI_TYPE_INT, true, 1, 65535, NULL },
+    { "database", "server", INI_TYPE_STRING, true, 0, 0, NULL },
+    { "variables", "int", INI_TYPE_INT, false, 0, 0, NULL },
+    { "variables", "float", INI_TYPE_FLOAT, false, 0, 100, NULL },
+    { "variables", "bool", INI_TYPE_BOOL, false, 0, 0, NULL },
+    { "variables", "string", INI_TYPE_INT, false, 0, 0, NULL },
+    { "owner", "email", INI_TYPE_STRING, true, 0, 0, NULL },
+    { "cache", "size", INI_TYPE_INT, false, 0, 0, NULL },
+  };
+  char out[512] = { 0 };
+
+  TEST_CASE("a document without a schema");
+  ini_t* ini = ini_load(data_str);
+  TEST_CHECK(ini_num_violations(ini) == 0);
+  ini_destroy(ini);
+
+  TEST_CASE("values are checked while parsing");
+  ini = ini_load_desc(&(ini_desc) {
+    .data = data_str,
+    .rules = rules,
+    .num_rules = sizeof(rules) / sizeof(rules[0]),
+    .violation = violation_collect,
+    .user = out,
+  });
+  TEST_CHECK(ini_num_violations(ini) == 2);
+  TEST_CHECK(strcmp(out, "variables.string:type@17=hello;owner.email:missing@0=-;") == 0);
+  TEST_MSG("Produced: %s", out);
+  TEST_CHECK(strcmp(ini_value(ini, 2, "port"), "143") == 0);
+  ini_destroy(ini);
+
+  TEST_CASE("types, ranges and choices");
+  out[0] = '\0';
+  ini = ini_load_desc(&(ini_desc) {
+    .data =
+      "network = dialup\n"
+      "[database]\n"
+      "; out of range\n"
+      "port = 70000\n"
+      "[variables]\n"
+      "int = 12a\n"
+      "float = 120.5\n"
+      "bool = yes\n",
+    .rules = rules,
+    .num_rules = sizeof(rules) / sizeof(rules[0]),
+    .violation = violation_collect,
+    .user = out,
+    .lazy = true,
+  });
+  TEST_CHECK(ini_num_violations(ini) == 7);
+  TEST_CHECK(strcmp(out,
+    ".network:choice@1=dialup;"
+    "database.port:range@4=70000;"
+    "variables.int:type@6=12a;"
+    "variables.float:range@7=120.5;"
+    "variables.bool:type@8=yes;"
+    "database.server:missing@0=-;"
+    "owner.email:missing@0=-;") == 0);
+  TEST_MSG("Produced: %s", out);
+
+  TEST_CASE("reset clears the violations");
+  ini_reset(ini);
+  TEST_CHECK(ini_num_violations(ini) == 0);
+  ini_destroy(ini);
+
+  static const ini_rule_t port[] = {
+    { "db", "port", INI_TYPE_INT, true, 0, 0, NULL },
+  };
+  static const ini_duplicate_t policies[] = { INI_DUPLICATE_FIRST, INI_DUPLICATE_LAST };
+  static const char* const sources[] = { "[db]\nport = 80\nport = abc\n", "[db]\nport = abc\nport = 80\n" };
+  for (int p = 0; p < 2; p++) {
+    TEST_CASE("only the values a policy keeps are checked");
+    for (int d = 0; d < 2; d++) {
+      out[0] = '\0';
+      ini = ini_load_desc(&(ini_desc) {
+        .data = sources[d],
+        .rules = port,
+        .num_rules = 1,
+        .violation = violation_collect,
+        .user = out,
+        .duplicate_keys = policies[p],
+      });
+      const bool kept_abc = (p == 0) ? (d == 1) : (d == 0);
+      TEST_CHECK(strcmp(ini_value(ini, 1, "port"), kept_abc ? "abc" : "80") == 0);
+      TEST_CHECK(ini_num_violations(ini) == (kept_abc ? 1u : 0u));
+      TEST_CHECK(strcmp(out, !kept_abc ? "" : (d == 0) ? "db.port:type@3=abc;" : "db.port:type@2=abc;") == 0);
+      TEST_MSG("Produced: %s", out);
+      ini_destroy(ini);
+    }
+  }
+
+  TEST_CASE("a section that replaces another is checked as kept");
+  out[0] = '\0';
+  ini = ini_load_desc(&(ini_desc) {
+    .data = "[db]\nport = abc\n[db]\nname = x\n",
+    .rules = port,
+    .num_rules = 1,
+    .violation = violation_collect,
+    .user = out,
+    .duplicate_sections = INI_DUPLICATE_LAST,
+  });
+  TEST_CHECK(ini_num_violations(ini) == 1);
+  TEST_CHECK(strcmp(out, "db.port:missing@0=-;") == 0);
+  TEST_MSG("Produced: %s", out);
+  ini_destroy(ini);
+}
+
+void test_ini_num_sections(void) {
+  ini_t* ini = ini_load(data_str);
+  TEST_CHECK(ini_num_sections(ini) == 3);
+  ini_destroy(ini);
+
+  ini = ini_load("a = 1\n");
+  TEST_CHECK(ini_num_sections(ini) == 0);
+  ini_destroy(ini);
+}
+
+void test_ini_num_properties(void) {
+  ini_t* ini = ini_load_desc(&(ini_desc) { .data = data_str, .lazy = true });
+  TEST_CHECK(ini_num_properties(ini, INI_GLOBAL_SECTION) == 1);
+  TEST_CHECK(ini_num_properties(ini, 1) == 2);
+  TEST_CHECK(ini_num_properties(ini, 2) == 3);
+  TEST_CHECK(ini_num_properties(ini, 3) == 4);
+  TEST_CHECK(ini_num_properties(ini, 4) == 0);
+  ini_set_value(ini, 1, "email", "john@example.com");
+  TEST_CHECK(ini_num_properties(ini, 1) == 3);
+  ini_destroy(ini);
+}
+
 void test_ini_find_section(void) {
   ini_t* ini = ini_load(data_str);
 
   TEST_CHECK(ini_find_section(ini, "owner") == 1);
   TEST_CHECK(ini_find_section(ini, "database") == 2);
   TEST_CHECK(ini_find_section(ini, "nope") == -1);
+  ini_destroy(ini);
+}
+
+const char* nested_str =
+"[server]\n"
+"name = web01\n"
+"[server.http.tls]\n"
+"port = 443\n"
+"[client]\n"
+"[server.http]\n"
+"port = 80\n"
+"[server.https]\n"
+"[server.http.gzip]\n";
+
+void test_ini_find_section_path(void) {
+  ini_t* ini = ini_load(nested_str);
+
+  TEST_CASE("paths of nested sections");
+  TEST_CHECK(ini_find_section_path(ini, "server") == 1);
+  TEST_CHECK(ini_find_section_path(ini, "server.http") == 4);
+  TEST_CHECK(ini_find_section_path(ini, "server.http.tls") == 2);
+  TEST_CHECK(ini_find_section_path(ini, "server.https") == 5);
+  TEST_CHECK(ini_find_section_path(ini, "client") == 3);
+
+  TEST_CASE("paths that don't exist");
+  TEST_CHECK(ini_find_section_path(ini, "") == -1);
+  TEST_CHECK(ini_find_section_path(ini, "serv") == -1);
+  TEST_CHECK(ini_find_section_path(ini, "server.") == -1);
+  TEST_CHECK(ini_find_section_path(ini, "server.http.tls.v2") == -1);
+  ini_destroy(ini);
+
+  TEST_CASE("section whose parent doesn't exist");
+  ini = ini_load("[a.b.c]\n[a.b.c.d]\n");
+  TEST_CHECK(ini_find_section_path(ini, "a.b.c") == 1);
+  TEST_CHECK(ini_find_section_path(ini, "a.b.c.d") == 2);
+  TEST_CHECK(ini_find_section_path(ini, "a.b") == -1);
+  ini_destroy(ini);
+
+  TEST_CASE("lazily loaded document");
+  ini = ini_load_desc(&(ini_desc) { .data = nested_str, .lazy = true });
+  TEST_CHECK(ini_find_section_path(ini, "server.http.tls") == 2);
+  TEST_CHECK(ini_value_as_int(ini, ini_find_section_path(ini, "server.http"), "port") == 80);
+  ini_destroy(ini);
+}
+
+void test_ini_section_parent(void) {
+  ini_t* ini = ini_load(nested_str);
+
+  TEST_CHECK(ini_section_parent(ini, 1) == INI_GLOBAL_SECTION);
+  TEST_CHECK(ini_section_parent(ini, 2) == 4);
+  TEST_CHECK(ini_section_parent(ini, 4) == 1);
+  TEST_CHECK(ini_section_parent(ini, 6) == 4);
+  TEST_CHECK(ini_section_parent(ini, INI_GLOBAL_SECTION) == -1);
+  TEST_CHECK(ini_section_parent(ini, 42) == -1);
+  ini_destroy(ini);
+}
+
+void test_ini_section_child(void) {
+  ini_t* ini = ini_load(nested_str);
+
+  TEST_CHECK(ini_section_child(ini, INI_GLOBAL_SECTION) == 1);
+  TEST_CHECK(ini_section_child(ini, 1) == 4);
+  TEST_CHECK(ini_section_child(ini, 4) == 2);
+  TEST_CHECK(ini_section_child(ini, 3) == -1);
+  TEST_CHECK(ini_section_child(ini, 42) == -1);
+  ini_destroy(ini);
+}
+
+void test_ini_section_next(void) {
+  ini_t* ini = ini_load(nested_str);
+
+  TEST_CASE("children in document order");
+  TEST_CHECK(ini_section_next(ini, 1) == 3);
+  TEST_CHECK(ini_section_next(ini, 3) == -1);
+  TEST_CHECK(ini_section_next(ini, 4) == 5);
+  TEST_CHECK(ini_section_next(ini, 2) == 6);
+  TEST_CHECK(ini_section_next(ini, 6) == -1);
+
+  TEST_CASE("global section has no siblings");
+  TEST_CHECK(ini_section_next(ini, INI_GLOBAL_SECTION) == -1);
+  ini_destroy(ini);
 }
 
 void test_ini_section_exists(void) {
@@ -37,6 +738,7 @@ void test_ini_section_exists(void) {
   TEST_CHECK(ini_section_exists(ini, "owner") == true);
   TEST_CHECK(ini_section_exists(ini, "database") == true);
   TEST_CHECK(ini_section_exists(ini, "nope") == false);
+  ini_destroy(ini);
 }
 
 void test_ini_property_exists(void) {
@@ -55,6 +757,7 @@ void test_ini_property_exists(void) {
   TEST_CHECK(ini_property_exists(ini, database_id, "port") == true);
   TEST_CHECK(ini_property_exists(ini, database_id, "file") == true);
   TEST_CHECK(ini_property_exists(ini, database_id, "nope") == false);
+  ini_destroy(ini);
 }
 
 void test_ini_value(void) {
@@ -78,6 +781,206 @@ void test_ini_value(void) {
   TEST_CHECK(strcmp(ini_value(ini, database_id, "port"), "143") == 0);
   TEST_CHECK(strcmp(ini_value(ini, database_id, "file"), "payroll.dat") == 0);
   TEST_CHECK(ini_value(ini, database_id, "nope") == NULL);
+
+  TEST_CASE("lookups don't allocate");
+  alloc_stats_t stats;
+  alloc_begin();
+  const char* keys[] = { "server", "port", "nope" };
+  const char* values[3];
+  bool found = ini_value(ini, ini_find_section(ini, "owner"), "name") != NULL;
+  found = found && ini_property_exists(ini, database_id, "file");
+  found = found && ini_value_as_int(ini, database_id, "port") == 143;
+  found = found && ini_values_batch(ini, database_id, keys, 3, values) == 2;
+  alloc_end(&stats);
+  TEST_CHECK(found);
+  TEST_CHECK(stats.allocs == 0);
+
+  ini_destroy(ini);
+
+  TEST_CASE("quoted values");
+  ini = ini_load(
+    "plain = a ; comment\n"
+    "spaces = \"  padded  \"\n"
+    "comment = \"a;b#c\" ; comment\n"
+    "literal = 'say \"hi\"; \\n'\n"
+    "escaped = \"tab\\there \\\"quoted\\\" \\\\\"\n"
+    "unterminated = \"open\n"
+    "empty = \"\"\n");
+
+  TEST_CHECK(strcmp(ini_value(ini, INI_GLOBAL_SECTION, "plain"), "a") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, INI_GLOBAL_SECTION, "spaces"), "  padded  ") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, INI_GLOBAL_SECTION, "comment"), "a;b#c") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, INI_GLOBAL_SECTION, "literal"), "say \"hi\"; \\n") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, INI_GLOBAL_SECTION, "escaped"), "tab\there \"quoted\" \\") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, INI_GLOBAL_SECTION, "unterminated"), "open") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, INI_GLOBAL_SECTION, "empty"), "") == 0);
+
+  ini_destroy(ini);
+}
+
+void test_ini_value_span(void) {
+  ini_t* ini = ini_load(data_str);
+  int owner_id = ini_find_section(ini, "owner");
+
+  TEST_CASE("value and length");
+  ini_span_t span = ini_value_span(ini, owner_id, "organization");
+  TEST_CHECK(span.len == strlen("Acme Widgets Inc."));
+  TEST_CHECK(strcmp(span.ptr, "Acme Widgets Inc.") == 0);
+
+  TEST_CASE("keys sharing a prefix");
+  ini_set_value(ini, owner_id, "organization_unit", "Widgets");
+  ini_set_value(ini, owner_id, "organizatioN", "none");
+  TEST_CHECK(strcmp(ini_value_span(ini, owner_id, "organization").ptr, "Acme Widgets Inc.") == 0);
+  TEST_CHECK(ini_value_span(ini, owner_id, "organization_unit").len == 7);
+  TEST_CHECK(ini_value_span(ini, owner_id, "organizatioN").len == 4);
+
+  TEST_CASE("changed and missing values");
+  ini_set_value(ini, owner_id, "name", "Jane");
+  TEST_CHECK(ini_value_span(ini, owner_id, "name").len == 4);
+  span = ini_value_span(ini, owner_id, "nope");
+  TEST_CHECK(span.ptr == NULL && span.len == 0);
+
+  ini_destroy(ini);
+}
+
+void test_ini_values_batch(void) {
+  ini_t* ini = ini_load(data_str);
+  int database_id = ini_find_section(ini, "database");
+  const char* values[5];
+
+  TEST_CASE("present, missing and repeated keys");
+  const char* const keys[] = { "file", "nope", "server", "port", "file" };
+  TEST_CHECK(ini_values_batch(ini, database_id, keys, 5, values) == 4);
+  TEST_CHECK(strcmp(values[0], "payroll.dat") == 0);
+  TEST_CHECK(values[1] == NULL);
+  TEST_CHECK(strcmp(values[2], "192.0.2.62") == 0);
+  TEST_CHECK(strcmp(values[3], "143") == 0);
+  TEST_CHECK(values[4] == values[0]);
+
+  TEST_CASE("section that doesn't exist");
+  TEST_CHECK(ini_values_batch(ini, 42, keys, 5, values) == 0);
+  TEST_CHECK(values[0] == NULL && values[4] == NULL);
+  ini_destroy(ini);
+
+  TEST_CASE("more keys than a single group");
+  ini = ini_create();
+  static char names[200][16];
+  const char* many[200];
+  const char* found[200];
+  for (int i = 0; i < 200; i++) {
+    sprintf(names[i], "key%d", i);
+    many[i] = names[i];
+    if (i % 2 == 0) {
+      ini_set_value(ini, INI_GLOBAL_SECTION, names[i], names[i]);
+    }
+  }
+  TEST_CHECK(ini_values_batch(ini, INI_GLOBAL_SECTION, many, 200, found) == 100);
+  bool matched = true;
+  for (int i = 0; i < 200; i++) {
+    matched = matched && ((i % 2 == 0) ? (found[i] && strcmp(found[i], names[i]) == 0) : (found[i] == NULL));
+  }
+  TEST_CHECK(matched);
+  ini_destroy(ini);
+}
+
+void test_ini_keys_with_prefix(void) {
+  const char* str =
+    "[upstream]\n"
+    "pool2.port = 8081\n"
+    "pool10.host = 10.0.0.10\n"
+    "pool1.host = 10.0.0.1\n"
+    "timeout = 30\n"
+    "pool1.port = 8080\n"
+    "pool1 = on\n";
+  ini_t* ini = ini_load(str);
+  int upstream_id = ini_find_section(ini, "upstream");
+  ini_span_t key, value;
+
+  TEST_CASE("keys with a prefix, in key order");
+  ini_keys_t keys = ini_keys_with_prefix(ini, upstream_id, "pool1.");
+  TEST_CHECK(ini_keys_next(&keys, &key, &value));
+  TEST_CHECK(key.len == 10 && memcmp(key.ptr, "pool1.host", 10) == 0);
+  TEST_CHECK(value.len == 8 && memcmp(value.ptr, "10.0.0.1", 8) == 0);
+  TEST_CHECK(ini_keys_next(&keys, &key, &value));
+  TEST_CHECK(key.len == 10 && memcmp(key.ptr, "pool1.port", 10) == 0);
+  TEST_CHECK(!ini_keys_next(&keys, &key, &value));
+
+  TEST_CASE("prefix that is a whole key");
+  keys = ini_keys_with_prefix(ini, upstream_id, "pool1");
+  size_t count = 0;
+  while (ini_keys_next(&keys, &key, &value)) {
+    count++;
+  }
+  TEST_CHECK(count == 4);
+
+  TEST_CASE("empty prefix and missing prefix");
+  keys = ini_keys_with_prefix(ini, upstream_id, "");
+  TEST_CHECK(ini_keys_next(&keys, &key, &value));
+  TEST_CHECK(key.len == 5 && memcmp(key.ptr, "pool1", 5) == 0);
+  keys = ini_keys_with_prefix(ini, upstream_id, "zzz");
+  TEST_CHECK(!ini_keys_next(&keys, &key, &value));
+
+  TEST_CASE("section that doesn't exist");
+  keys = ini_keys_with_prefix(ini, 42, "pool");
+  TEST_CHECK(!ini_keys_next(&keys, &key, &value));
+
+  TEST_CASE("keys added after a query");
+  ini_set_value(ini, upstream_id, "pool1.weight", "3");
+  keys = ini_keys_with_prefix(ini, upstream_id, "pool1.");
+  count = 0;
+  while (ini_keys_next(&keys, &key, &value)) {
+    count++;
+  }
+  TEST_CHECK(count == 3);
+  ini_destroy(ini);
+}
+
+void test_ini_keys_matching(void) {
+  const char* str =
+    "[upstream]\n"
+    "pool1.host = 10.0.0.1\n"
+    "pool1.port = 8080\n"
+    "pool2.host = 10.0.0.2\n"
+    "pool2.port = 8081\n"
+    "pool10.host = 10.0.0.10\n"
+    "timeout = 30\n";
+  ini_t* ini = ini_load(str);
+  int upstream_id = ini_find_section(ini, "upstream");
+  ini_span_t key, value;
+
+  TEST_CASE("star matches any run of characters");
+  ini_keys_t keys = ini_keys_matching(ini, upstream_id, "pool*.host");
+  size_t count = 0;
+  while (ini_keys_next(&keys, &key, &value)) {
+    TEST_CHECK(key.len >= 10 && memcmp(key.ptr + key.len - 5, ".host", 5) == 0);
+    count++;
+  }
+  TEST_CHECK(count == 3);
+
+  TEST_CASE("question mark matches a single character");
+  keys = ini_keys_matching(ini, upstream_id, "pool?.port");
+  count = 0;
+  while (ini_keys_next(&keys, &key, &value)) {
+    count++;
+  }
+  TEST_CHECK(count == 2);
+
+  TEST_CASE("pattern without wildcards");
+  keys = ini_keys_matching(ini, upstream_id, "timeout");
+  TEST_CHECK(ini_keys_next(&keys, &key, &value));
+  TEST_CHECK(value.len == 2 && memcmp(value.ptr, "30", 2) == 0);
+  TEST_CHECK(!ini_keys_next(&keys, &key, &value));
+  keys = ini_keys_matching(ini, upstream_id, "pool1");
+  TEST_CHECK(!ini_keys_next(&keys, &key, &value));
+
+  TEST_CASE("pattern starting with a wildcard");
+  keys = ini_keys_matching(ini, upstream_id, "*");
+  count = 0;
+  while (ini_keys_next(&keys, &key, &value)) {
+    count++;
+  }
+  TEST_CHECK(count == 6);
+  ini_destroy(ini);
 }
 
 void test_ini_value_as_int(void) {
@@ -87,6 +990,7 @@ void test_ini_value_as_int(void) {
 
   TEST_CHECK(ini_value_as_int(ini, variables_id, "int") == 1234);
   TEST_CHECK(ini_value_as_int(ini, variables_id, "float") == 12);
+  ini_destroy(ini);
 }
 
 void test_ini_value_as_float(void) {
@@ -96,6 +1000,7 @@ void test_ini_value_as_float(void) {
 
   TEST_CHECK(ini_value_as_float(ini, variables_id, "int") == 1234.0f);
   TEST_CHECK(ini_value_as_float(ini, variables_id, "float") == 12.34f);
+  ini_destroy(ini);
 }
 
 void test_ini_value_as_bool(void) {
@@ -107,4 +1012,923 @@ void test_ini_value_as_bool(void) {
   TEST_CHECK(ini_value_as_bool(ini, variables_id, "float") == false);
   TEST_CHECK(ini_value_as_bool(ini, variables_id, "bool") == true);
   TEST_CHECK(ini_value_as_bool(ini, variables_id, "string") == false);
-}
\ No newline at end of file
+  ini_destroy(ini);
+}
+
+void test_ini_value_as_list(void) {
+  ini_t* ini = ini_load(
+    "hosts = alpha, beta ,gamma\n"
+    "gaps = a,,b,\n"
+    "single = one\n"
+    "empty =\n");
+  ini_span_t item;
+
+  TEST_CASE("list of items");
+  ini_list_t list = ini_value_as_list(ini, INI_GLOBAL_SECTION, "hosts");
+  TEST_CHECK(ini_list_next(&list, &item) && item.len == 5 && strncmp(item.ptr, "alpha", 5) == 0);
+  TEST_CHECK(ini_list_next(&list, &item) && item.len == 4 && strncmp(item.ptr, "beta", 4) == 0);
+  TEST_CHECK(ini_list_next(&list, &item) && item.len == 5 && strncmp(item.ptr, "gamma", 5) == 0);
+  TEST_CHECK(ini_list_next(&list, &item) == false);
+
+  TEST_CASE("list with empty items");
+  int count = 0;
+  list = ini_value_as_list(ini, INI_GLOBAL_SECTION, "gaps");
+  while (ini_list_next(&list, &item)) {
+    count++;
+  }
+  TEST_CHECK(count == 4);
+
+  TEST_CASE("list with a single item");
+  list = ini_value_as_list(ini, INI_GLOBAL_SECTION, "single");
+  TEST_CHECK(ini_list_next(&list, &item) && item.len == 3);
+  TEST_CHECK(ini_list_next(&list, &item) == false);
+
+  TEST_CASE("empty and missing lists");
+  list = ini_value_as_list(ini, INI_GLOBAL_SECTION, "empty");
+  TEST_CHECK(ini_list_next(&list, &item) == false);
+  list = ini_value_as_list(ini, INI_GLOBAL_SECTION, "nope");
+  TEST_CHECK(ini_list_next(&list, &item) == false);
+
+  ini_destroy(ini);
+}
+
+void test_ini_value_as_int_array(void) {
+  ini_t* ini = ini_load(
+    "ids = 1, -22, 333, 1234567890123, +42, nope, 9223372036854775807\n");
+  int64_t ids[8];
+
+  TEST_CASE("convert every item");
+  TEST_CHECK(ini_value_as_int_array(ini, INI_GLOBAL_SECTION, "ids", ids, 8) == 7);
+  TEST_CHECK(ids[0] == 1);
+  TEST_CHECK(ids[1] == -22);
+  TEST_CHECK(ids[2] == 333);
+  TEST_CHECK(ids[3] == 1234567890123ll);
+  TEST_CHECK(ids[4] == 42);
+  TEST_CHECK(ids[5] == 0);
+  TEST_CHECK(ids[6] == INT64_MAX);
+
+  TEST_CASE("capacity smaller than the list");
+  ids[2] = -1;
+  TEST_CHECK(ini_value_as_int_array(ini, INI_GLOBAL_SECTION, "ids", ids, 2) == 7);
+  TEST_CHECK(ids[1] == -22 && ids[2] == -1);
+  TEST_CHECK(ini_value_as_int_array(ini, INI_GLOBAL_SECTION, "ids", NULL, 0) == 7);
+
+  TEST_CASE("items too large for an int64_t are zero");
+  ini_t* big = ini_load(
+    "ids = 99999999999999999999999, 9223372036854775808, -9223372036854775808, "
+    "12345678901234567890, 1\n");
+  TEST_CHECK(ini_value_as_int_array(big, INI_GLOBAL_SECTION, "ids", ids, 8) == 5);
+  TEST_CHECK(ids[0] == 0);
+  TEST_CHECK(ids[1] == 0);
+  TEST_CHECK(ids[2] == INT64_MIN);
+  TEST_CHECK(ids[3] == 0);
+  TEST_CHECK(ids[4] == 1);
+  ini_destroy(big);
+
+  ini_destroy(ini);
+}
+
+void test_ini_set_value(void) {
+  ini_t* ini = ini_load(data_str);
+  int owner_id = ini_find_section(ini, "owner");
+
+  TEST_CASE("replace an existing value");
+  const char* old_name = ini_value(ini, owner_id, "name");
+  TEST_CHECK(ini_set_value(ini, owner_id, "name", "Jane Doe") == true);
+  TEST_CHECK(strcmp(ini_value(ini, owner_id, "name"), "Jane Doe") == 0);
+  TEST_CHECK(strcmp(old_name, "John Doe") == 0);
+
+  TEST_CASE("add a new value");
+  TEST_CHECK(ini_set_value(ini, owner_id, "email", "jane@example.com") == true);
+  TEST_CHECK(strcmp(ini_value(ini, owner_id, "email"), "jane@example.com") == 0);
+  TEST_CHECK(ini_property_exists(ini, INI_GLOBAL_SECTION, "email") == false);
+
+  TEST_CASE("set a value in a section that doesn't exist");
+  TEST_CHECK(ini_set_value(ini, 42, "name", "nobody") == false);
+  ini_destroy(ini);
+
+  TEST_CASE("add many values to an empty document");
+  ini = ini_create();
+  char key[16];
+  for (int i = 0; i < 1000; i++) {
+    sprintf(key, "key%d", i);
+    ini_set_value(ini, INI_GLOBAL_SECTION, key, key);
+  }
+  bool found = true;
+  for (int i = 0; i < 1000; i++) {
+    sprintf(key, "key%d", i);
+    found = found && ini_value(ini, INI_GLOBAL_SECTION, key) != NULL;
+  }
+  TEST_CHECK(found);
+  ini_destroy(ini);
+}
+
+void test_ini_interpolate(void) {
+  test_setenv("INI_TEST_HOME", "/home/test");
+  ini_t* ini = ini_load(
+    "root = ${INI_TEST_HOME}/app\n"
+    "[paths]\n"
+    "logs = ${paths:data}/logs\n"
+    "data = ${:root}/data\n"
+    "missing = [${paths:nope}${INI_TEST_UNSET}]\n"
+    "[cycle]\n"
+    "a = ${cycle:b}\n"
+    "b = ${cycle:a}\n"
+    "c = x${cycle:a}\n");
+  int paths_id = ini_find_section(ini, "paths");
+  int cycle_id = ini_find_section(ini, "cycle");
+
+  TEST_CASE("values are left as written until interpolated");
+  TEST_CHECK(strcmp(ini_value(ini, paths_id, "logs"), "${paths:data}/logs") == 0);
+
+  TEST_CASE("references are resolved in dependency order");
+  TEST_CHECK(ini_interpolate(ini) == false);
+  TEST_CHECK(strcmp(ini_value(ini, INI_GLOBAL_SECTION, "root"), "/home/test/app") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, paths_id, "data"), "/home/test/app/data") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, paths_id, "logs"), "/home/test/app/data/logs") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, paths_id, "missing"), "[]") == 0);
+
+  TEST_CASE("cycles are left unresolved");
+  TEST_CHECK(strcmp(ini_value(ini, cycle_id, "a"), "${cycle:b}") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, cycle_id, "c"), "x${cycle:a}") == 0);
+  TEST_CHECK(ini_num_cyclic(ini) == 3);
+
+  TEST_CASE("changing a value updates its dependents");
+  TEST_CHECK(ini_set_value(ini, INI_GLOBAL_SECTION, "root", "/srv") == true);
+  TEST_CHECK(strcmp(ini_value(ini, paths_id, "logs"), "/srv/data/logs") == 0);
+  TEST_CHECK(ini_num_cyclic(ini) == 3);
+
+  TEST_CASE("breaking a cycle resolves it");
+  TEST_CHECK(ini_set_value(ini, cycle_id, "b", "${paths:data}") == true);
+  TEST_CHECK(strcmp(ini_value(ini, cycle_id, "a"), "/srv/data") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, cycle_id, "c"), "x/srv/data") == 0);
+  TEST_CHECK(ini_num_cyclic(ini) == 0);
+
+  TEST_CASE("making a cycle leaves it and its dependents as written");
+  TEST_CHECK(ini_set_value(ini, paths_id, "data", "${paths:logs}") == true);
+  TEST_CHECK(ini_num_cyclic(ini) == 5);
+  TEST_CHECK(strcmp(ini_value(ini, cycle_id, "b"), "${paths:data}") == 0);
+  TEST_CHECK(ini_set_value(ini, paths_id, "data", "${:root}/data") == true);
+  TEST_CHECK(ini_num_cyclic(ini) == 0);
+  TEST_CHECK(strcmp(ini_value(ini, cycle_id, "c"), "x/srv/data") == 0);
+
+  TEST_CASE("references to values added later");
+  TEST_CHECK(ini_set_value(ini, paths_id, "cache", "${paths:tmp}/cache") == true);
+  TEST_CHECK(strcmp(ini_value(ini, paths_id, "cache"), "/cache") == 0);
+  TEST_CHECK(ini_set_value(ini, paths_id, "tmp", "${:root}/tmp") == true);
+  TEST_CHECK(strcmp(ini_value(ini, paths_id, "cache"), "/srv/tmp/cache") == 0);
+
+  TEST_CASE("values without references");
+  TEST_CHECK(ini_set_value(ini, paths_id, "tmp", "/tmp") == true);
+  TEST_CHECK(strcmp(ini_value(ini, paths_id, "cache"), "/tmp/cache") == 0);
+  TEST_CHECK(ini_set_value(ini, paths_id, "tmp", "${:root}") == true);
+  TEST_CHECK(strcmp(ini_value(ini, paths_id, "cache"), "/srv/cache") == 0);
+  ini_destroy(ini);
+
+  TEST_CASE("long chains of references");
+  enum { CHAIN = 100000 };
+  char* data = (char*) malloc(CHAIN * 32);
+  size_t len = 0;
+  for (int i = 0; i < CHAIN - 1; i++) {
+    len += sprintf(data + len, "[s%d]\nkey = ${s%d:key}\n", i, i + 1);
+  }
+  sprintf(data + len, "[s%d]\nkey = end\n", CHAIN - 1);
+  ini = ini_load(data);
+  TEST_CHECK(ini_interpolate(ini) == true);
+  TEST_CHECK(strcmp(ini_value(ini, 1, "key"), "end") == 0);
+  TEST_CHECK(ini_set_value(ini, CHAIN, "key", "changed") == true);
+  TEST_CHECK(strcmp(ini_value(ini, 1, "key"), "changed") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, 5000, "key"), "changed") == 0);
+  ini_destroy(ini);
+  free(data);
+  test_setenv("INI_TEST_HOME", NULL);
+}
+
+void test_ini_apply_env(void) {
+  const char* data =
+    "mode = slow\n"
+    "[database]\n"
+    "port = 143\n"
+    "host = localhost\n"
+    "[app.log-level]\n"
+    "Verbose = no\n"
+    "path = ${database:host}/logs\n";
+  test_setenv("INI_TEST__DATABASE__PORT", "5432");
+  test_setenv("INI_TEST__MODE", "fast");
+  test_setenv("INI_TEST__APP_LOG_LEVEL__VERBOSE", "yes");
+  test_setenv("INI_TEST__DATABASE__NOPE", "ignored");
+  test_setenv("INI_TEST__NOPE__PORT", "ignored");
+  test_setenv("INI_TESTING__DATABASE__HOST", "ignored");
+
+  TEST_CASE("variables override values when loaded");
+  const ini_desc desc = { .data = data, .env_prefix = "INI_TEST" };
+  ini_t* ini = ini_load_desc(&desc);
+  int database = ini_find_section(ini, "database");
+  int log = ini_find_section(ini, "app.log-level");
+  TEST_CHECK(strcmp(ini_value(ini, database, "port"), "5432") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, INI_GLOBAL_SECTION, "mode"), "fast") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, log, "Verbose"), "yes") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, database, "host"), "localhost") == 0);
+  TEST_CHECK(ini_value(ini, database, "nope") == NULL);
+
+  TEST_CASE("changes are picked up when applied again");
+  test_setenv("INI_TEST__DATABASE__PORT", "6543");
+  test_setenv("INI_TEST__MODE", NULL);
+  TEST_CHECK(strcmp(ini_value(ini, database, "port"), "5432") == 0);
+  TEST_CHECK(ini_apply_env(ini, "INI_TEST") == 2);
+  TEST_CHECK(strcmp(ini_value(ini, database, "port"), "6543") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, INI_GLOBAL_SECTION, "mode"), "slow") == 0);
+  TEST_CHECK(ini_apply_env(ini, "INI_TEST") == 2);
+  TEST_CHECK(ini_apply_env(ini, "INI_NONE") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, database, "port"), "143") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, log, "Verbose"), "no") == 0);
+  ini_destroy(ini);
+
+  TEST_CASE("overrides of interpolated values");
+  test_setenv("INI_TEST__APP_LOG_LEVEL__PATH", "/var/log");
+  ini = ini_load(data);
+  log = ini_find_section(ini, "app.log-level");
+  ini_interpolate(ini);
+  TEST_CHECK(strcmp(ini_value(ini, log, "path"), "localhost/logs") == 0);
+  TEST_CHECK(ini_apply_env(ini, "INI_TEST") == 3);
+  TEST_CHECK(strcmp(ini_value(ini, log, "path"), "/var/log") == 0);
+  test_setenv("INI_TEST__APP_LOG_LEVEL__PATH", NULL);
+  test_setenv("INI_TEST__DATABASE__HOST", "db");
+  TEST_CHECK(ini_apply_env(ini, "INI_TEST") == 3);
+  TEST_CHECK(strcmp(ini_value(ini, log, "path"), "db/logs") == 0);
+
+  TEST_CASE("applying an unchanged environment doesn't allocate");
+  alloc_stats_t stats;
+  alloc_begin();
+  for (int i = 0; i < 10; i++) {
+    ini_apply_env(ini, "INI_TEST");
+  }
+  alloc_end(&stats);
+  TEST_CHECK(stats.allocs == 0);
+  TEST_MSG("Allocations: %d", (int) stats.allocs);
+  ini_destroy(ini);
+
+  TEST_CASE("overrides of a clone");
+  test_setenv("INI_TEST__DATABASE__HOST", NULL);
+  ini = ini_load(data);
+  database = ini_find_section(ini, "database");
+  ini_t* clone = ini_clone(ini);
+  TEST_CHECK(ini_apply_env(clone, "INI_TEST") == 2);
+  TEST_CHECK(strcmp(ini_value(clone, database, "port"), "6543") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, database, "port"), "143") == 0);
+  ini_destroy(clone);
+  ini_destroy(ini);
+
+  test_setenv("INI_TEST__DATABASE__PORT", NULL);
+  test_setenv("INI_TEST__APP_LOG_LEVEL__VERBOSE", NULL);
+  test_setenv("INI_TEST__DATABASE__NOPE", NULL);
+  test_setenv("INI_TEST__NOPE__PORT", NULL);
+  test_setenv("INI_TESTING__DATABASE__HOST", NULL);
+}
+
+/* joins the spans of an editor to compare them with what they should be */
+static char* editor_text(const ini_editor_t* editor, char* out, size_t cap) {
+  ini_span_t spans[32];
+  const size_t n = ini_editor_spans(editor, spans, 32);
+  size_t len = 0;
+  for (size_t i = 0; i < n && i < 32; i++) {
+    if (len + spans[i].len < cap) {
+      memcpy(out + len, spans[i].ptr, spans[i].len);
+      len += spans[i].len;
+    }
+  }
+  out[len] = '\0';
+  return out;
+}
+
+static const char* edit_str =
+  "; configuration\n"
+  "mode = fast ; inline\n"
+  "\n"
+  "[database]\n"
+  "  server = 192.0.2.62  ; primary\n"
+  "port=143\n"
+  "name = \"payroll ; 2024\"\n"
+  "empty =\n"
+  "\n"
+  "[owner]\n"
+  "name = John Doe\n";
+
+void test_ini_editor_create(void) {
+  char out[512];
+
+  TEST_CASE("an unedited document is the source");
+  ini_editor_t* editor = ini_editor_create(edit_str, 0);
+  TEST_CHECK(strcmp(editor_text(editor, out, sizeof(out)), edit_str) == 0);
+
+  TEST_CASE("the document is parsed");
+  const ini_t* ini = ini_editor_document(editor);
+  TEST_CHECK(strcmp(ini_value(ini, INI_GLOBAL_SECTION, "mode"), "fast") == 0);
+  TEST_CHECK(strcmp(ini_value(ini, ini_find_section(ini, "database"), "name"), "payroll ; 2024") == 0);
+  ini_editor_destroy(editor);
+
+  TEST_CASE("the size of the source");
+  editor = ini_editor_create(edit_str, 16);
+  TEST_CHECK(strcmp(editor_text(editor, out, sizeof(out)), "; configuration\n") == 0);
+  TEST_CHECK(ini_num_properties(ini_editor_document(editor), INI_GLOBAL_SECTION) == 0);
+  ini_editor_destroy(editor);
+}
+
+void test_ini_editor_set_value(void) {
+  char out[512];
+  ini_editor_t* editor = ini_editor_create(edit_str, 0);
+  const int database = ini_find_section(ini_editor_document(editor), "database");
+
+  TEST_CASE("replaced values keep their comments and spacing");
+  TEST_CHECK(ini_editor_set_value(editor, INI_GLOBAL_SECTION, "mode", "slow") == true);
+  TEST_CHECK(ini_editor_set_value(editor, database, "server", "10.0.0.1") == true);
+  TEST_CHECK(ini_editor_set_value(editor, database, "port", "5432") == true);
+  TEST_CHECK(strcmp(editor_text(editor, out, sizeof(out)),
+    "; configuration\nmode = slow ; inline\n\n[database]\n  server = 10.0.0.1  ; primary\nport=5432\n"
+    "name = \"payroll ; 2024\"\nempty =\n\n[owner]\nname = John Doe\n") == 0);
+  TEST_MSG("Produced: %s", out);
+
+  TEST_CASE("quoted and empty values");
+  TEST_CHECK(ini_editor_set_value(editor, database, "name", "payroll") == true);
+  TEST_CHECK(ini_editor_set_value(editor, database, "empty", " padded # \"x\"") == true);
+  TEST_CHECK(strstr(editor_text(editor, out, sizeof(out)), "name = payroll\nempty = \" padded # \\\"x\\\"\"\n") != NULL);
+  TEST_MSG("Produced: %s", out);
+
+  TEST_CASE("new keys follow the last property of their section");
+  TEST_CHECK(ini_editor_set_value(editor, database, "user", "admin") == true);
+  TEST_CHECK(ini_editor_set_value(editor, database, "pool", "8") == true);
+  TEST_CHECK(strstr(editor_text(editor, out, sizeof(out)), "empty = \" padded # \\\"x\\\"\"\nuser = admin\npool = 8\n\n[owner]") != NULL);
+  TEST_MSG("Produced: %s", out);
+
+  TEST_CASE("values edited again");
+  TEST_CHECK(ini_editor_set_value(editor, database, "port", "6543") == true);
+  TEST_CHECK(ini_editor_set_value(editor, database, "user", "root") == true);
+  TEST_CHECK(strcmp(editor_text(editor, out, sizeof(out)),
+    "; configuration\nmode = slow ; inline\n\n[database]\n  server = 10.0.0.1  ; primary\nport=6543\n"
+    "name = payroll\nempty = \" padded # \\\"x\\\"\"\nuser = root\npool = 8\n\n[owner]\nname = John Doe\n") == 0);
+  TEST_MSG("Produced: %s", out);
+
+  TEST_CASE("the edited text is read back the same");
+  ini_t* ini = ini_load(out);
+  TEST_CHECK(ini_hash_equal(ini_fingerprint(ini), ini_fingerprint(ini_editor_document(editor))));
+  TEST_CHECK(strcmp(ini_value(ini, database, "empty"), " padded # \"x\"") == 0);
+  ini_destroy(ini);
+
+  TEST_CASE("keys that can't be written");
+  TEST_CHECK(ini_editor_set_value(editor, database, "", "x") == false);
+  TEST_CHECK(ini_editor_set_value(editor, database, "a=b", "x") == false);
+  TEST_CHECK(ini_editor_set_value(editor, database, "[a", "x") == false);
+  TEST_CHECK(ini_editor_set_value(editor, database, " a", "x") == false);
+  TEST_CHECK(ini_editor_set_value(editor, 42, "a", "x") == false);
+  ini_editor_destroy(editor);
+}
+
+void test_ini_editor_add_section(void) {
+  char out[512];
+  ini_editor_t* editor = ini_editor_create(edit_str, 0);
+
+  TEST_CASE("existing sections");
+  TEST_CHECK(ini_editor_add_section(editor, "owner") == ini_find_section(ini_editor_document(editor), "owner"));
+  TEST_CHECK(strcmp(editor_text(editor, out, sizeof(out)), edit_str) == 0);
+
+  TEST_CASE("new sections and their keys");
+  const int cache = ini_editor_add_section(editor, "cache");
+  TEST_CHECK(cache == ini_find_section(ini_editor_document(editor), "cache"));
+  TEST_CHECK(ini_editor_set_value(editor, cache, "size", "64") == true);
+  TEST_CHECK(ini_editor_set_value(editor, cache, "path", "/tmp") == true);
+  TEST_CHECK(ini_editor_set_value(editor, cache, "size", "128") == true);
+  const int backup = ini_editor_add_section(editor, "cache.backup");
+  TEST_CHECK(ini_section_parent(ini_editor_document(editor), backup) == cache);
+  TEST_CHECK(ini_editor_set_value(editor, INI_GLOBAL_SECTION, "debug", "on") == true);
+  TEST_CHECK(strcmp(editor_text(editor, out, sizeof(out)),
+    "; configuration\nmode = fast ; inline\ndebug = on\n\n[database]\n  server = 192.0.2.62  ; primary\nport=143\n"
+    "name = \"payroll ; 2024\"\nempty =\n\n[owner]\nname = John Doe\n"
+    "\n[cache]\nsize = 128\npath = /tmp\n\n[cache.backup]\n") == 0);
+  TEST_MSG("Produced: %s", out);
+
+  TEST_CASE("names that can't be written");
+  TEST_CHECK(ini_editor_add_section(editor, "") == INI_NOT_FOUND);
+  TEST_CHECK(ini_editor_add_section(editor, "a]b") == INI_NOT_FOUND);
+  TEST_CHECK(ini_editor_add_section(editor, "a\nb") == INI_NOT_FOUND);
+  ini_editor_destroy(editor);
+
+  TEST_CASE("lines that end with \r\n");
+  editor = ini_editor_create("[owner]\r\nname = John Doe\r\n\r\n[extra]\r\n", 0);
+  TEST_CHECK(ini_editor_set_value(editor, 1, "age", "42") == true);
+  TEST_CHECK(ini_editor_set_value(editor, 1, "name", "Jane Doe") == true);
+  TEST_CHECK(ini_editor_set_value(editor, 2, "key", "value") == true);
+  TEST_CHECK(ini_editor_add_section(editor, "cache") == 3);
+  TEST_CHECK(strcmp(editor_text(editor, out, sizeof(out)), "[owner]\r\nname = Jane Doe\r\nage = 42\r\n\r\n[extra]\r\nkey = value\r\n\r\n[cache]\r\n") == 0);
+  TEST_MSG("Produced: %s", out);
+  ini_editor_destroy(editor);
+
+  TEST_CASE("source without a trailing newline");
+  editor = ini_editor_create("[owner]\nname = John Doe", 0);
+  TEST_CHECK(ini_editor_set_value(editor, 1, "age", "42") == true);
+  TEST_CHECK(ini_editor_set_value(editor, ini_editor_add_section(editor, "extra"), "key", "value") == true);
+  TEST_CHECK(strcmp(editor_text(editor, out, sizeof(out)), "[owner]\nname = John Doe\nage = 42\n\n[extra]\nkey = value\n") == 0);
+  TEST_MSG("Produced: %s", out);
+  ini_editor_destroy(editor);
+}
+
+void test_ini_editor_spans(void) {
+  ini_editor_t* editor = ini_editor_create(edit_str, 0);
+  ini_span_t spans[8];
+
+  TEST_CASE("an unedited document is a single span");
+  TEST_CHECK(ini_editor_spans(editor, spans, 8) == 1);
+  TEST_CHECK(spans[0].ptr == edit_str && spans[0].len == strlen(edit_str));
+
+  TEST_CASE("an edit splits the source around it");
+  ini_editor_set_value(editor, INI_GLOBAL_SECTION, "mode", "slow");
+  TEST_CHECK(ini_editor_spans(editor, spans, 8) == 3);
+  TEST_CHECK(spans[0].ptr == edit_str && spans[0].len == 23);
+  TEST_CHECK(spans[1].len == 4 && memcmp(spans[1].ptr, "slow", 4) == 0);
+  TEST_CHECK(spans[2].ptr == edit_str + 27);
+
+  TEST_CASE("the number of spans when they don't fit");
+  ini_editor_add_section(editor, "cache");
+  TEST_CHECK(ini_editor_spans(editor, NULL, 0) == 4);
+  TEST_CHECK(ini_editor_spans(editor, spans, 2) == 4);
+  ini_editor_destroy(editor);
+}
+
+void test_ini_editor_write(void) {
+  /* setup filesystem */
+  char* cwd = (char*) fs_get_cwd();
+  fs_setup(&(fs_desc) { .write_dir = cwd, .base_paths = { cwd } });
+
+  TEST_CASE("write an edited document");
+  ini_editor_t* editor = ini_editor_create(data_str, 0);
+  ini_editor_set_value(editor, 2, "port", "5432");
+  ini_editor_set_value(editor, ini_editor_add_section(editor, "extra"), "key", "value");
+  TEST_CHECK(ini_editor_write(editor, "is_a_file.ini") == true);
+  ini_t* ini = ini_load_file("is_a_file.ini");
+  if (TEST_CHECK(ini != NULL)) {
+    TEST_CHECK(ini_hash_equal(ini_fingerprint(ini), ini_fingerprint(ini_editor_document(editor))));
+    TEST_CHECK(strcmp(ini_value(ini, 2, "port"), "5432") == 0);
+    TEST_CHECK(strcmp(ini_value(ini, ini_find_section(ini, "extra"), "key"), "value") == 0);
+    ini_destroy(ini);
+  }
+  ini_editor_destroy(editor);
+
+  /* cleanup */
+  fs_delete("is_a_file.ini");
+}
+
+void test_ini_fingerprint(void) {
+  ini_t* ini = ini_load(data_str);
+  ini_t* reordered = ini_load(
+    "[variables]\nstring=hello\nbool=true\nfloat=12.34\nint=1234\n"
+    "[database]\nfile = payroll.dat\nport = 143\nserver = 192.0.2.62\n"
+    "[empty]\n"
+    "[owner]\norganization = Acme Widgets Inc.\nname = John Doe\n"
+    "network = wireless\n");
+  /* the last line belongs to [owner], so the global section differs */
+  TEST_CASE("order independent");
+  TEST_CHECK(!ini_hash_equal(ini_fingerprint(ini), ini_fingerprint(reordered)));
+  ini_set_value(reordered, INI_GLOBAL_SECTION, "network", "wireless");
+  ini_set_value(ini, 1, "network", "wireless");
+  TEST_CHECK(ini_hash_equal(ini_fingerprint(ini), ini_fingerprint(reordered)));
+
+  TEST_CASE("changed values");
+  const ini_hash_t before = ini_fingerprint(ini);
+  ini_set_value(ini, 2, "port", "144");
+  TEST_CHECK(!ini_hash_equal(before, ini_fingerprint(ini)));
+  ini_set_value(ini, 2, "port", "143");
+  TEST_CHECK(ini_hash_equal(before, ini_fingerprint(ini)));
+
+  TEST_CASE("lazy documents");
+  ini_t* lazy = ini_load_desc(&(ini_desc) { .data = data_str, .lazy = true });
+  ini_set_value(lazy, 1, "network", "wireless");
+  TEST_CHECK(ini_hash_equal(before, ini_fingerprint(lazy)));
+
+  TEST_CASE("interpolated values");
+  ini_t* a = ini_load("root = /app\nlogs = ${:root}/logs\n");
+  ini_t* b = ini_load("logs = /app/logs\nroot = /app\n");
+  TEST_CHECK(!ini_hash_equal(ini_fingerprint(a), ini_fingerprint(b)));
+  ini_interpolate(a);
+  TEST_CHECK(ini_hash_equal(ini_fingerprint(a), ini_fingerprint(b)));
+
+  ini_destroy(a);
+  ini_destroy(b);
+  ini_destroy(lazy);
+  ini_destroy(reordered);
+  ini_destroy(ini);
+}
+
+static void diff_collect(const char* section, const char* key, const char* a, const char* b, void* user) {
+  char* out = (char*) user;
+  sprintf(out + strlen(out), "[%s]%s:%s>%s;", section, key, a ? a : "-", b ? b : "-");
+}
+
+void test_ini_diff(void) {
+  char out[256] = { 0 };
+  ini_t* a = ini_load(data_str);
+  ini_t* b = ini_load(data_str);
+
+  TEST_CASE("identical documents");
+  TEST_CHECK(ini_diff(a, b, diff_collect, out) == 0);
+  TEST_CHECK(strcmp(out, "") == 0);
+
+  TEST_CASE("changed, added and removed values");
+  ini_set_value(b, 2, "port", "144");
+  ini_set_value(b, INI_GLOBAL_SECTION, "mode", "fast");
+  ini_destroy(a);
+  a = ini_load(
+    "network = wireless\n[owner]\nname = John Doe\n[database]\nserver = 192.0.2.62\nport = 143\n"
+    "[variables]\nint=1234\nfloat=12.34\nbool=true\nstring=hello\n[extra]\nkey = value\n");
+  TEST_CHECK(ini_diff(a, b, diff_collect, out) == 5);
+  TEST_CHECK(strcmp(out,
+    "[]mode:->fast;"
+    "[owner]organization:->Acme Widgets Inc.;"
+    "[database]port:143>144;"
+    "[database]file:->payroll.dat;"
+    "[extra]key:value>-;") == 0);
+  TEST_MSG("Produced: %s", out);
+  TEST_CHECK(ini_diff(b, a, NULL, NULL) == 5);
+
+  ini_destroy(b);
+  ini_destroy(a);
+}
+
+void test_ini_version_create(void) {
+  ini_t* ini = ini_load(data_str);
+
+  TEST_CASE("version of a document");
+  ini_version_t* version = ini_version_create(ini);
+  TEST_CHECK(ini_version_num_properties(version) == 10);
+  TEST_CHECK(strcmp(ini_version_value(version, NULL, "network"), "wireless") == 0);
+  TEST_CHECK(strcmp(ini_version_value(version, "database", "port"), "143") == 0);
+  TEST_CHECK(strcmp(ini_version_value(version, "variables", "string"), "hello") == 0);
+
+  TEST_CASE("independent of the document");
+  ini_set_value(ini, 2, "port", "144");
+  ini_destroy(ini);
+  TEST_CHECK(strcmp(ini_version_value(version, "database", "port"), "143") == 0);
+  ini_version_destroy(version);
+
+  TEST_CASE("first of repeated keys and sections");
+  ini = ini_load("a = 1\na = 2\n[s]\nb = 3\n[s]\nb = 4\nc = 5\n");
+  version = ini_version_create(ini);
+  TEST_CHECK(ini_version_num_properties(version) == 3);
+  TEST_CHECK(strcmp(ini_version_value(version, "", "a"), "1") == 0);
+  TEST_CHECK(strcmp(ini_version_value(version, "s", "b"), "3") == 0);
+  TEST_CHECK(strcmp(ini_version_value(version, "s", "c"), "5") == 0);
+  ini_version_destroy(version);
+  ini_destroy(ini);
+
+  TEST_CASE("empty version");
+  version = ini_version_create(NULL);
+  TEST_CHECK(ini_version_num_properties(version) == 0);
+  TEST_CHECK(ini_version_value(version, NULL, "network") == NULL);
+  ini_version_destroy(version);
+}
+
+void test_ini_version_set(void) {
+  ini_t* ini = ini_load(data_str);
+  enum { VERSIONS = 100 };
+  ini_version_t* versions[VERSIONS];
+  versions[0] = ini_version_create(ini);
+  ini_destroy(ini);
+
+  TEST_CASE("every version keeps its values");
+  char value[16];
+  for (int i = 1; i < VERSIONS; i++) {
+    sprintf(value, "%d", 1000 + i);
+    versions[i] = ini_version_set(versions[i - 1], "database", "port", value);
+  }
+  bool kept = true;
+  for (int i = 1; i < VERSIONS; i++) {
+    sprintf(value, "%d", 1000 + i);
+    kept = kept && strcmp(ini_version_value(versions[i], "database", "port"), value) == 0;
+    kept = kept && ini_version_num_properties(versions[i]) == 10;
+  }
+  TEST_CHECK(kept);
+  TEST_CHECK(strcmp(ini_version_value(versions[0], "database", "port"), "143") == 0);
+
+  TEST_CASE("added and removed values");
+  ini_version_t* added = ini_version_set(versions[50], "new", "key", "value");
+  TEST_CHECK(ini_version_num_properties(added) == 11);
+  TEST_CHECK(strcmp(ini_version_value(added, "new", "key"), "value") == 0);
+  TEST_CHECK(ini_version_value(versions[50], "new", "key") == NULL);
+  ini_version_t* removed = ini_version_set(added, "database", "port", NULL);
+  TEST_CHECK(ini_version_num_properties(removed) == 10);
+  TEST_CHECK(ini_version_value(removed, "database", "port") == NULL);
+  TEST_CHECK(strcmp(ini_version_value(added, "database", "port"), "1050") == 0);
+  ini_version_t* unchanged = ini_version_set(removed, "database", "nope", NULL);
+  TEST_CHECK(ini_version_num_properties(unchanged) == 10);
+  TEST_CHECK(ini_version_diff(removed, unchanged, NULL, NULL) == 0);
+
+  TEST_CASE("destroyed in any order");
+  ini_version_destroy(added);
+  for (int i = 0; i < VERSIONS; i += 2) {
+    ini_version_destroy(versions[i]);
+  }
+  TEST_CHECK(strcmp(ini_version_value(removed, "owner", "name"), "John Doe") == 0);
+  TEST_CHECK(strcmp(ini_version_value(versions[51], "database", "port"), "1051") == 0);
+  for (int i = 1; i < VERSIONS; i += 2) {
+    ini_version_destroy(versions[i]);
+  }
+  ini_version_destroy(removed);
+  ini_version_destroy(unchanged);
+
+  TEST_CASE("many keys");
+  ini_version_t* version = ini_version_create(NULL);
+  char key[16];
+  for (int i = 0; i < 5000; i++) {
+    sprintf(key, "key%d", i);
+    ini_version_t* next = ini_version_set(version, (i % 2) ? "odd" : NULL, key, key);
+    ini_version_destroy(version);
+    version = next;
+  }
+  for (int i = 0; i < 5000; i += 3) {
+    sprintf(key, "key%d", i);
+    ini_version_t* next = ini_version_set(version, (i % 2) ? "odd" : NULL, key, NULL);
+    ini_version_destroy(version);
+    version = next;
+  }
+  bool found = true;
+  for (int i = 0; i < 5000; i++) {
+    sprintf(key, "key%d", i);
+    const char* v = ini_version_value(version, (i % 2) ? "odd" : NULL, key);
+    found = found && ((i % 3 == 0) ? v == NULL : (v != NULL && strcmp(v, key) == 0));
+  }
+  TEST_CHECK(found);
+  TEST_CHECK(ini_version_num_properties(version) == 5000 - 1667);
+  ini_version_destroy(version);
+}
+
+void test_ini_version_value(void) {
+  ini_t* ini = ini_load(data_str);
+  ini_version_t* version = ini_version_create(ini);
+  ini_destroy(ini);
+
+  TEST_CASE("present and missing keys");
+  TEST_CHECK(strcmp(ini_version_value(version, "owner", "organization"), "Acme Widgets Inc.") == 0);
+  TEST_CHECK(ini_version_value(version, "owner", "nope") == NULL);
+  TEST_CHECK(ini_version_value(version, "nope", "name") == NULL);
+
+  TEST_CASE("global section");
+  TEST_CHECK(strcmp(ini_version_value(version, NULL, "network"), "wireless") == 0);
+  TEST_CHECK(strcmp(ini_version_value(version, "", "network"), "wireless") == 0);
+  TEST_CHECK(ini_version_value(version, "owner", "network") == NULL);
+  ini_version_destroy(version);
+}
+
+void test_ini_version_diff(void) {
+  char out[256] = { 0 };
+  ini_t* ini = ini_load(data_str);
+  ini_version_t* a = ini_version_create(ini);
+  ini_version_t* same = ini_version_create(ini);
+  ini_destroy(ini);
+
+  TEST_CASE("identical versions");
+  TEST_CHECK(ini_version_diff(a, a, diff_collect, out) == 0);
+  TEST_CHECK(ini_version_diff(a, same, diff_collect, out) == 0);
+  TEST_CHECK(strcmp(out, "") == 0);
+
+  TEST_CASE("changed, added and removed values");
+  ini_version_t* b = ini_version_set(a, "database", "port", "144");
+  TEST_CHECK(ini_version_diff(a, b, diff_collect, out) == 1);
+  TEST_CHECK(strcmp(out, "[database]port:143>144;") == 0);
+  TEST_MSG("Produced: %s", out);
+  ini_version_t* c = ini_version_set(b, NULL, "mode", "fast");
+  ini_version_t* d = ini_version_set(c, "owner", "name", NULL);
+  out[0] = '\0';
+  TEST_CHECK(ini_version_diff(b, d, diff_collect, out) == 2);
+  TEST_CHECK(strstr(out, "[]mode:->fast;") != NULL);
+  TEST_CHECK(strstr(out, "[owner]name:John Doe>-;") != NULL);
+  TEST_MSG("Produced: %s", out);
+  TEST_CHECK(ini_version_diff(d, a, NULL, NULL) == 3);
+  TEST_CHECK(ini_version_diff(same, d, NULL, NULL) == 3);
+
+  ini_version_destroy(a);
+  ini_version_destroy(b);
+  ini_version_destroy(c);
+  ini_version_destroy(d);
+  ini_version_destroy(same);
+}
+
+void test_ini_get_stats(void) {
+  ini_t* ini = ini_load(data_str);
+  ini_stats_t stats;
+
+  TEST_CASE("parse statistics");
+  TEST_CHECK(ini_get_stats(ini, &stats) == true);
+  TEST_CHECK(stats.bytes == strlen(data_str));
+  TEST_CHECK(stats.lines == 17);
+  TEST_CHECK(stats.sections == 3);
+  TEST_CHECK(stats.properties == 10);
+  TEST_CHECK(stats.lookups == 0);
+
+  TEST_CASE("lookup statistics");
+  int database_id = ini_find_section(ini, "database");
+  ini_value(ini, database_id, "port");
+  ini_value(ini, database_id, "nope");
+  ini_get_stats(ini, &stats);
+  TEST_CHECK(stats.lookups == 3);
+  TEST_CHECK(stats.hits == 2);
+  TEST_CHECK(stats.misses == 1);
+  /* the section is found by its name in one probe, the missing key is
+     rejected by the filter without probing */
+  TEST_CHECK(stats.probes == 1 + 2 + 0);
+  TEST_CHECK(stats.max_probes == 2);
+
+  ini_destroy(ini);
+
+  TEST_CASE("missing keys rarely probe");
+  ini = ini_create();
+  char key[16];
+  for (int i = 0; i < 1000; i++) {
+    sprintf(key, "key%d", i);
+    ini_set_value(ini, INI_GLOBAL_SECTION, key, key);
+  }
+  memset(&ini->stats, 0, sizeof(ini_stats_t));
+  for (int i = 0; i < 1000; i++) {
+    sprintf(key, "missing%d", i);
+    ini_property_exists(ini, INI_GLOBAL_SECTION, key);
+  }
+  ini_get_stats(ini, &stats);
+  TEST_CHECK(stats.misses == 1000);
+  TEST_CHECK(stats.probes < 1000 * 1000 / 20);
+  TEST_MSG("Probes: %d", (int) stats.probes);
+
+  ini_destroy(ini);
+}
+
+void test_ini_image_write(void) {
+  ini_t* ini = ini_load(data_str);
+
+  TEST_CASE("size of the image");
+  const size_t size = ini_image_write(ini, NULL, 0);
+  TEST_CHECK(size > strlen(data_str));
+
+  TEST_CASE("image that doesn't fit");
+  uint64_t* image = (uint64_t*) malloc(size);
+  memset(image, 0, size);
+  TEST_CHECK(ini_image_write(ini, image, size - 1) == size);
+  TEST_CHECK(image[0] == 0);
+
+  TEST_CASE("image that fits");
+  TEST_CHECK(ini_image_write(ini, image, size) == size);
+  TEST_CHECK(image[0] != 0);
+  ini_destroy(ini);
+
+  TEST_CASE("lazily loaded document");
+  ini = ini_load_desc(&(ini_desc) { .data = data_str, .lazy = true });
+  TEST_CHECK(ini_image_write(ini, image, size) == size);
+  ini_t* view = ini_image_open(image, size);
+  if (TEST_CHECK(view != NULL)) {
+    TEST_CHECK(strcmp(ini_value(view, 2, "file"), "payroll.dat") == 0);
+    ini_destroy(view);
+  }
+  ini_destroy(ini);
+  free(image);
+}
+
+void test_ini_image_open(void) {
+  ini_t* ini = ini_load(data_str);
+  ini_set_value(ini, INI_GLOBAL_SECTION, "added", "later");
+  const size_t size = ini_image_write(ini, NULL, 0);
+  char* image = (char*) malloc(size);
+  ini_image_write(ini, image, size);
+
+  TEST_CASE("image moved after it was written");
+  char* moved = (char*) malloc(size);
+  memcpy(moved, image, size);
+  memset(image, 0, size);
+  ini_t* view = ini_image_open(moved, size);
+  if (TEST_CHECK(view != NULL)) {
+    TEST_CHECK(ini_num_sections(view) == ini_num_sections(ini));
+    TEST_CHECK(ini_find_section(view, "database") == 2);
+    TEST_CHECK(strcmp(ini_value(view, 2, "server"), "192.0.2.62") == 0);
+    TEST_CHECK(strcmp(ini_value(view, INI_GLOBAL_SECTION, "added"), "later") == 0);
+    TEST_CHECK(ini_value(view, 2, "nope") == NULL);
+    TEST_CHECK(ini_value_as_int(view, 3, "int") == 1234);
+    TEST_CHECK(ini_hash_equal(ini_fingerprint(view), ini_fingerprint(ini)));
+    TEST_CHECK(ini_diff(view, ini, NULL, NULL) == 0);
+
+    TEST_CASE("key queries use the order of the image");
+    ini_span_t key, value;
+    ini_keys_t keys = ini_keys_with_prefix(view, 2, "");
+    TEST_CHECK(ini_keys_next(&keys, &key, &value));
+    TEST_CHECK(key.len == 4 && memcmp(key.ptr, "file", 4) == 0);
+    ini_destroy(view);
+  }
+
+  TEST_CASE("image that isn't valid");
+  TEST_CHECK(ini_image_open(moved, size / 2) == NULL);
+  moved[0] = 'X';
+  TEST_CHECK(ini_image_open(moved, size) == NULL);
+  TEST_CHECK(ini_image_open(image, size) == NULL);
+  moved[0] = 'I';
+
+  TEST_CASE("image with tables outside of it");
+  /* the words of the header: size at 1, counts from 3, offsets from 9 */
+  uint64_t* header = (uint64_t*) moved;
+  static const struct { int word; int64_t delta; } corrupt[] = {
+    { 1, 8 },             /* larger than the buffer */
+    { 4, 1 << 20 },       /* more slots than fit */
+    { 5, 3 },             /* bloom filter that isn't a power of two */
+    { 8, 1 << 20 },       /* strings past the end */
+    { 9, -64 },           /* sections over the header */
+    { 11, 1 },            /* keys at an unaligned offset */
+    { 16, 1 << 20 },      /* bloom filter past the end */
+    { 19, 1 << 20 },      /* strings past the end */
+  };
+  for (size_t c = 0; c < sizeof(corrupt) / sizeof(corrupt[0]); c++) {
+    const uint64_t word = header[corrupt[c].word];
+    header[corrupt[c].word] = word + (uint64_t) corrupt[c].delta;
+    TEST_CHECK(ini_image_open(moved, size) == NULL);
+    TEST_MSG("word %d", corrupt[c].word);
+    header[corrupt[c].word] = word;
+  }
+  view = ini_image_open(moved, size);
+  TEST_CHECK(view != NULL);
+  ini_destroy(view);
+
+  ini_destroy(ini);
+  free(image);
+  free(moved);
+}
+
+void test_ini_shared_publish(void) {
+  ini_shared_t* publisher = ini_shared_create("header-test-ini");
+  if (!TEST_CHECK(publisher != NULL)) {
+    return;
+  }
+  TEST_CHECK(ini_shared_generation(publisher) == 0);
+
+  TEST_CASE("every document is the next generation");
+  ini_t* ini = ini_load(data_str);
+  TEST_CHECK(ini_shared_publish(publisher, ini));
+  TEST_CHECK(ini_shared_generation(publisher) == 1);
+  ini_shared_t* worker = ini_shared_open("header-test-ini");
+  if (TEST_CHECK(worker != NULL)) {
+    const ini_t* shared = ini_shared_get(worker);
+    if (TEST_CHECK(shared != NULL)) {
+      TEST_CHECK(strcmp(ini_value(shared, 2, "port"), "143") == 0);
+    }
+    TEST_CHECK(ini_shared_generation(worker) == 1);
+
+    TEST_CASE("workers switch to the latest generation");
+    ini_set_value(ini, 2, "port", "993");
+    TEST_CHECK(ini_shared_publish(publisher, ini));
+    TEST_CHECK(ini_shared_publish(publisher, ini));
+    const char* old_port = ini_value(shared, 2, "port");
+    shared = ini_shared_get(worker);
+    TEST_CHECK(ini_shared_generation(worker) == 3);
+    TEST_CHECK(strcmp(ini_value(shared, 2, "port"), "993") == 0);
+    TEST_CHECK(old_port != ini_value(shared, 2, "port"));
+    ini_shared_close(worker);
+  }
+
+  TEST_CASE("a publisher that replaces another continues its generations");
+  ini_shared_t* replacement = ini_shared_create("header-test-ini");
+  if (TEST_CHECK(replacement != NULL)) {
+    TEST_CHECK(ini_shared_generation(replacement) == 3);
+    TEST_CHECK(ini_shared_publish(replacement, ini));
+    TEST_CHECK(ini_shared_generation(replacement) == 4);
+    ini_shared_close(replacement);
+  }
+  ini_destroy(ini);
+
+  TEST_CASE("a closed publisher removes its shared memory");
+  ini_shared_close(publisher);
+  TEST_CHECK(ini_shared_open("header-test-ini") == NULL);
+}
+
+void test_ini_shared_get(void) {
+  TEST_CASE("nothing to open");
+  TEST_CHECK(ini_shared_open("header-test-not-ini") == NULL);
+
+  TEST_CASE("nothing published yet");
+  ini_shared_t* publisher = ini_shared_create("header-test-ini");
+  if (!TEST_CHECK(publisher != NULL)) {
+    return;
+  }
+  ini_shared_t* worker = ini_shared_open("header-test-ini");
+  if (TEST_CHECK(worker != NULL)) {
+    TEST_CHECK(ini_shared_get(worker) == NULL);
+    ini_shared_close(worker);
+  }
+
+  TEST_CASE("document published to another process");
+  ini_t* ini = ini_load(data_str);
+  TEST_CHECK(ini_shared_publish(publisher, ini));
+#if !defined(_WIN32)
+  pid_t pid = fork();
+  if (pid == 0) {
+    worker = ini_shared_open("header-test-ini");
+    const ini_t* shared = (worker != NULL) ? ini_shared_get(worker) : NULL;
+    const char* file = (shared != NULL) ? ini_value(shared, 2, "file") : NULL;
+    _exit((file != NULL && strcmp(file, "payroll.dat") == 0) ? 0 : 1);
+  }
+  int status = -1;
+  TEST_CHECK(pid > 0 && waitpid(pid, &status, 0) == pid);
+  TEST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+#endif
+  ini_destroy(ini);
+  ini_shared_close(publisher);
+}
@@ -13,19 +13,62 @@ extern void test_fs_exists(void);
 extern void test_fs_get_cwd(void);
 extern void test_fs_get_info(void);
 extern void test_fs_mkdir(void);
+extern void test_fs_map(void);
 extern void test_fs_read(void);
+extern void test_fs_shm_create(void);
+extern void test_fs_shm_open(void);
 extern void test_fs_write(void);
+extern void test_fs_writev(void);
 extern void test_fs_insert_basepath(void);
 extern void test_fs_remove_basepath(void);
 
 /* ini.h */
+extern void test_ini_load(void);
+extern void test_ini_scaling(void);
+extern void test_ini_load_file(void);
+extern void test_ini_load_desc(void);
+extern void test_ini_load_into(void);
+extern void test_ini_reset(void);
+extern void test_ini_clone(void);
+extern void test_ini_num_violations(void);
+extern void test_ini_num_sections(void);
+extern void test_ini_num_properties(void);
 extern void test_ini_find_section(void);
+extern void test_ini_find_section_path(void);
+extern void test_ini_section_parent(void);
+extern void test_ini_section_child(void);
+extern void test_ini_section_next(void);
 extern void test_ini_section_exists(void);
 extern void test_ini_property_exists(void);
 extern void test_ini_value(void);
+extern void test_ini_value_span(void);
+extern void test_ini_values_batch(void);
+extern void test_ini_keys_with_prefix(void);
+extern void test_ini_keys_matching(void);
 extern void test_ini_value_as_int(void);
 extern void test_ini_value_as_float(void);
 extern void test_ini_value_as_bool(void);
+extern void test_ini_value_as_list(void);
+extern void test_ini_value_as_int_array(void);
+extern void test_ini_set_value(void);
+extern void test_ini_interpolate(void);
+extern void test_ini_apply_env(void);
+extern void test_ini_editor_create(void);
+extern void test_ini_editor_set_value(void);
+extern void test_ini_editor_add_section(void);
+extern void test_ini_editor_spans(void);
+extern void test_ini_editor_write(void);
+extern void test_ini_fingerprint(void);
+extern void test_ini_diff(void);
+extern void test_ini_version_create(void);
+extern void test_ini_version_set(void);
+extern void test_ini_version_value(void);
+extern void test_ini_version_diff(void);
+extern void test_ini_get_stats(void);
+extern void test_ini_image_write(void);
+extern void test_ini_image_open(void);
+extern void test_ini_shared_publish(void);
+extern void test_ini_shared_get(void);
 
 TEST_LIST = {
   /* filesystem.h */
@@ -41,19 +84,62 @@ TEST_LIST = {
   { "fs_get_cwd", test_fs_get_cwd },
   { "fs_get_info", test_fs_get_info },
   { "fs_mkdir", test_fs_mkdir },
+  { "fs_map", test_fs_map },
   { "fs_read", test_fs_read },
+  { "fs_shm_create", test_fs_shm_create },
+  { "fs_shm_open", test_fs_shm_open },
   { "fs_write", test_fs_write },
+  { "fs_writev", test_fs_writev },
   { "fs_insert_basepath", test_fs_insert_basepath },
   { "fs_remove_basepath", test_fs_remove_basepath },
 
   /* ini.h */
+  { "ini_load", test_ini_load },
+  { "ini_scaling", test_ini_scaling },
+  { "ini_load_file", test_ini_load_file },
+  { "ini_load_desc", test_ini_load_desc },
+  { "ini_load_into", test_ini_load_into },
+  { "ini_reset", test_ini_reset },
+  { "ini_clone", test_ini_clone },
+  { "ini_num_violations", test_ini_num_violations },
+  { "ini_num_sections", test_ini_num_sections },
+  { "ini_num_properties", test_ini_num_properties },
   { "ini_find_section", test_ini_find_section },
+  { "ini_find_section_path", test_ini_find_section_path },
+  { "ini_section_parent", test_ini_section_parent },
+  { "ini_section_child", test_ini_section_child },
+  { "ini_section_next", test_ini_section_next },
   { "ini_section_exists", test_ini_section_exists },
   { "ini_property_exists", test_ini_property_exists },
   { "ini_value", test_ini_value },
+  { "ini_value_span", test_ini_value_span },
+  { "ini_values_batch", test_ini_values_batch },
+  { "ini_keys_with_prefix", test_ini_keys_with_prefix },
+  { "ini_keys_matching", test_ini_keys_matching },
   { "ini_value_as_int", test_ini_value_as_int },
   { "ini_value_as_float", test_ini_value_as_float },
   { "ini_value_as_bool", test_ini_value_as_bool },
+  { "ini_value_as_list", test_ini_value_as_list },
+  { "ini_value_as_int_array", test_ini_value_as_int_array },
+  { "ini_set_value", test_ini_set_value },
+  { "ini_interpolate", test_ini_interpolate },
+  { "ini_apply_env", test_ini_apply_env },
+  { "ini_editor_create", test_ini_editor_create },
+  { "ini_editor_set_value", test_ini_editor_set_value },
+  { "ini_editor_add_section", test_ini_editor_add_section },
+  { "ini_editor_spans", test_ini_editor_spans },
+  { "ini_editor_write", test_ini_editor_write },
+  { "ini_fingerprint", test_ini_fingerprint },
+  { "ini_diff", test_ini_diff },
+  { "ini_version_create", test_ini_version_create },
+  { "ini_version_set", test_ini_version_set },
+  { "ini_version_value", test_ini_version_value },
+  { "ini_version_diff", test_ini_version_diff },
+  { "ini_get_stats", test_ini_get_stats },
+  { "ini_image_write", test_ini_image_write },
+  { "ini_image_open", test_ini_image_open },
+  { "ini_shared_publish", test_ini_shared_publish },
+  { "ini_shared_get", test_ini_shared_get },
 
   /* always last. */
   { NULL, NULL }